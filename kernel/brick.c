@@ -3,6 +3,9 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/string.h>
+#include <linux/cache.h>
+#include <linux/cpumask.h>
+#include <linux/topology.h>
 
 //#define BRICK_DEBUGGING
 
@@ -78,6 +81,18 @@ void kthread_stop_nowait(struct task_struct *k)
 EXPORT_SYMBOL_GPL(kthread_stop_nowait);
 #endif
 
+void brick_thread_set_node(struct task_struct *thread, int node)
+{
+	if (unlikely(!thread))
+		return;
+	if (node >= 0 && node < nr_node_ids && node_online(node)) {
+		set_cpus_allowed_ptr(thread, cpumask_of_node(node));
+	} else {
+		set_cpus_allowed_ptr(thread, cpu_possible_mask);
+	}
+}
+EXPORT_SYMBOL_GPL(brick_thread_set_node);
+
 void brick_thread_stop_nowait(struct task_struct *k)
 {
 	kthread_stop_nowait(k);
@@ -380,6 +395,123 @@ EXPORT_SYMBOL_GPL(generic_brick_exit_full);
 
 // default implementations
 
+/* Whole object chunks (the object together with all aspects which
+ * have been placed into the same memory block) are recycled via
+ * small per-CPU caches per object layout.
+ * Chunks are sized in multiples of the cache line size.
+ * The chunk size is kept in max_offset while the chunk is cached.
+ */
+static
+void *_get_cached(struct generic_object_layout *object_layout, int *total_size)
+{
+	struct generic_object_cache __percpu *cache = object_layout->object_cache;
+	struct generic_object_cache *oc;
+	struct generic_object *old = NULL;
+	unsigned long flags;
+
+	if (unlikely(!cache)) {
+		cache = alloc_percpu(struct generic_object_cache);
+		if (unlikely(!cache))
+			return NULL;
+		if (cmpxchg(&object_layout->object_cache, NULL, cache) != NULL) {
+			free_percpu(cache);
+			cache = object_layout->object_cache;
+		}
+	}
+
+	local_irq_save(flags);
+	oc = per_cpu_ptr(cache, smp_processor_id());
+	if (likely(oc->oc_count > 0)) {
+		old = oc->oc_data[--oc->oc_count];
+		if (likely(old->max_offset >= *total_size)) {
+			oc->oc_hit++;
+		} else { // the size hint has grown meanwhile
+			oc->oc_miss++;
+			local_irq_restore(flags);
+			brick_mem_free(old);
+			return NULL;
+		}
+	} else {
+		oc->oc_miss++;
+	}
+	local_irq_restore(flags);
+
+	if (old) {
+		*total_size = old->max_offset;
+		memset(old, 0, *total_size);
+	}
+	return old;
+}
+
+static
+bool _put_cached(struct generic_object_layout *object_layout, struct generic_object *object)
+{
+	struct generic_object_cache __percpu *cache = object_layout->object_cache;
+	struct generic_object_cache *oc;
+	unsigned long flags;
+	bool ok = false;
+
+	if (unlikely(!cache))
+		return false;
+
+	local_irq_save(flags);
+	oc = per_cpu_ptr(cache, smp_processor_id());
+	if (likely(oc->oc_count < GENERIC_OBJECT_CACHE_SIZE)) {
+		oc->oc_data[oc->oc_count++] = object;
+		ok = true;
+	}
+	local_irq_restore(flags);
+	return ok;
+}
+
+void generic_exit_object_layout(struct generic_object_layout *object_layout)
+{
+	struct generic_object_cache __percpu *cache = xchg(&object_layout->object_cache, NULL);
+	int cpu;
+
+	if (!cache)
+		return;
+	for_each_possible_cpu(cpu) {
+		struct generic_object_cache *oc = per_cpu_ptr(cache, cpu);
+		while (oc->oc_count > 0) {
+			brick_mem_free(oc->oc_data[--oc->oc_count]);
+		}
+	}
+	free_percpu(cache);
+}
+EXPORT_SYMBOL_GPL(generic_exit_object_layout);
+
+/* Report allocations per second since the last call,
+ * and the hit rate of the object cache in percent.
+ */
+void generic_object_layout_statistics(struct generic_object_layout *object_layout, int *rate, int *hit_percent)
+{
+	struct generic_object_cache __percpu *cache = object_layout->object_cache;
+	unsigned long now = jiffies;
+	unsigned long hit = 0;
+	unsigned long miss = 0;
+	int count = atomic_read(&object_layout->total_alloc_count);
+
+	if (cache) {
+		int cpu;
+		for_each_possible_cpu(cpu) {
+			struct generic_object_cache *oc = per_cpu_ptr(cache, cpu);
+			hit += oc->oc_hit;
+			miss += oc->oc_miss;
+		}
+	}
+	*hit_percent = (hit + miss) ? (int)(hit * 100 / (hit + miss)) : 0;
+
+	*rate = 0;
+	if (object_layout->last_stamp && time_after(now, object_layout->last_stamp)) {
+		long long delta = count - object_layout->last_alloc_count;
+		*rate = delta * HZ / (long long)(now - object_layout->last_stamp);
+	}
+	object_layout->last_alloc_count = count;
+	object_layout->last_stamp = now;
+}
+EXPORT_SYMBOL_GPL(generic_object_layout_statistics);
+
 struct generic_object *generic_alloc(struct generic_brick *brick, struct generic_object_layout *object_layout, const struct generic_object_type *object_type)
 {
 	struct generic_object *object;
@@ -401,8 +533,11 @@ struct generic_object *generic_alloc(struct generic_brick *brick, struct generic
 	} else { // usually happens only at the first time
 		object_layout->size_hint = total_size;
 	}
+	total_size = ALIGN(total_size, L1_CACHE_BYTES);
 
-	data = brick_zmem_alloc(total_size);
+	data = _get_cached(object_layout, &total_size);
+	if (!data)
+		data = brick_zmem_alloc(total_size);
 	if (!data)
 		goto err;
 
@@ -464,7 +599,8 @@ void generic_free(struct generic_object *object)
 	if (object_type->exit_fn) {
 		object_type->exit_fn(object);
 	}
-	brick_mem_free(object);
+	if (!_put_cached(object_layout, object))
+		brick_mem_free(object);
 done: ;
 }
 EXPORT_SYMBOL_GPL(generic_free);
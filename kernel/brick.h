@@ -6,6 +6,7 @@
 #include <linux/sched.h>
 #include <linux/wait.h>
 #include <linux/kthread.h>
+#include <linux/percpu.h>
 
 #include <asm/atomic.h>
 
@@ -87,12 +88,26 @@ struct generic_object_type {
 	GENERIC_OBJECT_TYPE(generic);
 };
 
+/* Per-CPU recycling of whole object chunks (object + aspects).
+ */
+#define GENERIC_OBJECT_CACHE_SIZE 16
+
+struct generic_object_cache {
+	int oc_count;
+	unsigned long oc_hit;
+	unsigned long oc_miss;
+	void *oc_data[GENERIC_OBJECT_CACHE_SIZE];
+};
+
 #define GENERIC_OBJECT_LAYOUT(OBJTYPE)					\
 	int size_hint;							\
 	atomic_t alloc_count;						\
 	atomic_t aspect_count;						\
 	atomic_t total_alloc_count;					\
 	atomic_t total_aspect_count;					\
+	struct generic_object_cache __percpu *object_cache;		\
+	int last_alloc_count;						\
+	unsigned long last_stamp;					\
 
 struct generic_object_layout {
 	GENERIC_OBJECT_LAYOUT(generic);
@@ -563,6 +578,8 @@ INLINE void _##BRITYPE##_output_init(struct BRITYPE##_brick *brick, struct BRITY
 
 extern struct generic_object *generic_alloc(struct generic_brick *brick, struct generic_object_layout *object_layout, const struct generic_object_type *object_type);
 extern void generic_free(struct generic_object *object);
+extern void generic_exit_object_layout(struct generic_object_layout *object_layout);
+extern void generic_object_layout_statistics(struct generic_object_layout *object_layout, int *rate, int *hit_percent);
 extern struct generic_aspect *generic_get_aspect(struct generic_brick *brick, struct generic_object *obj);
 
 #define DECLARE_ASPECT_FUNCTIONS(BRITYPE,OBJTYPE)			\
@@ -668,6 +685,11 @@ extern void brick_thread_stop_nowait(struct task_struct *k);
 		kthread_should_stop();		\
 	})
 
+/* Restrict a thread to the CPUs of a NUMA node.
+ * A negative or offline node removes the restriction.
+ */
+extern void brick_thread_set_node(brick_thread_t *thread, int node);
+
 /////////////////////////////////////////////////////////////////////////
 
 // init
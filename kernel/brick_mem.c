@@ -6,6 +6,7 @@
 #include <linux/fs.h>
 #include <linux/slab.h>
 #include <linux/delay.h>
+#include <linux/percpu.h>
 
 #include <asm/atomic.h>
 
@@ -463,14 +464,22 @@ struct mem_block_info *_find_block_info(void *data, bool remove)
 #endif // CONFIG_MARS_DEBUG_MEM_STRONG
 
 static inline
-void *__brick_block_alloc(gfp_t gfp, int order, int cline)
+void *__brick_block_alloc(gfp_t gfp, int order, int node, int cline)
 {
 	void *res;
 #ifdef CONFIG_MARS_MEM_RETRY
 	for (;;) {
 #endif
 #ifdef USE_KERNEL_PAGES
-		res = (void*)__get_free_pages(gfp, order);
+		/* Compound pages are needed for refcounting the tail pages,
+		 * e.g. by kernel_sendpage().
+		 */
+		if (node >= 0) {
+			struct page *page = alloc_pages_node(node, order > 0 ? gfp | __GFP_COMP : gfp, order);
+			res = page ? page_address(page) : NULL;
+		} else {
+			res = (void*)__get_free_pages(order > 0 ? gfp | __GFP_COMP : gfp, order);
+		}
 #else
 		res = __vmalloc(PAGE_SIZE << order, gfp, PAGE_KERNEL_IO);
 #endif
@@ -535,40 +544,104 @@ EXPORT_SYMBOL_GPL(brick_allow_freelist);
 int brick_pre_reserve[BRICK_MAX_ORDER+1] = {};
 EXPORT_SYMBOL_GPL(brick_pre_reserve);
 
-/* Note: we have no separate lists per CPU.
- * This should not hurt because the freelists are only used
- * for higher-order pages which should be rather low-frequency.
+/* The global freelists are fronted by small per-CPU magazines.
+ * Most allocations and frees are served from the local magazine
+ * without touching the global spinlock at all. When a magazine
+ * runs empty, it is refilled from the global freelist in bulk
+ * under a single lock operation. When it runs full, the older half
+ * is flushed back in bulk.
+ * freelist_count[] counts all cached pages, regardless whether they
+ * reside in a magazine or in the global freelist, so the limits in
+ * brick_mem_freelist_max[] keep their meaning.
  */
+#define BRICK_MAGAZINE_SIZE  16
+#define BRICK_MAGAZINE_BULK  (BRICK_MAGAZINE_SIZE / 2)
+
+struct brick_magazine {
+	int   mag_count;
+	unsigned long mag_hit;
+	unsigned long mag_miss;
+	void *mag_data[BRICK_MAGAZINE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct brick_magazine [BRICK_MAX_ORDER+1], brick_magazine);
+
 static spinlock_t freelist_lock[BRICK_MAX_ORDER+1];
 static void *brick_freelist[BRICK_MAX_ORDER+1] = {};
 static atomic_t freelist_count[BRICK_MAX_ORDER+1] = {};
 
 static
-void *_get_free(int order, int cline)
+int _get_free_bulk(void **array, int nr, int order, int cline)
 {
-	void *data;
 	unsigned long flags;
+	int count = 0;
 
 	traced_lock(&freelist_lock[order], flags);
-	data = brick_freelist[order];
-	if (likely(data)) {
-		void *next = *(void**)data;
+	while (count < nr) {
+		void *data = brick_freelist[order];
+		void *next;
+		if (!data)
+			break;
+		next = *(void**)data;
 #ifdef BRICK_DEBUG_MEM // check for corruptions
-		long pattern = *(((long*)data)+1);
-		void *copy = *(((void**)data)+2);
-		if (unlikely(pattern != 0xf0f0f0f0f0f0f0f0 || next != copy)) { // found a corruption
-			// prevent further trouble by leaving a memleak
-			brick_freelist[order] = NULL;
-			traced_unlock(&freelist_lock[order], flags);
-			BRICK_ERR("line %d:freelist corruption at %p (pattern = %lx next %p != %p, murdered = %d), order = %d\n",
-				  cline, data, pattern, next, copy, atomic_read(&freelist_count[order]), order);
-			return NULL;
+		{
+			long pattern = *(((long*)data)+1);
+			void *copy = *(((void**)data)+2);
+			if (unlikely(pattern != 0xf0f0f0f0f0f0f0f0 || next != copy)) { // found a corruption
+				// prevent further trouble by leaving a memleak
+				brick_freelist[order] = NULL;
+				traced_unlock(&freelist_lock[order], flags);
+				BRICK_ERR("line %d:freelist corruption at %p (pattern = %lx next %p != %p, murdered = %d), order = %d\n",
+					  cline, data, pattern, next, copy, atomic_read(&freelist_count[order]), order);
+				return count;
+			}
 		}
 #endif
 		brick_freelist[order] = next;
-		atomic_dec(&freelist_count[order]);
+		array[count++] = data;
 	}
 	traced_unlock(&freelist_lock[order], flags);
+	return count;
+}
+
+static
+void _put_free_bulk(void **array, int nr, int order)
+{
+	unsigned long flags;
+	int i;
+
+	traced_lock(&freelist_lock[order], flags);
+	for (i = 0; i < nr; i++) {
+		void *data = array[i];
+		void *next = brick_freelist[order];
+		*(void**)data = next;
+#ifdef BRICK_DEBUG_MEM // insert redundant copy for checking
+		*(((void**)data)+2) = next;
+#endif
+		brick_freelist[order] = data;
+	}
+	traced_unlock(&freelist_lock[order], flags);
+}
+
+static
+void *_get_free(int order, int cline)
+{
+	struct brick_magazine *mag;
+	void *data = NULL;
+
+	mag = &get_cpu_var(brick_magazine)[order];
+	if (likely(mag->mag_count > 0)) {
+		mag->mag_hit++;
+	} else {
+		mag->mag_miss++;
+		mag->mag_count = _get_free_bulk(mag->mag_data, BRICK_MAGAZINE_BULK, order, cline);
+	}
+	if (likely(mag->mag_count > 0)) {
+		data = mag->mag_data[--mag->mag_count];
+		atomic_dec(&freelist_count[order]);
+	}
+	put_cpu_var(brick_magazine);
+
 #ifdef CONFIG_MARS_DEBUG_MEM_STRONG
 	if (data) {
 		struct mem_block_info *inf = _find_block_info(data, false);
@@ -590,21 +663,34 @@ void *_get_free(int order, int cline)
 static
 void _put_free(void *data, int order)
 {
-	void *next;
-	unsigned long flags;
+	struct brick_magazine *mag;
 
 #ifdef BRICK_DEBUG_MEM // fill with pattern
 	memset(data, 0xf0, PAGE_SIZE << order);
 #endif
 
-	traced_lock(&freelist_lock[order], flags);
-	next = brick_freelist[order];
-	*(void**)data = next;
-#ifdef BRICK_DEBUG_MEM // insert redundant copy for checking
-	*(((void**)data)+2) = next;
+	mag = &get_cpu_var(brick_magazine)[order];
+	if (unlikely(mag->mag_count >= BRICK_MAGAZINE_SIZE)) {
+		// flush the older half, keep the cache-hot ones
+		_put_free_bulk(mag->mag_data, BRICK_MAGAZINE_BULK, order);
+		mag->mag_count -= BRICK_MAGAZINE_BULK;
+		memmove(mag->mag_data, mag->mag_data + BRICK_MAGAZINE_BULK, mag->mag_count * sizeof(void*));
+	}
+	mag->mag_data[mag->mag_count++] = data;
+	put_cpu_var(brick_magazine);
+	atomic_inc(&freelist_count[order]);
+}
+
+/* Reserved pages go directly to the global freelist,
+ * such that any CPU can use them.
+ */
+static
+void _put_free_global(void *data, int order)
+{
+#ifdef BRICK_DEBUG_MEM // fill with pattern
+	memset(data, 0xf0, PAGE_SIZE << order);
 #endif
-	brick_freelist[order] = data;
-	traced_unlock(&freelist_lock[order], flags);
+	_put_free_bulk(&data, 1, order);
 	atomic_inc(&freelist_count[order]);
 }
 
@@ -613,10 +699,17 @@ void _free_all(void)
 {
 	int order;
 	for (order = BRICK_MAX_ORDER; order >= 0; order--) {
+		int cpu;
+		for_each_possible_cpu(cpu) {
+			struct brick_magazine *mag = &per_cpu(brick_magazine, cpu)[order];
+			_put_free_bulk(mag->mag_data, mag->mag_count, order);
+			mag->mag_count = 0;
+		}
 		for (;;) {
-			void *data = _get_free(order, __LINE__);
-			if (!data)
+			void *data;
+			if (!_get_free_bulk(&data, 1, order, __LINE__))
 				break;
+			atomic_dec(&freelist_count[order]);
 			__brick_block_free(data, order, __LINE__);
 		}
 	}
@@ -636,9 +729,9 @@ int brick_mem_reserve(void)
 		max = brick_mem_freelist_max[order] - atomic_read(&freelist_count[order]);
 		if (max >= 0) {
 			for (i = 0; i < max; i++) {
-				void *data = __brick_block_alloc(GFP_KERNEL, order, __LINE__);
+				void *data = __brick_block_alloc(GFP_KERNEL, order, -1, __LINE__);
 				if (likely(data)) {
-					_put_free(data, order);
+					_put_free_global(data, order);
 				} else {
 					status = -ENOMEM;
 				}
@@ -663,7 +756,7 @@ int brick_mem_reserve(struct mem_reservation *r)
 #endif
 EXPORT_SYMBOL_GPL(brick_mem_reserve);
 
-void *_brick_block_alloc(loff_t pos, int len, int line)
+void *_brick_block_alloc_node(loff_t pos, int len, int node, int line)
 {
 	void *data;
 	int count;
@@ -711,11 +804,19 @@ void *_brick_block_alloc(loff_t pos, int len, int line)
 		brick_mem_freelist_max[order] = count;
 #endif
 
+	if (node >= 0 && unlikely(node >= nr_node_ids || !node_online(node)))
+		node = -1;
+
 #ifdef CONFIG_MARS_MEM_PREALLOC
 	data = _get_free(order, line);
+	if (data && node >= 0 && page_to_nid(virt_to_page(data)) != node) {
+		// leave it for others
+		_put_free_global(data, order);
+		data = NULL;
+	}
 	if (!data)
 #endif
-		data = __brick_block_alloc(GFP_BRICK, order, line);
+		data = __brick_block_alloc(GFP_BRICK, order, node, line);
 	
 #ifdef BRICK_DEBUG_MEM
 	if (likely(data) && order > 0) {
@@ -741,6 +842,12 @@ void *_brick_block_alloc(loff_t pos, int len, int line)
 #endif
 	return data;
 }
+EXPORT_SYMBOL_GPL(_brick_block_alloc_node);
+
+void *_brick_block_alloc(loff_t pos, int len, int line)
+{
+	return _brick_block_alloc_node(pos, len, -1, line);
+}
 EXPORT_SYMBOL_GPL(_brick_block_alloc);
 
 void _brick_block_free(void *data, int len, int cline)
@@ -877,13 +984,49 @@ EXPORT_SYMBOL_GPL(brick_iomap);
 
 // module
 
+#ifdef CONFIG_MARS_MEM_PREALLOC
+static
+void _magazine_statistics(void)
+{
+	int order;
+
+	for (order = 1; order <= BRICK_MAX_ORDER; order++) {
+		unsigned long hit = 0;
+		unsigned long miss = 0;
+		int cpu;
+
+		for_each_possible_cpu(cpu) {
+			struct brick_magazine *mag = &per_cpu(brick_magazine, cpu)[order];
+			hit += mag->mag_hit;
+			miss += mag->mag_miss;
+		}
+		if (!hit && !miss)
+			continue;
+		BRICK_INF("pages order = %2d "
+			  "freelist_count = %4d / %3d "
+			  "magazine hit = %lu "
+			  "miss = %lu\n",
+			  order,
+			  atomic_read(&freelist_count[order]),
+			  brick_mem_freelist_max[order],
+			  hit,
+			  miss);
+	}
+}
+#endif
+
 void brick_mem_statistics(bool final)
 {
 #ifdef BRICK_DEBUG_MEM
 	int i;
 	int count = 0;
 	int places = 0;
+#endif
 
+#ifdef CONFIG_MARS_MEM_PREALLOC
+	_magazine_statistics();
+#endif
+#ifdef BRICK_DEBUG_MEM
 	BRICK_INF("======== page allocation:\n");
 #ifdef CONFIG_MARS_MEM_PREALLOC
 	for (i = 0; i <= BRICK_MAX_ORDER; i++) {
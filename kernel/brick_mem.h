@@ -164,6 +164,14 @@ extern void _brick_string_free(const char *data, int line);
 		brick_mark_nonnull(_res_);				\
 	})
 
+/* Prefer memory from a NUMA node (negative: no preference).
+ */
+#define brick_block_alloc_node(_pos_,_len_,_node_)			\
+	({								\
+		void *_res_ = _brick_block_alloc_node((_pos_), (_len_), (_node_), __LINE__); \
+		brick_mark_nonnull(_res_);				\
+	})
+
 #define brick_block_free(_data_,_len_)\
 	do {								\
 		if (_data_) {						\
@@ -175,6 +183,7 @@ extern struct page *brick_iomap(void *data, int *offset, int *len);
 
 // don't use the following directly
 extern void *_brick_block_alloc(loff_t pos, int len, int line) __attribute__((malloc)) __attribute__((alloc_size(2)));
+extern void *_brick_block_alloc_node(loff_t pos, int len, int node, int line) __attribute__((malloc)) __attribute__((alloc_size(2)));
 extern void _brick_block_free(void *data, int len, int cline);
 
 /////////////////////////////////////////////////////////////////////////
@@ -3,19 +3,112 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/bio.h>
+#include <linux/crc32c.h>
 
 //#define BRICK_DEBUGGING
 //#define MARS_DEBUGGING
 //#define IO_DEBUGGING
 
 #include "lib_log.h"
+#include "lib_timing.h"
 
 atomic_t global_mref_flying = ATOMIC_INIT(0);
 EXPORT_SYMBOL_GPL(global_mref_flying);
 
+////////////////// checksumming /////////////////////////
+
+struct log_crc_stats log_crc_stats[LOG_CRC_MAX] = {};
+EXPORT_SYMBOL_GPL(log_crc_stats);
+
+const char *log_crc_name[LOG_CRC_MAX] = {
+	[LOG_CRC_MD5]    = "md5",
+	[LOG_CRC_CRC32C] = "crc32c",
+};
+EXPORT_SYMBOL_GPL(log_crc_name);
+
+static
+int _log_crc(int crc_type, void *data, int len)
+{
+	switch (crc_type) {
+	case LOG_CRC_MD5:
+	{
+		unsigned char checksum[mars_digest_size];
+		mars_digest(checksum, data, len);
+		return *(int*)checksum;
+	}
+	case LOG_CRC_CRC32C:
+		/* crc32c() uses the hardware accelerated implementation
+		 * (e.g. crc32c-intel) when the crypto layer provides one.
+		 */
+		return (int)crc32c(~0U, data, len);
+	}
+	return 0;
+}
+
+int log_crc(int crc_type, void *data, int len)
+{
+	struct log_crc_stats *stats;
+	unsigned long long elapsed;
+	int crc = 0;
+
+	if (unlikely(crc_type < 0 || crc_type >= LOG_CRC_MAX)) {
+		MARS_ERR("unknown checksum type %d\n", crc_type);
+		return 0;
+	}
+
+	elapsed = TIME_THIS(crc = _log_crc(crc_type, data, len));
+
+	stats = &log_crc_stats[crc_type];
+	atomic64_inc(&stats->crc_count);
+	atomic64_add(len, &stats->crc_bytes);
+	atomic64_add(elapsed, &stats->crc_time);
+	return crc;
+}
+EXPORT_SYMBOL_GPL(log_crc);
+
+////////////////// group-append /////////////////////////
+
+static
+enum hrtimer_restart log_group_timer_fn(struct hrtimer *timer)
+{
+	struct log_status *logst = container_of(timer, struct log_status, group_timer);
+
+	if (logst->signal_event)
+		wake_up_interruptible(logst->signal_event);
+	return HRTIMER_NORESTART;
+}
+
+bool log_flush_due(struct log_status *logst)
+{
+	unsigned long long budget;
+	unsigned long long age;
+	unsigned long long now;
+
+	if (!logst->count)
+		return false;
+	if (logst->group_delay_us <= 0 || !logst->group_timer_ok)
+		return true;
+
+	budget = (unsigned long long)logst->group_delay_us * 1000;
+	now = cpu_clock(raw_smp_processor_id());
+	age = now > logst->group_stamp ? now - logst->group_stamp : 0;
+	if (age >= budget)
+		return true;
+
+	// come back when the budget is exhausted
+	if (!hrtimer_active(&logst->group_timer)) {
+		hrtimer_start(&logst->group_timer, ns_to_ktime(budget - age), HRTIMER_MODE_REL);
+	}
+	return false;
+}
+EXPORT_SYMBOL_GPL(log_flush_due);
+
 void exit_logst(struct log_status *logst)
 {
 	int count = 0;
+	if (logst->group_timer_ok) {
+		hrtimer_cancel(&logst->group_timer);
+	}
 	log_flush(logst);
 	while (atomic_read(&logst->mref_flying) > 0) {
 		if (!count++)
@@ -45,6 +138,9 @@ void init_logst(struct log_status *logst, struct mars_input *input, loff_t start
 	logst->brick = input->brick;
 	logst->log_pos = start_pos;
 	init_waitqueue_head(&logst->event);
+	hrtimer_init(&logst->group_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	logst->group_timer.function = log_group_timer_fn;
+	logst->group_timer_ok = true;
 }
 EXPORT_SYMBOL_GPL(init_logst);
 
@@ -157,6 +253,18 @@ void log_flush(struct log_status *logst)
 
 	mars_trace(mref, "log_flush");
 
+	/* All records of the buffer are completed by the same endio.
+	 */
+	if (logst->group_stats) {
+		struct log_group_stats *stats = logst->group_stats;
+		unsigned long long now = cpu_clock(raw_smp_processor_id());
+
+		atomic64_inc(&stats->grp_ios);
+		atomic64_add(logst->count, &stats->grp_records);
+		if (now > logst->group_stamp)
+			atomic64_add(now - logst->group_stamp, &stats->grp_wait);
+	}
+
 	atomic_inc(&logst->mref_flying);
 	atomic_inc(&global_mref_flying);
 
@@ -220,6 +328,8 @@ void *log_reserve(struct log_status *logst, struct log_header *lh)
 		mref->ref_len = logst->chunk_size ? logst->chunk_size : total_len;
 		mref->ref_may_write = WRITE;
 		mref->ref_prio = logst->io_prio;
+		// the chunk is traced on behalf of its first record
+		mref->ref_trace_id = mars_trace_child_id(logst->trace_id);
 
 		for (;;) {
 			status = GENERIC_INPUT_CALL(logst->input, mref_get, mref);
@@ -318,9 +428,7 @@ bool log_finalize(struct log_status *logst, int len, void (*endio)(void *private
 
 	crc = 0;
 	if (logst->do_crc) {
-		unsigned char checksum[mars_digest_size];
-		mars_digest(checksum, data + logst->payload_offset, len);
-		crc = *(int*)checksum;
+		crc = log_crc(logst->crc_type, data + logst->payload_offset, len);
 	}
 
 	/* Correct the length in the header.
@@ -334,7 +442,7 @@ bool log_finalize(struct log_status *logst, int len, void (*endio)(void *private
 	DATA_PUT(data, offset, END_MAGIC);
 	DATA_PUT(data, offset, crc);
 	DATA_PUT(data, offset, (char)1);  // valid_flag copy
-	DATA_PUT(data, offset, (char)0);  // spare
+	DATA_PUT(data, offset, (char)logst->crc_type);
 	DATA_PUT(data, offset, (short)0); // spare
 	DATA_PUT(data, offset, logst->seq_nr + 1);
 	get_lamport(&now);    // when the log entry was ready.
@@ -360,6 +468,8 @@ bool log_finalize(struct log_status *logst, int len, void (*endio)(void *private
 	cb_info->privates[nr_cb] = private;
 
 	// report success
+	if (!logst->count)
+		logst->group_stamp = cpu_clock(raw_smp_processor_id());
 	logst->seq_nr++;
 	logst->count++;
 	ok = true;
@@ -11,11 +11,32 @@
 #define LIB_LOG_H
 
 #ifdef __KERNEL__
+#include <linux/hrtimer.h>
+
 #include "mars.h"
 
 extern atomic_t global_mref_flying;
 #endif
 
+/* Checksum algorithms for log records.
+ * The type is recorded in the trailer of each record.
+ * Old logfiles have a zero there, which means MD5.
+ */
+#define LOG_CRC_MD5      0 // truncated mars_digest()
+#define LOG_CRC_CRC32C   1
+#define LOG_CRC_MAX      2
+
+#ifdef __KERNEL__
+extern int log_crc(int crc_type, void *data, int len);
+#endif
+
+/* Userspace tools need not implement all algorithms.
+ * Records checksummed by others are accepted unverified there.
+ */
+#ifndef log_crc_available
+#define log_crc_available(crc_type) true
+#endif
+
 /* The following structure is memory-only.
  * Transfers to disk are indirectly via the
  * format conversion functions below.
@@ -33,6 +54,7 @@ struct log_header_v1 {
 	short  l_code;
 	unsigned int l_seq_nr;
 	int    l_crc;
+	char   l_crc_type;
 };
 
 #define FORMAT_VERSION   1 // version of disk format, currently there is no other one
@@ -176,8 +198,9 @@ int log_scan(void *buf, int len, loff_t file_pos, int file_offset, bool sloppy,
 			return -EBADMSG;
 		}
 
+		DATA_GET(buf, offset, lh->l_crc_type);
 		// skip spares
-		offset += 3;
+		offset += 2;
 
 		DATA_GET(buf, offset, lh->l_seq_nr);
 		DATA_GET(buf, offset, lh->l_written.tv_sec);
@@ -190,9 +213,12 @@ int log_scan(void *buf, int len, loff_t file_pos, int file_offset, bool sloppy,
 		*seq_nr = lh->l_seq_nr;
 
 		if (lh->l_crc) {
-			unsigned char checksum[mars_digest_size];
-			mars_digest(checksum, buf + found_offset, lh->l_len);
-			if (unlikely(*(int*)checksum != lh->l_crc)) {
+			if (unlikely(lh->l_crc_type < 0 || lh->l_crc_type >= LOG_CRC_MAX)) {
+				MARS_ERR(SCAN_TXT "unknown checksum type %d\n", SCAN_PAR, (int)lh->l_crc_type);
+				return -EBADMSG;
+			}
+			if (unlikely(log_crc_available(lh->l_crc_type) &&
+				     log_crc(lh->l_crc_type, buf + found_offset, lh->l_len) != lh->l_crc)) {
 				MARS_ERR(SCAN_TXT "data checksumming mismatch, length = %d\n", SCAN_PAR, lh->l_len);
 				return -EBADMSG;
 			}
@@ -229,12 +255,16 @@ int log_scan(void *buf, int len, loff_t file_pos, int file_offset, bool sloppy,
 struct log_status {
 	// interfacing
 	wait_queue_head_t *signal_event;
+	struct log_group_stats *group_stats; // optional, owned by the caller
 	// tunables
 	int align_size;   // alignment between requests
 	int chunk_size;   // must be at least 8K (better 64k)
 	int max_size;     // max payload length
 	int io_prio;
+	int crc_type;
 	bool do_crc;
+	int group_delay_us; // group-append latency budget (0 = flush at once)
+	long long trace_id; // trace id of the origin of the next record
 	// informational
 	atomic_t mref_flying;
 	int count;
@@ -258,6 +288,10 @@ struct log_status {
 	bool got;
 	bool do_free;
 	void *private;
+	// group-append
+	unsigned long long group_stamp; // when the oldest buffered record was finalized
+	struct hrtimer group_timer;
+	bool group_timer_ok;
 };
 
 void init_logst(struct log_status *logst, struct mars_input *input, loff_t start_pos);
@@ -265,6 +299,13 @@ void exit_logst(struct log_status *logst);
 
 void log_flush(struct log_status *logst);
 
+/* Group-append: returns true when the buffered records should be
+ * written now. Otherwise, the budget logst->group_delay_us for
+ * coalescing further records has not yet expired, and
+ * logst->signal_event will be woken up when it does.
+ */
+bool log_flush_due(struct log_status *logst);
+
 void *log_reserve(struct log_status *logst, struct log_header *lh);
 
 bool log_finalize(struct log_status *logst, int len, void (*endio)(void *private, int error), void *private);
@@ -273,6 +314,27 @@ int log_read(struct log_status *logst, bool sloppy, struct log_header *lh, void
 
 /////////////////////////////////////////////////////////////////////////
 
+// checksum statistics
+
+struct log_crc_stats {
+	atomic64_t crc_count;
+	atomic64_t crc_bytes;
+	atomic64_t crc_time; // in ns
+};
+
+extern struct log_crc_stats log_crc_stats[LOG_CRC_MAX];
+extern const char *log_crc_name[LOG_CRC_MAX];
+
+// group-append statistics
+
+struct log_group_stats {
+	atomic64_t grp_ios;
+	atomic64_t grp_records;
+	atomic64_t grp_wait; // in ns, age of the oldest record at log_flush()
+};
+
+/////////////////////////////////////////////////////////////////////////
+
 // init
 
 extern int init_log_format(void);
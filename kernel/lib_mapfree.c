@@ -152,6 +152,7 @@ struct mapfree_info *mapfree_get(const char *name, int flags)
 		INIT_LIST_HEAD(&mf->mf_dirty_anchor);
 		atomic_set(&mf->mf_count, 1);
 		spin_lock_init(&mf->mf_lock);
+		init_waitqueue_head(&mf->mf_sync_event);
 		mf->mf_max = -1;
 
 		oldfs = get_fs();
@@ -339,6 +340,59 @@ void mf_get_any_dirty(const char *filename, loff_t *min, loff_t *max, int min_st
 }
 EXPORT_SYMBOL_GPL(mf_get_any_dirty);
 
+////////////////// group commit of syncs  //////////////////
+
+/* All users of the same file share one sync barrier.
+ * The caller needs a sync which has started _after_ its writes
+ * have completed. When such a sync has been run by somebody else
+ * in the meantime, its result is taken over and *saved is set.
+ * Otherwise the caller runs the next sync itself, on behalf of all
+ * others which are waiting for the same generation.
+ */
+int mf_group_sync(struct mapfree_info *mf, int (*sync_fn)(struct file *file), bool *saved)
+{
+	long long target;
+	unsigned long flags;
+	int status;
+
+	*saved = false;
+
+	traced_lock(&mf->mf_lock, flags);
+	target = mf->mf_sync_started + 1;
+	traced_unlock(&mf->mf_lock, flags);
+
+	for (;;) {
+		traced_lock(&mf->mf_lock, flags);
+		if (mf->mf_sync_done >= target) {
+			status = mf->mf_sync_status;
+			traced_unlock(&mf->mf_lock, flags);
+			*saved = true;
+			break;
+		}
+		if (mf->mf_sync_started < target && mf->mf_sync_done == mf->mf_sync_started) {
+			mf->mf_sync_started = target;
+			traced_unlock(&mf->mf_lock, flags);
+
+			status = sync_fn(mf->mf_filp);
+
+			traced_lock(&mf->mf_lock, flags);
+			mf->mf_sync_done = target;
+			mf->mf_sync_status = status;
+			traced_unlock(&mf->mf_lock, flags);
+			wake_up_interruptible_all(&mf->mf_sync_event);
+			break;
+		}
+		traced_unlock(&mf->mf_lock, flags);
+
+		wait_event_interruptible_timeout(
+			mf->mf_sync_event,
+			mf->mf_sync_done >= target || mf->mf_sync_done == mf->mf_sync_started,
+			HZ);
+	}
+	return status;
+}
+EXPORT_SYMBOL_GPL(mf_group_sync);
+
 ////////////////// module init stuff /////////////////////////
 
 static
@@ -35,6 +35,11 @@ struct mapfree_info {
 	loff_t           mf_last;
 	loff_t           mf_max;
 	long long        mf_jiffies;
+	// group commit of syncs, see mf_group_sync()
+	wait_queue_head_t mf_sync_event;
+	long long        mf_sync_started;
+	long long        mf_sync_done;
+	int              mf_sync_status;
 };
 
 struct dirty_info {
@@ -56,6 +61,10 @@ void mf_remove_dirty(struct mapfree_info *mf, struct dirty_info *di);
 void mf_get_dirty(struct mapfree_info *mf, loff_t *min, loff_t *max, int min_stage, int max_stage);
 void mf_get_any_dirty(const char *filename, loff_t *min, loff_t *max, int min_stage, int max_stage);
 
+////////////////// group commit of syncs  //////////////////
+
+int mf_group_sync(struct mapfree_info *mf, int (*sync_fn)(struct file *file), bool *saved);
+
 ////////////////// module init stuff /////////////////////////
 
 int __init init_mars_mapfree(void);
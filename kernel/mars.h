@@ -108,17 +108,43 @@ extern unsigned long long start_trace_clock;
 
 extern void _mars_log(char *buf, int len);
 extern void mars_log(const char *fmt, ...);
-extern void mars_trace(struct mref_object *mref, const char *info);
+extern void _mars_trace_stamp(struct mref_object *mref, const char *info);
 extern void mars_log_trace(struct mref_object *mref);
 
 #else
 #define TRACING_INFO /*empty*/
 #define _mars_log(buf,len) /*empty*/
 #define mars_log(fmt...) /*empty*/
-#define mars_trace(mref,info) /*empty*/
+#define _mars_trace_stamp(mref,info) /*empty*/
 #define mars_log_trace(mref) /*empty*/
 #endif
 
+/* Sampled latency tracing, available in production.
+ * When mars_trace_rate is n > 0, every n-th mref is sampled at its
+ * first trace point. All trace points of sampled mrefs are recorded
+ * into per-CPU ring buffers, which are drained via
+ * /proc/sys/mars/trace
+ */
+#define MARS_TRACE_RING   1024 // records per CPU
+#define MARS_TRACE_POINT  16   // max length of trace point names
+
+extern int mars_trace_rate;
+extern int mars_trace_lost;
+extern void _mars_trace(struct mref_object *mref, const char *info);
+extern int mars_trace_read(char *buf, int maxlen);
+
+#define mars_trace(mref,info)						\
+	do {								\
+		_mars_trace_stamp(mref, info);				\
+		if (unlikely(mars_trace_rate > 0))			\
+			_mars_trace(mref, info);			\
+	} while (0)
+
+/* Child mrefs inherit the trace id of their origin.
+ * Children of unsampled (or undecided) origins are never sampled.
+ */
+#define mars_trace_child_id(id) ((id) > 0 ? (id) : -1LL)
+
 #define MREF_OBJECT(OBJTYPE)						\
 	CALLBACK_OBJECT(OBJTYPE);					\
 	/* supplied by caller */					\
@@ -129,6 +155,7 @@ extern void mars_log_trace(struct mref_object *mref);
 	int    ref_prio;						\
 	int    ref_timeout;						\
 	int    ref_cs_mode; /* 0 = off, 1 = checksum + data, 2 = checksum only */	\
+	int    ref_cs_algo; /* MARS_DIGEST_*, may be downgraded by the implementation */ \
 	/* maintained by the ref implementation, readable for callers */ \
 	loff_t ref_total_size; /* just for info, need not be implemented */ \
 	unsigned char ref_checksum[16];					\
@@ -136,6 +163,7 @@ extern void mars_log_trace(struct mref_object *mref);
 	int    ref_rw;							\
 	int    ref_id; /* not mandatory; may be used for identification */ \
 	bool   ref_skip_sync; /* skip sync for this particular mref */	\
+	long long ref_trace_id; /* > 0: sampled for latency tracing, < 0: not sampled */ \
 	/* maintained by the ref implementation, incrementable for	\
 	 * callers (but not decrementable! use ref_put()) */		\
 	bool   ref_initialized; /* internally used for checking */	\
@@ -193,6 +221,7 @@ struct mars_info {
 	struct generic_object_layout mref_object_layout;		\
 	struct list_head global_brick_link;				\
 	struct list_head dent_brick_link;				\
+	struct hlist_node brick_hash_node; /* index by brick_path */	\
 	const char *brick_path;						\
 	struct mars_global *global;					\
 	void **kill_ptr;						\
@@ -312,8 +341,12 @@ extern void mars_power_led_off(struct mars_brick *brick, bool val);
 /* this should disappear!
  */
 extern void (*_mars_trigger)(void);
+extern void (*_mars_trigger_path)(const char *path);
 extern void (*_mars_remote_trigger)(void);
 #define mars_trigger() do { if (_mars_trigger) { MARS_DBG("trigger...\n"); _mars_trigger(); } } while (0)
+/* Only the resource where <path> belongs to needs a new strategy round.
+ */
+#define mars_trigger_path(path) do { if (_mars_trigger_path) { MARS_DBG("trigger '%s'...\n", (path) ? (path) : ""); _mars_trigger_path(path); } else { mars_trigger(); } } while (0)
 #define mars_remote_trigger() do { if (_mars_remote_trigger) { MARS_DBG("remote_trigger...\n"); _mars_remote_trigger(); } } while (0)
 
 /////////////////////////////////////////////////////////////////////////
@@ -340,6 +373,11 @@ extern const struct generic_brick_type *_client_brick_type;
 extern const struct generic_brick_type *_bio_brick_type;
 extern const struct generic_brick_type *_aio_brick_type;
 extern const struct generic_brick_type *_sio_brick_type;
+extern const struct generic_brick_type *_rio_brick_type;
+
+/* mars_use_rio: substitute newly created aio bricks by rio bricks.
+ */
+extern int mars_use_rio;
 
 #ifndef CONFIG_MARS_PREFER_SIO
 
@@ -420,7 +458,13 @@ static inline void unuse_fake_mm(void) {}
 /* Crypto stuff
  */
 
+#define MARS_DIGEST_MD5      0
+#define MARS_DIGEST_CRC32C   1
+#define MARS_DIGEST_MAX      2
+
 extern int mars_digest_size;
+extern const char *mars_digest_name[MARS_DIGEST_MAX];
+extern void mars_digest_algo(int algo, unsigned char *digest, void *data, int len);
 extern void mars_digest(unsigned char *digest, void *data, int len);
 extern void mref_checksum(struct mref_object *mref);
 
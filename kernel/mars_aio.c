@@ -14,6 +14,7 @@
 #include <linux/spinlock.h>
 #include <linux/wait.h>
 #include <linux/file.h>
+#include <linux/delay.h>
 
 #include "mars.h"
 #include "lib_timing.h"
@@ -61,74 +62,46 @@ EXPORT_SYMBOL_GPL(aio_sync_threshold);
 int aio_sync_mode = 2;
 EXPORT_SYMBOL_GPL(aio_sync_mode);
 
-///////////////////////// own type definitions ////////////////////////
-
-////////////////// some helpers //////////////////
-
-static inline
-void _enqueue(struct aio_threadinfo *tinfo, struct aio_mref_aspect *mref_a, int prio, bool at_end)
-{
-	unsigned long flags;
-#if 1
-	prio++;
-	if (unlikely(prio < 0)) {
-		prio = 0;
-	} else if (unlikely(prio >= MARS_PRIO_NR)) {
-		prio = MARS_PRIO_NR - 1;
-	}
-#else
-	prio = 0;
-#endif
-
-	mref_a->enqueue_stamp = cpu_clock(raw_smp_processor_id());
-
-	traced_lock(&tinfo->lock, flags);
-
-	if (at_end) {
-		list_add_tail(&mref_a->io_head, &tinfo->mref_list[prio]);
-	} else {
-		list_add(&mref_a->io_head, &tinfo->mref_list[prio]);
-	}
-	tinfo->queued[prio]++;
-	atomic_inc(&tinfo->queued_sum);
+int aio_submit_batch = 16;
+EXPORT_SYMBOL_GPL(aio_submit_batch);
 
-	traced_unlock(&tinfo->lock, flags);
+int aio_sync_window_us = 0;
+EXPORT_SYMBOL_GPL(aio_sync_window_us);
 
-	atomic_inc(&tinfo->total_enqueue_count);
+///////////////////////// own type definitions ////////////////////////
 
-	wake_up_interruptible_all(&tinfo->event);
-}
+////////////////// some helpers //////////////////
 
+/* Grab up to max mrefs at once, higher priorities first.
+ */
 static inline
-struct aio_mref_aspect *_dequeue(struct aio_threadinfo *tinfo)
+int _dequeue_batch(struct aio_threadinfo *tinfo, struct aio_mref_aspect *batch[], int max)
 {
-	struct aio_mref_aspect *mref_a = NULL;
+	unsigned long long now;
+	int count = 0;
 	int prio;
-	unsigned long flags = 0;
+	int i;
 
-	traced_lock(&tinfo->lock, flags);
+	aio_fetch_pushed(tinfo);
 
-	for (prio = 0; prio < MARS_PRIO_NR; prio++) {
+	for (prio = 0; prio < MARS_PRIO_NR && count < max; prio++) {
 		struct list_head *start = &tinfo->mref_list[prio];
-		struct list_head *tmp = start->next;
-		if (tmp != start) {
+		while (start->next != start && count < max) {
+			struct list_head *tmp = start->next;
 			list_del_init(tmp);
-			tinfo->queued[prio]--;
-			atomic_dec(&tinfo->queued_sum);
-			mref_a = container_of(tmp, struct aio_mref_aspect, io_head);
-			goto done;
+			batch[count++] = container_of(tmp, struct aio_mref_aspect, io_head);
 		}
 	}
+	atomic_sub(count, &tinfo->queued_sum);
 
-done:
-	traced_unlock(&tinfo->lock, flags);
-
-	if (likely(mref_a && mref_a->object)) {
-		unsigned long long latency;
-		latency = cpu_clock(raw_smp_processor_id()) - mref_a->enqueue_stamp;
-		threshold_check(&aio_io_threshold[mref_a->object->ref_rw & 1], latency);
+	now = cpu_clock(raw_smp_processor_id());
+	for (i = 0; i < count; i++) {
+		struct aio_mref_aspect *mref_a = batch[i];
+		if (likely(mref_a->object)) {
+			threshold_check(&aio_io_threshold[mref_a->object->ref_rw & 1], now - mref_a->enqueue_stamp);
+		}
 	}
-	return mref_a;
+	return count;
 }
 
 ////////////////// own brick / input / output operations //////////////////
@@ -209,7 +182,7 @@ static int aio_ref_get(struct aio_output *output, struct mref_object *mref)
 			MARS_ERR("bad ref_len = %d\n", mref->ref_len);
 			return -ENOMEM;
 		}
-		mref->ref_data = brick_block_alloc(mref->ref_pos, (mref_a->alloc_len = mref->ref_len));
+		mref->ref_data = brick_block_alloc_node(mref->ref_pos, (mref_a->alloc_len = mref->ref_len), output->brick->numa_node);
 		if (unlikely(!mref->ref_data)) {
 			MARS_ERR("ENOMEM %d bytes\n", mref->ref_len);
 			return -ENOMEM;
@@ -346,32 +319,40 @@ static void aio_ref_io(struct aio_output *output, struct mref_object *mref)
 		goto done;
 	}
 
-	_enqueue(tinfo, mref_a, mref->ref_prio, true);
+	aio_enqueue(tinfo, mref_a, mref->ref_prio);
 	return;
 
 done:
 	_complete_mref(output, mref, err);
 }
 
-static int aio_submit(struct aio_output *output, struct aio_mref_aspect *mref_a, bool use_fdsync)
+static inline
+void _aio_fill_iocb(struct aio_output *output, struct aio_mref_aspect *mref_a, bool use_fdsync, struct iocb *iocb)
 {
 	struct mref_object *mref = mref_a->object;
+
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->aio_data = (__u64)mref_a;
+	iocb->aio_lio_opcode = use_fdsync ? IOCB_CMD_FDSYNC : (mref->ref_rw != 0 ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD);
+	iocb->aio_fildes = output->fd;
+	iocb->aio_buf = (unsigned long)mref->ref_data;
+	iocb->aio_nbytes = mref->ref_len;
+	iocb->aio_offset = mref->ref_pos;
+	// .aio_reqprio = something(mref->ref_prio) field exists, but not yet implemented in kernelspace :(
+
+	mars_trace(mref, "aio_submit");
+}
+
+/* Submit a whole array of prepared iocbs by a single syscall.
+ * Like io_submit(), returns the number of accepted iocbs, which may be
+ * less than nr. An error is only returned when none was accepted.
+ */
+static int aio_submit_iocbs(struct aio_output *output, struct iocb *iocbp[], int nr, int rw)
+{
 	mm_segment_t oldfs;
 	int res;
-	struct iocb iocb = {
-		.aio_data = (__u64)mref_a,
-		.aio_lio_opcode = use_fdsync ? IOCB_CMD_FDSYNC : (mref->ref_rw != 0 ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD),
-		.aio_fildes = output->fd,
-		.aio_buf = (unsigned long)mref->ref_data,
-		.aio_nbytes = mref->ref_len,
-		.aio_offset = mref->ref_pos,
-		// .aio_reqprio = something(mref->ref_prio) field exists, but not yet implemented in kernelspace :(
-	};
-	struct iocb *iocbp = &iocb;
 	unsigned long long latency;
 
-	mars_trace(mref, "aio_submit");
-
 	if (unlikely(output->fd < 0)) {
 		MARS_ERR("bad fd = %d\n", output->fd);
 		res = -EBADF;
@@ -380,18 +361,20 @@ static int aio_submit(struct aio_output *output, struct aio_mref_aspect *mref_a,
 
 	oldfs = get_fs();
 	set_fs(get_ds());
-	latency = TIME_STATS(&timings[mref->ref_rw & 1], res = sys_io_submit(output->ctxp, 1, &iocbp));
+	latency = TIME_STATS(&timings[rw & 1], res = sys_io_submit(output->ctxp, nr, iocbp));
 	set_fs(oldfs);
 
 	threshold_check(&aio_submit_threshold, latency);
 
-	atomic_inc(&output->total_submit_count);
+	atomic_inc(&output->total_submit_calls);
 
-	if (likely(res >= 0)) {
-		atomic_inc(&output->submit_count);
+	if (likely(res > 0)) {
+		atomic_add(res, &output->total_submit_count);
+		atomic_add(res, &output->submit_count);
+		atomic_inc(&output->total_batch_hist[min(fls(res) - 1, AIO_BATCH_HIST - 1)]);
 	} else if (likely(res == -EAGAIN)) {
 		atomic_inc(&output->total_again_count);
-	} else {
+	} else if (res < 0) {
 		MARS_ERR("error = %d\n", res);
 	}
 
@@ -399,6 +382,20 @@ done:
 	return res;
 }
 
+static int aio_submit(struct aio_output *output, struct aio_mref_aspect *mref_a, bool use_fdsync)
+{
+	struct iocb iocb;
+	struct iocb *iocbp = &iocb;
+	int res;
+
+	_aio_fill_iocb(output, mref_a, use_fdsync, &iocb);
+	res = aio_submit_iocbs(output, &iocbp, 1, mref_a->object->ref_rw);
+	// a single iocb is either accepted or not
+	if (unlikely(!res))
+		res = -EAGAIN;
+	return res;
+}
+
 static int aio_submit_dummy(struct aio_output *output)
 {
 	mm_segment_t oldfs;
@@ -420,6 +417,19 @@ static int aio_submit_dummy(struct aio_output *output)
 	return res;
 }
 
+/* Follow changes of the home node at runtime.
+ */
+static inline
+void _aio_check_node(struct aio_threadinfo *tinfo)
+{
+	int node = tinfo->output->brick->numa_node;
+
+	if (unlikely(node != tinfo->numa_node)) {
+		tinfo->numa_node = node;
+		brick_thread_set_node(current, node);
+	}
+}
+
 static
 int aio_start_thread(
 	struct aio_output *output,
@@ -430,10 +440,12 @@ int aio_start_thread(
 	int j;
 
 	for (j = 0; j < MARS_PRIO_NR; j++) {
+		tinfo->push_list[j] = NULL;
 		INIT_LIST_HEAD(&tinfo->mref_list[j]);
 	}
 	tinfo->output = output;
-	spin_lock_init(&tinfo->lock);
+	tinfo->numa_node = -1;
+	tinfo->consumer_idle = false;
 	init_waitqueue_head(&tinfo->event);
 	init_waitqueue_head(&tinfo->terminate_event);
 	tinfo->terminated = false;
@@ -506,20 +518,30 @@ int aio_sync(struct file *file)
 }
 
 static
-void aio_sync_all(struct aio_output *output, struct list_head *tmp_list)
+void aio_sync_all(struct aio_output *output, struct list_head *tmp_list, unsigned long long start_stamp)
 {
 	unsigned long long latency;
+	bool saved = false;
 	int err;
 
 	output->fdsync_active = true;
-	atomic_inc(&output->total_fdsync_count);
-	
+
+	/* Group commit: other outputs on the same file may have
+	 * synced for us in the meantime, or may share our sync.
+	 */
 	latency = TIME_STATS(
 		&timings[2],
-		err = aio_sync(output->mf->mf_filp)
+		err = mf_group_sync(output->mf, aio_sync, &saved)
 		);
-	
-	threshold_check(&aio_sync_threshold, latency);
+
+	if (saved) {
+		atomic_inc(&output->total_fdsync_saved_count);
+	} else {
+		atomic_inc(&output->total_fdsync_count);
+		threshold_check(&aio_sync_threshold, latency);
+	}
+	// includes the coalescing window and waiting for others
+	output->total_fdsync_delay_ns += cpu_clock(raw_smp_processor_id()) - start_stamp;
 
 	output->fdsync_active = false;
 	wake_up_interruptible_all(&output->fdsync_event);
@@ -546,32 +568,46 @@ int aio_sync_thread(void *data)
 
 	while (!brick_thread_should_stop() || atomic_read(&tinfo->queued_sum) > 0) {
 		LIST_HEAD(tmp_list);
-		unsigned long flags;
+		unsigned long long start_stamp;
+		int window_us;
+		int count = 0;
 		int i;
 
+		_aio_check_node(tinfo);
+
 		output->fdsync_active = false;
 		wake_up_interruptible_all(&output->fdsync_event);
 
-		wait_event_interruptible_timeout(
-			tinfo->event,
-			atomic_read(&tinfo->queued_sum) > 0,
-			HZ / 4);
+		aio_wait_for_work(tinfo, HZ / 4);
 
-		traced_lock(&tinfo->lock, flags);
+		if (atomic_read(&tinfo->queued_sum) <= 0)
+			continue;
+
+		/* Coalescing window: collect further requests arriving
+		 * shortly after the first one, all of them are then
+		 * covered by a single sync.
+		 */
+		start_stamp = cpu_clock(raw_smp_processor_id());
+		window_us = aio_sync_window_us;
+		if (window_us > 0 && window_us <= AIO_SYNC_WINDOW_MAX && !brick_thread_should_stop()) {
+			usleep_range(window_us, window_us + window_us / 4 + 1);
+		}
+
+		aio_fetch_pushed(tinfo);
 		for (i = 0; i < MARS_PRIO_NR; i++) {
 			struct list_head *start = &tinfo->mref_list[i];
-			if (!list_empty(start)) {
-				// move over the whole list
-				list_replace_init(start, &tmp_list);
-				atomic_sub(tinfo->queued[i], &tinfo->queued_sum);
-				tinfo->queued[i] = 0;
-				break;
-			}
+			struct list_head *tmp;
+
+			// move over the whole list, one sync covers all priorities
+			for (tmp = start->next; tmp != start; tmp = tmp->next)
+				count++;
+			list_splice_tail_init(start, &tmp_list);
 		}
-		traced_unlock(&tinfo->lock, flags);
+		atomic_sub(count, &tinfo->queued_sum);
 
 		if (!list_empty(&tmp_list)) {
-			aio_sync_all(output, &tmp_list);
+			atomic_add(count, &output->total_fdsync_mref_count);
+			aio_sync_all(output, &tmp_list, start_stamp);
 		}
 	}
 
@@ -608,6 +644,8 @@ static int aio_event_thread(void *data)
 		};
 		struct io_event events[MARS_MAX_AIO_READ];
 
+		_aio_check_node(tinfo);
+
 		oldfs = get_fs();
 		set_fs(get_ds());
 		/* TODO: don't timeout upon termination.
@@ -646,7 +684,7 @@ static int aio_event_thread(void *data)
 				    output->mf->mf_filp->f_op &&
 				    !output->mf->mf_filp->f_op->aio_fsync) {
 					mars_trace(mref, "aio_fsync");
-					_enqueue(other, mref_a, mref->ref_prio, true);
+					aio_enqueue(other, mref_a, mref->ref_prio);
 					continue;
 				}
 				err = aio_submit(output, mref_a, true);
@@ -796,92 +834,134 @@ int _create_ioctx(struct aio_output *output)
 	return err;
 }
 
+/* Returns true when the mref is ready for submission.
+ * Otherwise it has been requeued or completed.
+ */
+static
+bool _aio_prepare(struct aio_output *output, struct aio_threadinfo *tinfo, struct aio_mref_aspect *mref_a)
+{
+	struct mref_object *mref = mref_a->object;
+
+	if (unlikely(!mref)) {
+		MARS_ERR("bad mref pointer\n");
+		return false;
+	}
+
+	mapfree_set(output->mf, mref->ref_pos, -1);
+
+	mref_a->di.dirty_stage = 0;
+	if (mref->ref_rw) {
+		mf_insert_dirty(output->mf, &mref_a->di);
+	}
+
+	mref->ref_total_size = get_total_size(output);
+
+	// check for reads crossing the EOF boundary (special case)
+	if (mref->ref_timeout > 0 &&
+	    !mref->ref_rw &&
+	    mref->ref_pos + mref->ref_len > mref->ref_total_size) {
+		loff_t len = mref->ref_total_size - mref->ref_pos;
+		if (len > 0) {
+			if (mref->ref_len > len)
+				mref->ref_len = len;
+		} else {
+			if (!mref_a->start_jiffies) {
+				mref_a->start_jiffies = jiffies;
+			}
+			if ((long long)jiffies - mref_a->start_jiffies <= mref->ref_timeout) {
+				if (atomic_read(&tinfo->queued_sum) <= 0) {
+					atomic_inc(&output->total_msleep_count);
+					brick_msleep(1000 * 4 / HZ);
+				}
+				aio_enqueue(tinfo, mref_a, MARS_PRIO_LOW);
+				return false;
+			}
+			MARS_DBG("ENODATA %lld\n", len);
+			_complete(output, mref_a, -ENODATA);
+			return false;
+		}
+	}
+	return true;
+}
+
 static int aio_submit_thread(void *data)
 {
 	struct aio_threadinfo *tinfo = data;
 	struct aio_output *output = tinfo->output;
 	struct file *file;
-	int err = -EINVAL;
+	struct iocb *iocbs;
+	int err = -ENOMEM;
 
 	MARS_DBG("submit thread has started.\n");
 
 	file = output->mf->mf_filp;
 
+	iocbs = brick_mem_alloc(AIO_BATCH_MAX * sizeof(struct iocb));
+	if (unlikely(!iocbs))
+		goto out;
+
+	err = -EINVAL;
 	use_fake_mm();
 
 	while (!brick_thread_should_stop() || atomic_read(&output->read_count) + atomic_read(&output->write_count) + atomic_read(&tinfo->queued_sum) > 0) {
-		struct aio_mref_aspect *mref_a;
-		struct mref_object *mref;
+		struct aio_mref_aspect *batch[AIO_BATCH_MAX];
+		struct iocb *iocbp[AIO_BATCH_MAX];
+		int max = aio_submit_batch;
+		int count;
+		int nr;
+		int done;
 		int sleeptime;
-		int status;
-
-		wait_event_interruptible_timeout(
-			tinfo->event,
-			atomic_read(&tinfo->queued_sum) > 0,
-			HZ / 4);
-
-		mref_a = _dequeue(tinfo);
-		if (!mref_a) {
-			continue;
-		}
+		int i;
 
-		mref = mref_a->object;
-		status = -EINVAL;
-		CHECK_PTR(mref, error);
+		_aio_check_node(tinfo);
 
-		mapfree_set(output->mf, mref->ref_pos, -1);
+		aio_wait_for_work(tinfo, HZ / 4);
 
-		mref_a->di.dirty_stage = 0;
-		if (mref->ref_rw) {
-			mf_insert_dirty(output->mf, &mref_a->di);
-		}
+		if (max < 1)
+			max = 1;
+		else if (max > AIO_BATCH_MAX)
+			max = AIO_BATCH_MAX;
 
-		mref->ref_total_size = get_total_size(output);
+		count = _dequeue_batch(tinfo, batch, max);
 
-		// check for reads crossing the EOF boundary (special case)
-		if (mref->ref_timeout > 0 &&
-		    !mref->ref_rw &&
-		    mref->ref_pos + mref->ref_len > mref->ref_total_size) {
-			loff_t len = mref->ref_total_size - mref->ref_pos;
-			if (len > 0) {
-				if (mref->ref_len > len)
-					mref->ref_len = len;
-			} else {
-				if (!mref_a->start_jiffies) {
-					mref_a->start_jiffies = jiffies;
-				}
-				if ((long long)jiffies - mref_a->start_jiffies <= mref->ref_timeout) {
-					if (atomic_read(&tinfo->queued_sum) <= 0) {
-						atomic_inc(&output->total_msleep_count);
-						brick_msleep(1000 * 4 / HZ);
-					}
-					_enqueue(tinfo, mref_a, MARS_PRIO_LOW, true);
-					continue;
-				}
-				MARS_DBG("ENODATA %lld\n", len);
-				_complete(output, mref_a, -ENODATA);
+		nr = 0;
+		for (i = 0; i < count; i++) {
+			if (!_aio_prepare(output, tinfo, batch[i]))
 				continue;
-			}
+			batch[nr] = batch[i];
+			_aio_fill_iocb(output, batch[nr], false, &iocbs[nr]);
+			iocbp[nr] = &iocbs[nr];
+			nr++;
 		}
 
+		/* io_submit() may accept only a part of the array.
+		 * The rest is retried, keeping the order.
+		 */
+		done = 0;
 		sleeptime = 1;
-		for (;;) {
-			status = aio_submit(output, mref_a, false);
-
-			if (likely(status != -EAGAIN)) {
-				mref_a->di.dirty_stage = 1;
-				break;
+		while (done < nr) {
+			int status = aio_submit_iocbs(output, iocbp + done, nr - done, batch[done]->object->ref_rw);
+
+			if (likely(status > 0)) {
+				for (i = done; i < done + status; i++)
+					batch[i]->di.dirty_stage = 1;
+				done += status;
+				sleeptime = 1;
+				continue;
 			}
-			atomic_inc(&output->total_delay_count);
-			brick_msleep(sleeptime);
-			if (sleeptime < 100) {
-				sleeptime++;
+			if (status == -EAGAIN || !status) {
+				atomic_inc(&output->total_delay_count);
+				brick_msleep(sleeptime);
+				if (sleeptime < 100) {
+					sleeptime++;
+				}
+				continue;
 			}
-		}
-	error:
-		if (unlikely(status < 0)) {
+			// the first one is bad, the others may be ok
 			MARS_IO("submit_count = %d status = %d\n", atomic_read(&output->submit_count), status);
-			_complete_mref(output, mref, status);
+			batch[done]->di.dirty_stage = 1;
+			_complete(output, batch[done], status);
+			done++;
 		}
 	}
 
@@ -891,6 +971,8 @@ static int aio_submit_thread(void *data)
 		unuse_fake_mm();
 	}
 
+	brick_mem_free(iocbs);
+out:
 	tinfo->terminated = true;
 	wake_up_interruptible_all(&tinfo->terminate_event);
 	return err;
@@ -924,10 +1006,13 @@ char *aio_statistics(struct aio_brick *brick, int verbose)
 	struct aio_output *output = brick->outputs[0];
 	char *res = brick_string_alloc(4096);
 	char *sync = NULL;
+	int nr_syncs;
 	int pos = 0;
 	if (!res)
 		return NULL;
 
+	nr_syncs = atomic_read(&output->total_fdsync_count) + atomic_read(&output->total_fdsync_saved_count);
+
 	pos += report_timing(&timings[0], res + pos, 4096 - pos);
 	pos += report_timing(&timings[1], res + pos, 4096 - pos);
 	pos += report_timing(&timings[2], res + pos, 4096 - pos);
@@ -938,12 +1023,22 @@ char *aio_statistics(struct aio_brick *brick, int verbose)
 		 "writes = %d "
 		 "allocs = %d "
 		 "submits = %d "
+		 "submit_calls = %d "
 		 "again = %d "
 		 "delays = %d "
 		 "msleeps = %d "
 		 "fdsyncs = %d "
 		 "fdsync_waits = %d "
+		 "fdsync_saved = %d "
+		 "fdsync_mrefs = %d "
+		 "fdsync_delay_us = %lld "
 		 "map_free = %d | "
+		 "batch_1 = %d "
+		 "batch_2 = %d "
+		 "batch_4 = %d "
+		 "batch_8 = %d "
+		 "batch_16 = %d "
+		 "batch_32 = %d | "
 		 "flying reads = %d "
 		 "writes = %d "
 		 "allocs = %d "
@@ -955,17 +1050,30 @@ char *aio_statistics(struct aio_brick *brick, int verbose)
 		 "q0 = %d "
 		 "q1 = %d "
 		 "q2 = %d "
+		 "| wakeups "
+		 "q0 = %d "
+		 "q2 = %d "
 		 "%s\n",
 		 atomic_read(&output->total_read_count),
 		 atomic_read(&output->total_write_count),
 		 atomic_read(&output->total_alloc_count),
 		 atomic_read(&output->total_submit_count),
+		 atomic_read(&output->total_submit_calls),
 		 atomic_read(&output->total_again_count),
 		 atomic_read(&output->total_delay_count),
 		 atomic_read(&output->total_msleep_count),
 		 atomic_read(&output->total_fdsync_count),
 		 atomic_read(&output->total_fdsync_wait_count),
+		 atomic_read(&output->total_fdsync_saved_count),
+		 atomic_read(&output->total_fdsync_mref_count),
+		 nr_syncs > 0 ? output->total_fdsync_delay_ns / 1000 / nr_syncs : 0,
 		 atomic_read(&output->total_mapfree_count),
+		 atomic_read(&output->total_batch_hist[0]),
+		 atomic_read(&output->total_batch_hist[1]),
+		 atomic_read(&output->total_batch_hist[2]),
+		 atomic_read(&output->total_batch_hist[3]),
+		 atomic_read(&output->total_batch_hist[4]),
+		 atomic_read(&output->total_batch_hist[5]),
 		 atomic_read(&output->read_count),
 		 atomic_read(&output->write_count),
 		 atomic_read(&output->alloc_count),
@@ -976,6 +1084,8 @@ char *aio_statistics(struct aio_brick *brick, int verbose)
 		 atomic_read(&output->tinfo[0].total_enqueue_count),
 		 atomic_read(&output->tinfo[1].total_enqueue_count),
 		 atomic_read(&output->tinfo[2].total_enqueue_count),
+		 atomic_read(&output->tinfo[0].total_wakeup_count),
+		 atomic_read(&output->tinfo[2].total_wakeup_count),
 		 sync ? sync : "");
 	
 	if (sync)
@@ -998,10 +1108,18 @@ void aio_reset_statistics(struct aio_brick *brick)
 	atomic_set(&output->total_msleep_count, 0);
 	atomic_set(&output->total_fdsync_count, 0);
 	atomic_set(&output->total_fdsync_wait_count, 0);
+	atomic_set(&output->total_fdsync_saved_count, 0);
+	atomic_set(&output->total_fdsync_mref_count, 0);
+	output->total_fdsync_delay_ns = 0;
 	atomic_set(&output->total_mapfree_count, 0);
+	atomic_set(&output->total_submit_calls, 0);
+	for (i = 0; i < AIO_BATCH_HIST; i++) {
+		atomic_set(&output->total_batch_hist[i], 0);
+	}
 	for (i = 0; i < 3; i++) {
 		struct aio_threadinfo *tinfo = &output->tinfo[i];
 		atomic_set(&tinfo->total_enqueue_count, 0);
+		atomic_set(&tinfo->total_wakeup_count, 0);
 	}
 }
 
@@ -1030,6 +1148,7 @@ MARS_MAKE_STATICS(aio);
 
 static int aio_brick_construct(struct aio_brick *brick)
 {
+	brick->numa_node = -1;
 	return 0;
 }
 
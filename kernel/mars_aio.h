@@ -23,9 +23,26 @@ extern struct threshold aio_sync_threshold;
  */
 extern int aio_sync_mode;
 
+/* aio_submit_batch:
+ * max number of mrefs handed over to a single io_submit() call.
+ */
+#define AIO_BATCH_MAX  32
+#define AIO_BATCH_HIST  6 // log2 buckets 1, 2-3, 4-7, 8-15, 16-31, 32
+
+extern int aio_submit_batch;
+
+/* aio_sync_window_us:
+ * wait that long for further sync requests before syncing (group commit).
+ * 0 = off (default), since the delay hurts single synchronous writers.
+ */
+#define AIO_SYNC_WINDOW_MAX 10000
+
+extern int aio_sync_window_us;
+
 struct aio_mref_aspect {
 	GENERIC_ASPECT(mref);
 	struct list_head io_head;
+	struct aio_mref_aspect *io_next; // lock-free push list
 	struct dirty_info di;
 	unsigned long long enqueue_stamp;
 	long long start_jiffies;
@@ -41,6 +58,7 @@ struct aio_brick {
 	bool o_direct;
 	bool o_fdsync;
 	bool is_static_device;
+	int numa_node; // home node for the threads (-1 = none)
 };
 
 struct aio_input {
@@ -48,15 +66,19 @@ struct aio_input {
 };
 
 struct aio_threadinfo {
+	// filled by any producer, drained only by our thread
+	struct aio_mref_aspect *push_list[MARS_PRIO_NR];
+	// private to our thread
 	struct list_head mref_list[MARS_PRIO_NR];
 	struct aio_output *output;
 	struct task_struct *thread;
 	wait_queue_head_t event;
 	wait_queue_head_t terminate_event;
-	spinlock_t lock;
-	int queued[MARS_PRIO_NR];
 	atomic_t queued_sum;
 	atomic_t total_enqueue_count;
+	atomic_t total_wakeup_count;
+	int numa_node;
+	bool consumer_idle;
 	bool terminated;
 };
 
@@ -80,7 +102,12 @@ struct aio_output {
 	atomic_t total_msleep_count;
 	atomic_t total_fdsync_count;
 	atomic_t total_fdsync_wait_count;
+	atomic_t total_fdsync_saved_count;
+	atomic_t total_fdsync_mref_count;
+	long long total_fdsync_delay_ns;
 	atomic_t total_mapfree_count;
+	atomic_t total_submit_calls;
+	atomic_t total_batch_hist[AIO_BATCH_HIST];
 	atomic_t read_count;
 	atomic_t write_count;
 	atomic_t alloc_count;
@@ -89,4 +116,85 @@ struct aio_output {
 
 MARS_TYPES(aio);
 
+////////////////// queueing //////////////////
+
+/* Lock-free multi-producer / single-consumer queueing.
+ * Producers push onto a per-priority stack by cmpxchg().
+ * Only the thread owning the tinfo takes the whole stack off by xchg(),
+ * thus no ABA problem can arise. The FIFO order is restored in the
+ * private lists of the consumer.
+ * Wakeups are only sent when the consumer has announced to be idle.
+ */
+static inline
+void aio_enqueue(struct aio_threadinfo *tinfo, struct aio_mref_aspect *mref_a, int prio)
+{
+	struct aio_mref_aspect *old;
+#if 1
+	prio++;
+	if (unlikely(prio < 0)) {
+		prio = 0;
+	} else if (unlikely(prio >= MARS_PRIO_NR)) {
+		prio = MARS_PRIO_NR - 1;
+	}
+#else
+	prio = 0;
+#endif
+
+	mref_a->enqueue_stamp = cpu_clock(raw_smp_processor_id());
+
+	// count first, such that queued_sum never goes negative
+	atomic_inc(&tinfo->queued_sum);
+	atomic_inc(&tinfo->total_enqueue_count);
+
+	do {
+		old = ACCESS_ONCE(tinfo->push_list[prio]);
+		mref_a->io_next = old;
+	} while (cmpxchg(&tinfo->push_list[prio], old, mref_a) != old);
+
+	// pairs with aio_wait_for_work()
+	smp_mb();
+	if (ACCESS_ONCE(tinfo->consumer_idle)) {
+		atomic_inc(&tinfo->total_wakeup_count);
+		wake_up_interruptible(&tinfo->event);
+	}
+}
+
+/* Only to be called by the consumer.
+ */
+static inline
+void aio_fetch_pushed(struct aio_threadinfo *tinfo)
+{
+	int prio;
+
+	for (prio = 0; prio < MARS_PRIO_NR; prio++) {
+		struct aio_mref_aspect *mref_a;
+		LIST_HEAD(tmp_list);
+
+		if (!ACCESS_ONCE(tinfo->push_list[prio]))
+			continue;
+		mref_a = xchg(&tinfo->push_list[prio], NULL);
+		// reverse the stack
+		while (mref_a) {
+			struct aio_mref_aspect *next = mref_a->io_next;
+			mref_a->io_next = NULL;
+			list_add(&mref_a->io_head, &tmp_list);
+			mref_a = next;
+		}
+		list_splice_tail(&tmp_list, &tinfo->mref_list[prio]);
+	}
+}
+
+static inline
+void aio_wait_for_work(struct aio_threadinfo *tinfo, int timeout)
+{
+	tinfo->consumer_idle = true;
+	// pairs with aio_enqueue()
+	smp_mb();
+	wait_event_interruptible_timeout(
+		tinfo->event,
+		atomic_read(&tinfo->queued_sum) > 0,
+		timeout);
+	tinfo->consumer_idle = false;
+}
+
 #endif
@@ -0,0 +1,312 @@
+// (c) 2010 Thomas Schoebel-Theuer / 1&1 Internet AG
+// (c) 2026 Thomas Schoebel-Theuer
+
+// Microbenchmark of the aio request queueing (only for development)
+
+/* Loading this module runs N producer threads enqueueing into one aio
+ * threadinfo, drained by a single consumer thread, once with the
+ * lock-free queueing of mars_aio.h and once with the former spinlock
+ * based queueing (which woke all waiters on every enqueue).
+ * The results go to the kernel log. The module can be removed at once.
+ */
+
+//#define BRICK_DEBUGGING
+//#define MARS_DEBUGGING
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/vmalloc.h>
+
+#include "mars.h"
+#include "mars_aio.h"
+
+static int producers = 0;
+module_param(producers, int, 0444);
+MODULE_PARM_DESC(producers, "number of producer threads (0 = online CPUs)");
+
+static int count = 10000;
+module_param(count, int, 0444);
+MODULE_PARM_DESC(count, "enqueues per producer");
+
+struct bench_ctx {
+	struct aio_threadinfo tinfo;
+	bool locked;
+	// former queueing
+	spinlock_t lock;
+	struct list_head locked_list[MARS_PRIO_NR];
+	// common
+	struct aio_mref_aspect *items;
+	int total;
+	atomic_t started;
+	bool go;
+	atomic64_t enqueue_ns;
+	atomic_t consumed;
+	struct completion done;
+};
+
+struct bench_producer {
+	struct bench_ctx *ctx;
+	int index;
+};
+
+///////////////////////// former queueing ////////////////////////
+
+static
+void _locked_enqueue(struct bench_ctx *ctx, struct aio_mref_aspect *mref_a, int prio)
+{
+	struct aio_threadinfo *tinfo = &ctx->tinfo;
+	unsigned long flags;
+
+	prio++;
+	if (unlikely(prio < 0)) {
+		prio = 0;
+	} else if (unlikely(prio >= MARS_PRIO_NR)) {
+		prio = MARS_PRIO_NR - 1;
+	}
+
+	mref_a->enqueue_stamp = cpu_clock(raw_smp_processor_id());
+
+	traced_lock(&ctx->lock, flags);
+	list_add_tail(&mref_a->io_head, &ctx->locked_list[prio]);
+	atomic_inc(&tinfo->queued_sum);
+	traced_unlock(&ctx->lock, flags);
+
+	atomic_inc(&tinfo->total_enqueue_count);
+	atomic_inc(&tinfo->total_wakeup_count);
+	wake_up_interruptible_all(&tinfo->event);
+}
+
+static
+int _locked_dequeue(struct bench_ctx *ctx)
+{
+	struct aio_threadinfo *tinfo = &ctx->tinfo;
+	unsigned long flags;
+	int nr = 0;
+	int prio;
+
+	wait_event_interruptible_timeout(
+		tinfo->event,
+		atomic_read(&tinfo->queued_sum) > 0,
+		HZ / 4);
+
+	traced_lock(&ctx->lock, flags);
+	for (prio = 0; prio < MARS_PRIO_NR && nr < AIO_BATCH_MAX; prio++) {
+		struct list_head *start = &ctx->locked_list[prio];
+		while (start->next != start && nr < AIO_BATCH_MAX) {
+			list_del_init(start->next);
+			atomic_dec(&tinfo->queued_sum);
+			nr++;
+		}
+	}
+	traced_unlock(&ctx->lock, flags);
+	return nr;
+}
+
+///////////////////////// lock-free queueing ////////////////////////
+
+static
+int _lockfree_dequeue(struct bench_ctx *ctx)
+{
+	struct aio_threadinfo *tinfo = &ctx->tinfo;
+	int nr = 0;
+	int prio;
+
+	if (atomic_read(&tinfo->queued_sum) <= 0)
+		aio_wait_for_work(tinfo, HZ / 4);
+
+	aio_fetch_pushed(tinfo);
+	for (prio = 0; prio < MARS_PRIO_NR && nr < AIO_BATCH_MAX; prio++) {
+		struct list_head *start = &tinfo->mref_list[prio];
+		while (start->next != start && nr < AIO_BATCH_MAX) {
+			list_del_init(start->next);
+			nr++;
+		}
+	}
+	atomic_sub(nr, &tinfo->queued_sum);
+	return nr;
+}
+
+///////////////////////// threads ////////////////////////
+
+static
+int bench_producer_thread(void *data)
+{
+	struct bench_producer *prod = data;
+	struct bench_ctx *ctx = prod->ctx;
+	struct aio_mref_aspect *items = ctx->items + prod->index * count;
+	unsigned long long start;
+	int i;
+
+	atomic_inc(&ctx->started);
+	while (!ACCESS_ONCE(ctx->go))
+		cond_resched();
+
+	start = cpu_clock(raw_smp_processor_id());
+	for (i = 0; i < count; i++) {
+		if (ctx->locked)
+			_locked_enqueue(ctx, &items[i], MARS_PRIO_NORMAL);
+		else
+			aio_enqueue(&ctx->tinfo, &items[i], MARS_PRIO_NORMAL);
+	}
+	atomic64_add(cpu_clock(raw_smp_processor_id()) - start, &ctx->enqueue_ns);
+
+	complete(&ctx->done);
+	return 0;
+}
+
+static
+int bench_consumer_thread(void *data)
+{
+	struct bench_ctx *ctx = data;
+
+	while (atomic_read(&ctx->consumed) < ctx->total) {
+		int nr;
+
+		if (ctx->locked)
+			nr = _locked_dequeue(ctx);
+		else
+			nr = _lockfree_dequeue(ctx);
+		atomic_add(nr, &ctx->consumed);
+	}
+
+	complete(&ctx->done);
+	return 0;
+}
+
+///////////////////////// one run ////////////////////////
+
+static
+int bench_run(struct bench_ctx *ctx, struct bench_producer *prod, int nr_producers, bool locked)
+{
+	struct task_struct *thread;
+	unsigned long long start;
+	unsigned long long elapsed;
+	int nr_threads = 0;
+	int status = 0;
+	int prio;
+	int i;
+
+	memset(&ctx->tinfo, 0, sizeof(ctx->tinfo));
+	init_waitqueue_head(&ctx->tinfo.event);
+	for (prio = 0; prio < MARS_PRIO_NR; prio++) {
+		INIT_LIST_HEAD(&ctx->tinfo.mref_list[prio]);
+		INIT_LIST_HEAD(&ctx->locked_list[prio]);
+	}
+	spin_lock_init(&ctx->lock);
+	memset(ctx->items, 0, sizeof(*ctx->items) * ctx->total);
+	for (i = 0; i < ctx->total; i++)
+		INIT_LIST_HEAD(&ctx->items[i].io_head);
+	ctx->locked = locked;
+	ctx->go = false;
+	atomic_set(&ctx->started, 0);
+	atomic64_set(&ctx->enqueue_ns, 0);
+	atomic_set(&ctx->consumed, 0);
+	init_completion(&ctx->done);
+
+	thread = kthread_run(bench_consumer_thread, ctx, "mars_bench_c");
+	if (IS_ERR(thread)) {
+		status = PTR_ERR(thread);
+		goto err;
+	}
+	nr_threads++;
+
+	for (i = 0; i < nr_producers; i++) {
+		prod[i].ctx = ctx;
+		prod[i].index = i;
+		thread = kthread_run(bench_producer_thread, &prod[i], "mars_bench_p%d", i);
+		if (IS_ERR(thread)) {
+			status = PTR_ERR(thread);
+			goto err;
+		}
+		nr_threads++;
+	}
+
+	while (atomic_read(&ctx->started) < nr_producers)
+		schedule();
+
+	start = cpu_clock(raw_smp_processor_id());
+	smp_wmb();
+	ctx->go = true;
+
+	for (i = 0; i < nr_threads; i++)
+		wait_for_completion(&ctx->done);
+	elapsed = cpu_clock(raw_smp_processor_id()) - start;
+
+	MARS_INF("%-9s producers = %d enqueues = %d | enqueue %lld ns/op | total %lld ns/op | wakeups = %d\n",
+		 locked ? "locked" : "lock-free",
+		 nr_producers,
+		 ctx->total,
+		 (long long)atomic64_read(&ctx->enqueue_ns) / ctx->total,
+		 (long long)elapsed / ctx->total,
+		 atomic_read(&ctx->tinfo.total_wakeup_count));
+	return 0;
+
+err:
+	MARS_ERR("cannot start thread, status = %d\n", status);
+	// let the started threads terminate
+	ctx->go = true;
+	if (nr_threads > 0) {
+		// the consumer would wait for never produced items
+		atomic_set(&ctx->consumed, ctx->total);
+		wake_up_interruptible_all(&ctx->tinfo.event);
+	}
+	for (i = 0; i < nr_threads; i++)
+		wait_for_completion(&ctx->done);
+	return status;
+}
+
+////////////////// module init stuff /////////////////////////
+
+int __init init_mars_aio_bench(void)
+{
+	struct bench_ctx *ctx;
+	struct bench_producer *prod = NULL;
+	int nr_producers = producers > 0 ? producers : num_online_cpus();
+	int status = -ENOMEM;
+
+	MARS_INF("init_aio_bench()\n");
+
+	if (unlikely(count <= 0 || nr_producers > 1024 || count > INT_MAX / nr_producers)) {
+		MARS_ERR("bad parameters producers = %d count = %d\n", nr_producers, count);
+		return -EINVAL;
+	}
+
+	ctx = brick_zmem_alloc(sizeof(struct bench_ctx));
+	if (unlikely(!ctx))
+		goto done;
+	ctx->total = nr_producers * count;
+	ctx->items = vmalloc(sizeof(*ctx->items) * ctx->total);
+	if (unlikely(!ctx->items))
+		goto done;
+	prod = brick_zmem_alloc(sizeof(*prod) * nr_producers);
+	if (unlikely(!prod))
+		goto done;
+
+	status = bench_run(ctx, prod, nr_producers, true);
+	if (status < 0)
+		goto done;
+	status = bench_run(ctx, prod, nr_producers, false);
+
+done:
+	if (status == -ENOMEM)
+		MARS_ERR("cannot allocate memory\n");
+	brick_mem_free(prod);
+	if (ctx)
+		vfree(ctx->items);
+	brick_mem_free(ctx);
+	return status;
+}
+
+void __exit exit_mars_aio_bench(void)
+{
+	MARS_INF("exit_aio_bench()\n");
+}
+
+MODULE_DESCRIPTION("MARS aio queueing microbenchmark");
+MODULE_LICENSE("GPL");
+
+module_init(init_mars_aio_bench);
+module_exit(exit_mars_aio_bench);
@@ -21,6 +21,12 @@
 int mars_client_abort = 10;
 EXPORT_SYMBOL_GPL(mars_client_abort);
 
+int mars_client_channels = 1;
+EXPORT_SYMBOL_GPL(mars_client_channels);
+
+int mars_client_stripe_kb = 1024;
+EXPORT_SYMBOL_GPL(mars_client_stripe_kb);
+
 ///////////////////////// own helper functions ////////////////////////
 
 static int thread_count = 0;
@@ -34,17 +40,39 @@ static void _kill_thread(struct client_threadinfo *ti, const char *name)
 	}
 }
 
-static void _kill_socket(struct client_output *output)
+static void _kill_socket(struct client_channel *ch)
+{
+	ch->output->brick->connection_state = 1;
+	if (mars_socket_is_alive(&ch->socket)) {
+		MARS_DBG("shutdown socket %d\n", ch->ch_nr);
+		mars_shutdown_socket(&ch->socket);
+	}
+	_kill_thread(&ch->receiver, "receiver");
+	ch->recv_error = 0;
+	MARS_DBG("close socket %d\n", ch->ch_nr);
+	mars_put_socket(&ch->socket);
+}
+
+static
+void _check_connected(struct client_output *output)
 {
-	output->brick->connection_state = 1;
-	if (mars_socket_is_alive(&output->socket)) {
-		MARS_DBG("shutdown socket\n");
-		mars_shutdown_socket(&output->socket);
-	}
-	_kill_thread(&output->receiver, "receiver");
-	output->recv_error = 0;
-	MARS_DBG("close socket\n");
-	mars_put_socket(&output->socket);
+	int i;
+
+	for (i = 0; i < output->nr_channels; i++) {
+		if (!mars_socket_is_alive(&output->channel[i].socket))
+			return;
+	}
+	output->brick->connection_state = 2;
+}
+
+static
+struct client_channel *_get_channel(struct client_output *output, struct mref_object *mref)
+{
+	int nr = 0;
+
+	if (output->nr_channels > 1)
+		nr = (mref->ref_pos / output->stripe_size) % output->nr_channels;
+	return &output->channel[nr];
 }
 
 static int _request_info(struct client_output *output)
@@ -55,7 +83,7 @@ static int _request_info(struct client_output *output)
 	int status;
 	
 	MARS_DBG("\n");
-	status = mars_send_struct(&output->socket, &cmd, mars_cmd_meta);
+	status = mars_send_struct(&output->channel[0].socket, &cmd, mars_cmd_meta);
 	if (unlikely(status < 0)) {
 		MARS_DBG("send of getinfo failed, status = %d\n", status);
 	}
@@ -64,32 +92,46 @@ static int _request_info(struct client_output *output)
 
 static int receiver_thread(void *data);
 
-static int _connect(struct client_output *output, const char *str)
+static int _parse_path(struct client_output *output, const char *str)
 {
+	int status = 0;
+
+	if (output->path)
+		goto done;
+
+	output->path = brick_strdup(str);
+	status = -ENOMEM;
+	if (!output->path) {
+		MARS_DBG("no mem\n");
+		goto done;
+	}
+	status = -EINVAL;
+	output->host = strchr(output->path, '@');
+	if (!output->host) {
+		brick_string_free(output->path);
+		output->path = NULL;
+		MARS_ERR("parameter string '%s' contains no remote specifier with '@'-syntax\n", str);
+		goto done;
+	}
+	*output->host++ = '\0';
+	status = 0;
+done:
+	return status;
+}
+
+static int _connect(struct client_channel *ch)
+{
+	struct client_output *output = ch->output;
 	struct sockaddr_storage sockaddr = {};
 	int status;
 
-	if (unlikely(!output->path)) {
-		output->path = brick_strdup(str);
-		status = -ENOMEM;
-		if (!output->path) {
-			MARS_DBG("no mem\n");
-			goto done;
-		}
-		status = -EINVAL;
-		output->host = strchr(output->path, '@');
-		if (!output->host) {
-			brick_string_free(output->path);
-			output->path = NULL;
-			MARS_ERR("parameter string '%s' contains no remote specifier with '@'-syntax\n", str);
-			goto done;
-		}
-		*output->host++ = '\0';
-	}
+	status = -EINVAL;
+	if (unlikely(!output->path || !output->host))
+		goto done;
 
-	if (unlikely(output->receiver.thread)) {
+	if (unlikely(ch->receiver.thread)) {
 		MARS_WRN("receiver thread unexpectedly not dead\n");
-		_kill_thread(&output->receiver, "receiver");
+		_kill_thread(&ch->receiver, "receiver");
 	}
 
 	status = mars_create_sockaddr(&sockaddr, output->host);
@@ -98,17 +140,17 @@ static int _connect(struct client_output *output, const char *str)
 		goto done;
 	}
 	
-	status = mars_create_socket(&output->socket, &sockaddr, false);
+	status = mars_create_socket(&ch->socket, &sockaddr, false);
 	if (unlikely(status < 0)) {
 		MARS_DBG("no socket, status = %d\n", status);
 		goto really_done;
 	}
-	output->socket.s_shutdown_on_err = true;
-	output->socket.s_send_abort = mars_client_abort;
-	output->socket.s_recv_abort = mars_client_abort;
+	ch->socket.s_shutdown_on_err = true;
+	ch->socket.s_send_abort = mars_client_abort;
+	ch->socket.s_recv_abort = mars_client_abort;
 
-	output->receiver.thread = brick_thread_create(receiver_thread, output, "mars_receiver%d", thread_count++);
-	if (unlikely(!output->receiver.thread)) {
+	ch->receiver.thread = brick_thread_create(receiver_thread, ch, "mars_receiver%d", thread_count++);
+	if (unlikely(!ch->receiver.thread)) {
 		MARS_ERR("cannot start receiver thread, status = %d\n", status);
 		status = -ENOENT;
 		goto done;
@@ -118,23 +160,25 @@ static int _connect(struct client_output *output, const char *str)
 	{
 		struct mars_cmd cmd = {
 			.cmd_code = CMD_CONNECT,
+			.cmd_int1 = ch->ch_nr,
+			.cmd_compress = output->brick->compress_mode,
 			.cmd_str1 = output->path,
 		};
 
-		status = mars_send_struct(&output->socket, &cmd, mars_cmd_meta);
+		status = mars_send_struct(&ch->socket, &cmd, mars_cmd_meta);
 		if (unlikely(status < 0)) {
 			MARS_DBG("send of connect failed, status = %d\n", status);
 			goto done;
 		}
 	}
-	if (status >= 0) {
+	if (status >= 0 && !ch->ch_nr) {
 		status = _request_info(output);
 	}
 
 done:
 	if (status < 0) {
-		MARS_INF("cannot connect to remote host '%s' (status = %d) -- retrying\n", output->host ? output->host : "NULL", status);
-		_kill_socket(output);
+		MARS_INF("cannot connect channel %d to remote host '%s' (status = %d) -- retrying\n", ch->ch_nr, output->host ? output->host : "NULL", status);
+		_kill_socket(ch);
 	}
 really_done:
 	return status;
@@ -148,7 +192,7 @@ static int client_get_info(struct client_output *output, struct mars_info *info)
 
 	output->got_info = false;
 	output->get_info = true;
-	wake_up_interruptible(&output->event);
+	wake_up_interruptible(&output->channel[0].event);
 	
 	wait_event_interruptible_timeout(output->info_event, output->got_info, 60 * HZ);
 	status = -EIO;
@@ -170,6 +214,15 @@ static int client_ref_get(struct client_output *output, struct mref_object *mref
 		return mref->ref_len;
 	}
 
+	/* Checksum-only reads transfer no data at all.
+	 * The server reads into its own buffer, thus they need
+	 * neither a local buffer nor a length limit.
+	 */
+	if (mref->ref_cs_mode > 1 && !mref->ref_rw && !mref->ref_data) {
+		_mref_get_first(mref);
+		return 0;
+	}
+
 #if 1
 	/* Limit transfers to page boundaries.
 	 * Currently, this is more restrictive than necessary.
@@ -214,12 +267,13 @@ static
 void _hash_insert(struct client_output *output, struct client_mref_aspect *mref_a)
 {
 	struct mref_object *mref = mref_a->object;
+	struct client_channel *ch = _get_channel(output, mref);
 	unsigned long flags;
 	int hash_index;
 
 	traced_lock(&output->lock, flags);
 	list_del(&mref_a->io_head);
-	list_add_tail(&mref_a->io_head, &output->mref_list);
+	list_add_tail(&mref_a->io_head, &ch->mref_list);
 	list_del(&mref_a->hash_head);
 	mref->ref_id = ++output->last_id;
 	hash_index = mref->ref_id % CLIENT_HASH_MAX;
@@ -255,7 +309,7 @@ static void client_ref_io(struct client_output *output, struct mref_object *mref
 
 	MARS_IO("added request id = %d pos = %lld len = %d rw = %d (flying = %d)\n", mref->ref_id, mref->ref_pos, mref->ref_len, mref->ref_rw, atomic_read(&output->fly_count));
 
-	wake_up_interruptible(&output->event);
+	wake_up_interruptible(&_get_channel(output, mref)->event);
 
 	return;
 
@@ -268,7 +322,8 @@ error:
 static
 int receiver_thread(void *data)
 {
-	struct client_output *output = data;
+	struct client_channel *ch = data;
+	struct client_output *output = ch->output;
 	int status = 0;
 
         while (!brick_thread_should_stop()) {
@@ -278,7 +333,7 @@ int receiver_thread(void *data)
 		struct mref_object *mref = NULL;
 		unsigned long flags;
 
-		status = mars_recv_struct(&output->socket, &cmd, mars_cmd_meta);
+		status = mars_recv_struct(&ch->socket, &cmd, mars_cmd_meta);
 		MARS_IO("got cmd = %d status = %d\n", cmd.cmd_code, status);
 		if (status < 0)
 			goto done;
@@ -293,6 +348,8 @@ int receiver_thread(void *data)
 				MARS_ERR("at remote side: brick connect failed, remote status = %d\n", status);
 				goto done;
 			}
+			// old servers don't answer cmd_compress, leaving it 0
+			ch->socket.s_compress = cmd.cmd_compress;
 			break;
 		case CMD_CB:
 		{
@@ -326,7 +383,12 @@ int receiver_thread(void *data)
 
 			MARS_IO("got callback id = %d, old pos = %lld len = %d rw = %d\n", mref->ref_id, mref->ref_pos, mref->ref_len, mref->ref_rw);
 
-			status = mars_recv_cb(&output->socket, mref, &cmd);
+			/* Old servers don't report the digest algorithm,
+			 * they always use MD5.
+			 */
+			mref->ref_cs_algo = MARS_DIGEST_MD5;
+
+			status = mars_recv_cb(&ch->socket, mref, &cmd);
 			MARS_IO("new status = %d, pos = %lld len = %d rw = %d\n", status, mref->ref_pos, mref->ref_len, mref->ref_rw);
 			if (unlikely(status < 0)) {
 				MARS_WRN("interrupted data transfer during callback, status = %d\n", status);
@@ -334,6 +396,10 @@ int receiver_thread(void *data)
 				goto done;
 			}
 
+			// zero-copy write data must not be re-used too early
+			if (mref->ref_rw)
+				mars_pin_wait(&ch->socket, mref);
+
 			SIMPLE_CALLBACK(mref, mref->_object_cb.cb_error);
 
 			client_ref_put(output, mref);
@@ -343,7 +409,7 @@ int receiver_thread(void *data)
 			break;
 		}
 		case CMD_GETINFO:
-			status = mars_recv_struct(&output->socket, &output->info, mars_info_meta);
+			status = mars_recv_struct(&ch->socket, &output->info, mars_info_meta);
 			if (status < 0) {
 				MARS_WRN("got bad info from remote side, status = %d\n", status);
 				goto done;
@@ -359,38 +425,39 @@ int receiver_thread(void *data)
 	done:
 		brick_string_free(cmd.cmd_str1);
 		if (unlikely(status < 0)) {
-			if (!output->recv_error) {
-				MARS_DBG("signalling status = %d\n", status);
-				output->recv_error = status;
+			if (!ch->recv_error) {
+				MARS_DBG("channel %d signalling status = %d\n", ch->ch_nr, status);
+				ch->recv_error = status;
 			}
-			wake_up_interruptible(&output->event);
+			wake_up_interruptible(&ch->event);
 			brick_msleep(100);
 		}
 	}
 
 	if (status < 0) {
-		MARS_WRN("receiver thread terminated with status = %d, recv_error = %d\n", status, output->recv_error);
+		MARS_WRN("receiver thread %d terminated with status = %d, recv_error = %d\n", ch->ch_nr, status, ch->recv_error);
 	}
 
-	mars_shutdown_socket(&output->socket);
-	wake_up_interruptible(&output->receiver.run_event);
+	mars_shutdown_socket(&ch->socket);
+	wake_up_interruptible(&ch->receiver.run_event);
 	return status;
 }
 
 static
-void _do_resubmit(struct client_output *output)
+void _do_resubmit(struct client_channel *ch)
 {
+	struct client_output *output = ch->output;
 	unsigned long flags;
 
 	traced_lock(&output->lock, flags);
-	if (!list_empty(&output->wait_list)) {
-		struct list_head *first = output->wait_list.next;
-		struct list_head *last = output->wait_list.prev;
-		struct list_head *old_start = output->mref_list.next;
+	if (!list_empty(&ch->wait_list)) {
+		struct list_head *first = ch->wait_list.next;
+		struct list_head *last = ch->wait_list.prev;
+		struct list_head *old_start = ch->mref_list.next;
 #define list_connect __list_del // the original routine has a misleading name: in reality it is more general
-		list_connect(&output->mref_list, first);
+		list_connect(&ch->mref_list, first);
 		list_connect(last, old_start);
-		INIT_LIST_HEAD(&output->wait_list);
+		INIT_LIST_HEAD(&ch->wait_list);
 		MARS_IO("done re-submit %p %p\n", first, last);
 	}
 	traced_unlock(&output->lock, flags);
@@ -464,57 +531,58 @@ void _do_timeout(struct client_output *output, struct list_head *anchor, bool fo
 
 static int sender_thread(void *data)
 {
-	struct client_output *output = data;
+	struct client_channel *ch = data;
+	struct client_output *output = ch->output;
 	struct client_brick *brick = output->brick;
 	unsigned long flags;
 	bool do_kill = false;
 	int status = 0;
 
-	output->receiver.restart_count = 0;
+	ch->receiver.restart_count = 0;
 
         while (!brick_thread_should_stop()) {
 		struct list_head *tmp = NULL;
 		struct client_mref_aspect *mref_a;
 		struct mref_object *mref;
 
-		if (unlikely(output->recv_error != 0 || !mars_socket_is_alive(&output->socket))) {
-			MARS_DBG("recv_error = %d do_kill = %d\n", output->recv_error, do_kill);
+		if (unlikely(ch->recv_error != 0 || !mars_socket_is_alive(&ch->socket))) {
+			MARS_DBG("channel %d recv_error = %d do_kill = %d\n", ch->ch_nr, ch->recv_error, do_kill);
 			if (do_kill) {
 				do_kill = false;
-				_kill_socket(output);
+				_kill_socket(ch);
 				brick_msleep(3000);
 			}
 
-			status = _connect(output, brick->brick_name);
+			status = _connect(ch);
 			MARS_IO("connect status = %d\n", status);
 			if (unlikely(status < 0)) {
 				brick_msleep(3000);
-				_do_timeout(output, &output->wait_list, false);
-				_do_timeout(output, &output->mref_list, false);
+				_do_timeout(output, &ch->wait_list, false);
+				_do_timeout(output, &ch->mref_list, false);
 				continue;
 			}
-			brick->connection_state = 2;
+			_check_connected(output);
 			do_kill = true;
 			/* Re-Submit any waiting requests
 			 */
 			MARS_IO("re-submit\n");
-			_do_resubmit(output);
+			_do_resubmit(ch);
 		}
 		
-		wait_event_interruptible_timeout(output->event,
-						 !list_empty(&output->mref_list) ||
-						 output->get_info ||
-						 output->recv_error != 0 ||
+		wait_event_interruptible_timeout(ch->event,
+						 !list_empty(&ch->mref_list) ||
+						 (output->get_info && !ch->ch_nr) ||
+						 ch->recv_error != 0 ||
 						 brick_thread_should_stop(),
 						 1 * HZ);
 
-		if (unlikely(output->recv_error != 0)) {
-			MARS_DBG("recv_error = %d\n", output->recv_error);
+		if (unlikely(ch->recv_error != 0)) {
+			MARS_DBG("channel %d recv_error = %d\n", ch->ch_nr, ch->recv_error);
 			brick_msleep(1000);
 			continue;
 		}
 		
-		if (output->get_info) {
+		if (output->get_info && !ch->ch_nr) {
 			status = _request_info(output);
 			if (status >= 0) {
 				output->get_info = false;
@@ -527,13 +595,13 @@ static int sender_thread(void *data)
 		/* Grab the next mref from the queue
 		 */
 		traced_lock(&output->lock, flags);
-		if (list_empty(&output->mref_list)) {
+		if (list_empty(&ch->mref_list)) {
 			traced_unlock(&output->lock, flags);
 			continue;
 		}
-		tmp = output->mref_list.next;
+		tmp = ch->mref_list.next;
 		list_del(tmp);
-		list_add(tmp, &output->wait_list);
+		list_add(tmp, &ch->wait_list);
 		mref_a = container_of(tmp, struct client_mref_aspect, io_head);
 		traced_unlock(&output->lock, flags);
 
@@ -548,15 +616,15 @@ static int sender_thread(void *data)
 
 		MARS_IO("sending mref, id = %d pos = %lld len = %d rw = %d\n", mref->ref_id, mref->ref_pos, mref->ref_len, mref->ref_rw);
 
-		status = mars_send_mref(&output->socket, mref);
+		status = mars_send_mref(&ch->socket, mref);
 		MARS_IO("status = %d\n", status);
 		if (unlikely(status < 0)) {
 			// retry submission on next occasion..
-			MARS_WRN("sending failed, status = %d\n", status);
+			MARS_WRN("channel %d sending failed, status = %d\n", ch->ch_nr, status);
 
 			if (do_kill) {
 				do_kill = false;
-				_kill_socket(output);
+				_kill_socket(ch);
 			}
 			_hash_insert(output, mref_a);
 			brick_msleep(1000);
@@ -565,11 +633,11 @@ static int sender_thread(void *data)
 	}
 //done:
 	if (status < 0) {
-		MARS_WRN("sender thread terminated with status = %d\n", status);
+		MARS_WRN("sender thread %d terminated with status = %d\n", ch->ch_nr, status);
 	}
 
 	if (do_kill) {
-		_kill_socket(output);
+		_kill_socket(ch);
 	}
 
 	/* Signal error on all pending IO requests.
@@ -577,10 +645,10 @@ static int sender_thread(void *data)
 	 * this until destruction which is probably not what
 	 * we want).
 	 */
-	_do_timeout(output, &output->wait_list, true);
-	_do_timeout(output, &output->mref_list, true);
+	_do_timeout(output, &ch->wait_list, true);
+	_do_timeout(output, &ch->mref_list, true);
 
-	wake_up_interruptible(&output->sender.run_event);
+	wake_up_interruptible(&ch->sender.run_event);
 	MARS_DBG("sender terminated\n");
 	return status;
 }
@@ -589,32 +657,48 @@ static int client_switch(struct client_brick *brick)
 {
 	struct client_output *output = brick->outputs[0];
 	int status = 0;
+	int i;
 
 	if (brick->power.button) {
 		if (brick->power.led_on)
 			goto done;
 		mars_power_led_off((void*)brick, false);
-		if (!output->sender.thread) {
+		if (!output->channel[0].sender.thread) {
+			status = _parse_path(output, brick->brick_name);
+			if (unlikely(status < 0))
+				goto done;
+			// the channel layout must not change while running
+			output->nr_channels = brick->nr_channels;
+			if (output->nr_channels < 1)
+				output->nr_channels = 1;
+			if (output->nr_channels > CLIENT_MAX_CHANNELS)
+				output->nr_channels = CLIENT_MAX_CHANNELS;
+			output->stripe_size = brick->stripe_size & PAGE_MASK;
+			if (output->stripe_size < PAGE_SIZE)
+				output->stripe_size = PAGE_SIZE;
 			brick->connection_state = 1;
-			output->sender.thread = brick_thread_create(sender_thread, output, "mars_sender%d", thread_count++);
-			if (unlikely(!output->sender.thread)) {
-				MARS_ERR("cannot start sender thread\n");
+		}
+		for (i = 0; i < output->nr_channels; i++) {
+			struct client_channel *ch = &output->channel[i];
+			if (ch->sender.thread)
+				continue;
+			ch->sender.thread = brick_thread_create(sender_thread, ch, "mars_sender%d", thread_count++);
+			if (unlikely(!ch->sender.thread)) {
+				MARS_ERR("cannot start sender thread %d\n", i);
 				status = -ENOENT;
 				goto done;
 			}
 		}
-		if (output->sender.thread) {
-			mars_power_led_on((void*)brick, true);
-		}
+		mars_power_led_on((void*)brick, true);
 	} else {
 		if (brick->power.led_off)
 			goto done;
 		mars_power_led_on((void*)brick, false);
-		_kill_thread(&output->sender, "sender");
-		brick->connection_state = 0;
-		if (!output->sender.thread) {
-			mars_power_led_off((void*)brick, !output->sender.thread);
+		for (i = 0; i < CLIENT_MAX_CHANNELS; i++) {
+			_kill_thread(&output->channel[i].sender, "sender");
 		}
+		brick->connection_state = 0;
+		mars_power_led_off((void*)brick, true);
 	}
 done:
 	return status;
@@ -627,21 +711,64 @@ static
 char *client_statistics(struct client_brick *brick, int verbose)
 {
 	struct client_output *output = brick->outputs[0];
+	int send_calls = 0;
+	int send_mrefs = 0;
+	int recv_calls = 0;
+	int recv_mrefs = 0;
+	struct mars_compress_stat cs = {};
+	struct mars_compress_stat ds = {};
+	int i;
 	char *res = brick_string_alloc(1024);
         if (!res)
                 return NULL;
 
+	for (i = 0; i < output->nr_channels; i++) {
+		struct mars_socket *sock = &output->channel[i].socket;
+		send_calls += sock->s_send_calls;
+		send_mrefs += sock->s_send_mrefs;
+		recv_calls += sock->s_recv_calls;
+		recv_mrefs += sock->s_recv_mrefs;
+		cs.cs_raw += sock->s_compress_stat.cs_raw;
+		cs.cs_packed += sock->s_compress_stat.cs_packed;
+		cs.cs_ns += sock->s_compress_stat.cs_ns;
+		ds.cs_raw += sock->s_decompress_stat.cs_raw;
+		ds.cs_packed += sock->s_decompress_stat.cs_packed;
+		ds.cs_ns += sock->s_decompress_stat.cs_ns;
+	}
+
 	snprintf(res, 1024,
 		 "#%d socket "
+		 "channels = %d "
+		 "stripe_size = %d "
 		 "max_flying = %d "
 		 "io_timeout = %d | "
 		 "timeout_count = %d "
-		 "fly_count = %d\n",
-		 output->socket.s_debug_nr,
+		 "fly_count = %d | "
+		 "send_calls = %d "
+		 "send_mrefs = %d "
+		 "recv_calls = %d "
+		 "recv_mrefs = %d | "
+		 "compress = %d "
+		 "compress_percent = %d "
+		 "compress_us_per_mb = %d "
+		 "decompress_percent = %d "
+		 "decompress_us_per_mb = %d\n",
+		 output->channel[0].socket.s_debug_nr,
+		 output->nr_channels,
+		 output->stripe_size,
 		 brick->max_flying,
 		 brick->io_timeout,
 		 atomic_read(&output->timeout_count),
-		 atomic_read(&output->fly_count));
+		 atomic_read(&output->fly_count),
+		 send_calls,
+		 send_mrefs,
+		 recv_calls,
+		 recv_mrefs,
+		 output->channel[0].socket.s_compress,
+		 mars_compress_percent(&cs),
+		 mars_compress_us_per_mb(&cs),
+		 mars_compress_percent(&ds),
+		 mars_compress_us_per_mb(&ds));
 	
         return res;
 }
@@ -677,6 +804,8 @@ MARS_MAKE_STATICS(client);
 
 static int client_brick_construct(struct client_brick *brick)
 {
+	brick->nr_channels = 1;
+	brick->stripe_size = PAGE_SIZE;
 	return 0;
 }
 
@@ -694,11 +823,18 @@ static int client_output_construct(struct client_output *output)
 		INIT_LIST_HEAD(&output->hash_table[i]);
 	}
 	spin_lock_init(&output->lock);
-	INIT_LIST_HEAD(&output->mref_list);
-	INIT_LIST_HEAD(&output->wait_list);
-	init_waitqueue_head(&output->event);
-	init_waitqueue_head(&output->sender.run_event);
-	init_waitqueue_head(&output->receiver.run_event);
+	for (i = 0; i < CLIENT_MAX_CHANNELS; i++) {
+		struct client_channel *ch = &output->channel[i];
+		ch->output = output;
+		ch->ch_nr = i;
+		INIT_LIST_HEAD(&ch->mref_list);
+		INIT_LIST_HEAD(&ch->wait_list);
+		init_waitqueue_head(&ch->event);
+		init_waitqueue_head(&ch->sender.run_event);
+		init_waitqueue_head(&ch->receiver.run_event);
+	}
+	output->nr_channels = 1;
+	output->stripe_size = PAGE_SIZE;
 	init_waitqueue_head(&output->info_event);
 	return 0;
 }
@@ -8,6 +8,10 @@
 extern struct mars_limiter client_limiter;
 extern int global_net_io_timeout;
 extern int mars_client_abort;
+extern int mars_client_channels;
+extern int mars_client_stripe_kb;
+
+#define CLIENT_MAX_CHANNELS 8
 
 struct client_mref_aspect {
 	GENERIC_ASPECT(mref);
@@ -24,6 +28,9 @@ struct client_brick {
 	// tunables
 	int max_flying; // limit on parallelism
 	int io_timeout;    // > 0: report IO errors after timeout (in seconds)
+	int nr_channels;   // number of parallel connections
+	int stripe_size;   // positions are distributed over the channels
+	int compress_mode; // requested payload compression, see MARS_COMPRESS_*
 	bool limit_mode;
 	// readonly from outside
 	int connection_state; // 0 = switched off, 1 = not connected, 2 = connected
@@ -39,21 +46,33 @@ struct client_threadinfo {
 	int restart_count;
 };
 
+/* Each channel has its own TCP connection.
+ * All requests for the same stripe are always sent over the same
+ * channel, thus the ordering per position is retained.
+ */
+struct client_channel {
+	struct client_output *output;
+	struct list_head mref_list;
+	struct list_head wait_list;
+	wait_queue_head_t event;
+	int ch_nr;
+	int recv_error;
+	struct mars_socket socket;
+	struct client_threadinfo sender;
+	struct client_threadinfo receiver;
+};
+
 struct client_output {
 	MARS_OUTPUT(client);
 	atomic_t fly_count;
 	atomic_t timeout_count;
 	spinlock_t lock;
-	struct list_head mref_list;
-	struct list_head wait_list;
-	wait_queue_head_t event;
 	int  last_id;
-	int recv_error;
-	struct mars_socket socket;
+	int nr_channels;
+	int stripe_size;
 	char *host;
 	char *path;
-	struct client_threadinfo sender;
-	struct client_threadinfo receiver;
+	struct client_channel channel[CLIENT_MAX_CHANNELS];
 	struct mars_info info;
 	wait_queue_head_t info_event;
 	bool get_info;
@@ -44,9 +44,18 @@ EXPORT_SYMBOL_GPL(mars_copy_write_prio);
 int mars_copy_read_max_fly = 0;
 EXPORT_SYMBOL_GPL(mars_copy_read_max_fly);
 
+int mars_copy_verify_digest = MARS_DIGEST_CRC32C;
+EXPORT_SYMBOL_GPL(mars_copy_verify_digest);
+
 int mars_copy_write_max_fly = 0;
 EXPORT_SYMBOL_GPL(mars_copy_write_max_fly);
 
+int mars_copy_tree_depth = 2;
+EXPORT_SYMBOL_GPL(mars_copy_tree_depth);
+
+int mars_copy_tree_leaf_kb = 256;
+EXPORT_SYMBOL_GPL(mars_copy_tree_leaf_kb);
+
 #define is_read_limited(brick)						\
 	(mars_copy_read_max_fly > 0 && atomic_read(&(brick)->copy_read_flight) >= mars_copy_read_max_fly)
 
@@ -55,6 +64,15 @@ EXPORT_SYMBOL_GPL(mars_copy_write_max_fly);
 
 ///////////////////////// own helper functions ////////////////////////
 
+/* The digest requested from both sides.
+ * Once the peer has answered with another one, follow it.
+ */
+static inline
+int _copy_digest(struct copy_brick *brick)
+{
+	return brick->peer_digest >= 0 ? brick->peer_digest : brick->verify_digest;
+}
+
 /* TODO:
  * The clash logic is untested / alpha stage (Feb. 2011).
  *
@@ -278,6 +296,7 @@ int _make_mref(struct copy_brick *brick, int index, int queue, void *data, loff_
 	mref->ref_data = data;
 	mref->ref_pos = pos;
 	mref->ref_cs_mode = cs_mode;
+	mref->ref_cs_algo = _copy_digest(brick);
 	offset = GET_OFFSET(pos);
 	len = COPY_CHUNK - offset;
 	if (pos + len > end_pos) {
@@ -324,6 +343,36 @@ done:
 	return status;
 }
 
+/* Compare the checksums of a remote (mref0) and a local (mref1) read.
+ * The peer may have answered with a different algorithm (e.g. an
+ * older server only knows MD5), then the local data is rehashed.
+ * Further requests to both sides then use the algorithm of the peer,
+ * such that checksum-only reads (without local data to rehash)
+ * can match as well.
+ */
+static
+bool _checksum_equal(struct copy_brick *brick, struct mref_object *mref0, struct mref_object *mref1)
+{
+	static unsigned char null[sizeof(mref0->ref_checksum)];
+	int algo = _copy_digest(brick);
+
+	if (unlikely(mref0->ref_cs_algo != algo) &&
+	    mref0->ref_cs_algo >= 0 && mref0->ref_cs_algo < MARS_DIGEST_MAX) {
+		MARS_INF("peer answers with %s instead of %s digests, following it\n",
+			 mars_digest_name[mref0->ref_cs_algo],
+			 algo >= 0 && algo < MARS_DIGEST_MAX ? mars_digest_name[algo] : "unknown");
+		brick->peer_digest = mref0->ref_cs_algo;
+	}
+	if (mref0->ref_cs_algo != mref1->ref_cs_algo && mref1->ref_data) {
+		mref1->ref_cs_algo = mref0->ref_cs_algo;
+		mref_checksum(mref1);
+		brick->verify_rehash_count++;
+	}
+	return mref0->ref_cs_algo == mref1->ref_cs_algo &&
+		!memcmp(mref0->ref_checksum, mref1->ref_checksum, sizeof(mref0->ref_checksum)) &&
+		memcmp(mref0->ref_checksum, null, sizeof(mref0->ref_checksum)) != 0;
+}
+
 static
 void _update_percent(struct copy_brick *brick)
 {
@@ -338,6 +387,278 @@ void _update_percent(struct copy_brick *brick)
 }
 
 
+/* Hierarchical delta sync.
+ *
+ * Before the finite automaton below copies anything, the range at
+ * copy_last is compared by digests of both sides, starting with the
+ * largest aligned range allowed by tree_depth. Equal ranges are
+ * skipped as a whole. Differing ranges are remembered in
+ * tree_diff_end[level], and their subranges are compared at the next
+ * lower level. Only differing leaves are handed over to the automaton.
+ *
+ * No digests are stored anywhere, so both sides still have to read
+ * all the data, but only the digests are transferred, and the number
+ * of requests is much lower than with chunk-wise verify.
+ */
+static
+void copy_tree_endio(struct generic_callback *cb)
+{
+	struct copy_mref_aspect *mref_a;
+	struct mref_object *mref;
+	struct copy_brick *brick;
+	struct copy_tree_probe *probe;
+	int queue;
+
+	LAST_CALLBACK(cb);
+	mref_a = cb->cb_private;
+	CHECK_PTR(mref_a, err);
+	mref = mref_a->object;
+	CHECK_PTR(mref, err);
+	brick = mref_a->brick;
+	CHECK_PTR(brick, err);
+	probe = mref_a->probe;
+	CHECK_PTR(probe, err);
+
+	queue = mref_a->queue;
+	probe->active[queue] = false;
+	if (unlikely(cb->cb_error < 0)) {
+		probe->error = cb->cb_error;
+		__clear_mref(brick, mref, queue);
+	} else {
+		probe->table[queue] = mref;
+	}
+
+	atomic_dec(&brick->copy_read_flight);
+	brick->trigger = true;
+	wake_up_interruptible(&brick->event);
+	return;
+
+err:
+	MARS_FAT("cannot handle callback\n");
+}
+
+static
+int _make_probe(struct copy_brick *brick, struct copy_tree_probe *probe, int queue, loff_t pos, int len)
+{
+	struct mref_object *mref;
+	struct copy_mref_aspect *mref_a;
+	struct copy_input *input;
+	int status = -ENOMEM;
+
+	mref = copy_alloc_mref(brick);
+	if (unlikely(!mref))
+		goto done;
+
+	mref_a = copy_mref_get_aspect(brick, mref);
+	if (unlikely(!mref_a)) {
+		MARS_FAT("cannot get own apsect\n");
+		goto done;
+	}
+
+	mref_a->brick = brick;
+	mref_a->probe = probe;
+	mref_a->queue = queue;
+	mref->ref_may_write = READ;
+	mref->ref_rw = READ;
+	mref->ref_data = NULL;
+	mref->ref_pos = pos;
+	mref->ref_len = len;
+	mref->ref_cs_mode = 2;
+	mref->ref_cs_algo = _copy_digest(brick);
+	mref->ref_prio = mars_copy_read_prio;
+	if (mref->ref_prio < MARS_PRIO_HIGH || mref->ref_prio > MARS_PRIO_LOW)
+		mref->ref_prio = brick->io_prio;
+
+	SETUP_CALLBACK(mref, copy_tree_endio, mref_a);
+
+	input = queue ? brick->inputs[INPUT_B_COPY] : brick->inputs[INPUT_A_COPY];
+	status = GENERIC_INPUT_CALL(input, mref_get, mref);
+	if (unlikely(status < 0)) {
+		MARS_ERR("status = %d\n", status);
+		mars_free_mref(mref);
+		goto done;
+	}
+
+	probe->active[queue] = true;
+	atomic_inc(&brick->copy_read_flight);
+
+	GENERIC_INPUT_CALL(input, mref_io, mref);
+
+done:
+	return status;
+}
+
+static
+void _clear_probes(struct copy_brick *brick)
+{
+	int i;
+
+	for (i = 0; i < COPY_TREE_SLOTS; i++) {
+		struct copy_tree_probe *probe = &brick->tree_probe[i];
+		int queue;
+
+		for (queue = 0; queue < 2; queue++) {
+			if (unlikely(probe->active[queue])) {
+				MARS_ERR("clearing active probe %d queue = %d\n", i, queue);
+				probe->active[queue] = false;
+			}
+			if (probe->table[queue]) {
+				__clear_mref(brick, probe->table[queue], queue);
+				probe->table[queue] = NULL;
+			}
+		}
+		probe->error = 0;
+	}
+	brick->tree_probe_nr = 0;
+}
+
+static
+void _clear_tree(struct copy_brick *brick)
+{
+	_clear_probes(brick);
+	memset(brick->tree_diff_end, 0, sizeof(brick->tree_diff_end));
+}
+
+static inline
+loff_t _tree_size(struct copy_brick *brick, int level)
+{
+	return (loff_t)brick->tree_leaf_size << (level * COPY_TREE_FANOUT_SHIFT);
+}
+
+static
+int _tree_depth(struct copy_brick *brick)
+{
+	int depth = brick->tree_depth;
+
+	if (depth > COPY_TREE_MAX_DEPTH)
+		depth = COPY_TREE_MAX_DEPTH;
+	while (depth > 0 && _tree_size(brick, depth) > COPY_TREE_MAX_RANGE)
+		depth--;
+	return depth;
+}
+
+/* Evaluate a finished probe.
+ * Returns 1 when the range is equal, 0 when it differs,
+ * and -EAGAIN when IO is still in flight.
+ */
+static
+int _eval_probe(struct copy_brick *brick)
+{
+	loff_t pos = brick->tree_probe_pos;
+	bool equal = true;
+	int i;
+
+	for (i = 0; i < brick->tree_probe_nr; i++) {
+		struct copy_tree_probe *probe = &brick->tree_probe[i];
+		if (probe->active[0] || probe->active[1])
+			return -EAGAIN;
+	}
+
+	for (i = 0; i < brick->tree_probe_nr && equal; i++) {
+		struct copy_tree_probe *probe = &brick->tree_probe[i];
+		struct mref_object *mref0 = probe->table[0];
+		struct mref_object *mref1 = probe->table[1];
+		int len = brick->tree_probe_pos + brick->tree_probe_len - pos;
+
+		if (len > COPY_TREE_PIECE)
+			len = COPY_TREE_PIECE;
+		pos += len;
+
+		equal = probe->error >= 0 &&
+			mref0 && mref1 &&
+			mref0->ref_len == len &&
+			mref1->ref_len == len &&
+			_checksum_equal(brick, mref0, mref1);
+	}
+
+	_clear_probes(brick);
+	return equal;
+}
+
+/* Drive the tree descent.
+ * *limit is set to the position up to which the finite automaton
+ * may work.
+ */
+static
+int _run_tree(struct copy_brick *brick, loff_t *limit)
+{
+	loff_t pos = brick->copy_last;
+	int depth = _tree_depth(brick);
+	int progress = 0;
+	int level;
+	int len;
+	int i;
+
+	*limit = brick->copy_end;
+	if (!brick->tree_depth || brick->tree_leaf_size < PAGE_SIZE || brick->append_mode > 0)
+		return 0;
+
+	if (brick->tree_probe_nr > 0) {
+		int status = _eval_probe(brick);
+
+		if (status == -EAGAIN) {
+			*limit = pos;
+			return 0;
+		}
+		progress++;
+		if (status > 0) {
+			brick->tree_skipped += brick->tree_probe_len;
+			brick->tree_probe_equal_count++;
+			brick->copy_last += brick->tree_probe_len;
+			get_lamport(&brick->copy_last_stamp);
+			_update_percent(brick);
+			pos = brick->copy_last;
+		} else {
+			brick->tree_diff_end[brick->tree_probe_level] = brick->tree_probe_pos + brick->tree_probe_len;
+		}
+	}
+
+	// inside a differing leaf => let the automaton work
+	if (pos < brick->tree_diff_end[0]) {
+		*limit = brick->tree_diff_end[0];
+		return progress;
+	}
+	*limit = pos;
+	if (pos >= brick->copy_end || brick->is_aborting || is_read_limited(brick))
+		return progress;
+
+	// never probe a range again which is already known to differ
+	for (level = 1; level <= depth; level++) {
+		if (pos < brick->tree_diff_end[level])
+			break;
+	}
+	// use the largest aligned range
+	while (--level > 0) {
+		if (!(pos % _tree_size(brick, level)))
+			break;
+	}
+	len = _tree_size(brick, level) - pos % _tree_size(brick, level);
+	if (len > brick->copy_end - pos)
+		len = brick->copy_end - pos;
+
+	brick->tree_probe_pos = pos;
+	brick->tree_probe_len = len;
+	brick->tree_probe_level = level;
+	brick->tree_probe_count++;
+
+	for (i = 0; len > 0 && i < COPY_TREE_SLOTS; i++) {
+		int this_len = len > COPY_TREE_PIECE ? COPY_TREE_PIECE : len;
+		int queue;
+
+		brick->tree_probe_nr = i + 1;
+		for (queue = 0; queue < 2; queue++) {
+			int status = _make_probe(brick, &brick->tree_probe[i], queue, pos, this_len);
+			if (unlikely(status < 0)) {
+				brick->tree_probe[i].error = status;
+				break;
+			}
+		}
+		pos += this_len;
+		len -= this_len;
+	}
+	return progress + 1;
+}
+
 /* The heart of this brick.
  * State transition function of the finite automaton.
  * In case no progress is possible (e.g. preconditions not
@@ -458,10 +779,7 @@ restart:
 			if (len != mref1->ref_len) {
 				ok = false;
 			} else if (mref0->ref_cs_mode) {
-				static unsigned char null[sizeof(mref0->ref_checksum)];
-				ok = !memcmp(mref0->ref_checksum, mref1->ref_checksum, sizeof(mref0->ref_checksum));
-				if (ok)
-					ok = memcmp(mref0->ref_checksum, null, sizeof(mref0->ref_checksum)) != 0;
+				ok = _checksum_equal(brick, mref0, mref1);
 			} else if (!mref0->ref_data || !mref1->ref_data) {
 				ok = false;
 			} else {
@@ -611,6 +929,7 @@ int _run_copy(struct copy_brick *brick)
 {
 	int max;
 	loff_t pos;
+	loff_t end;
 	loff_t limit = -1;
 	short prev;
 	int progress;
@@ -627,16 +946,18 @@ int _run_copy(struct copy_brick *brick)
 		}
 		_clear_all_mref(brick);
 		_clear_state_table(brick);
+		_clear_tree(brick);
 	}
 
+	progress = _run_tree(brick, &end);
+
 	/* Do at most max iterations in the below loop
 	 */
 	max = NR_COPY_REQUESTS - atomic_read(&brick->io_flight) * 2;
 	MARS_IO("max = %d\n", max);
 
 	prev = -1;
-	progress = 0;
-	for (pos = brick->copy_last; pos < brick->copy_end || brick->append_mode > 1; pos = ((pos / COPY_CHUNK) + 1) * COPY_CHUNK) {
+	for (pos = brick->copy_last; pos < end || brick->append_mode > 1; pos = ((pos / COPY_CHUNK) + 1) * COPY_CHUNK) {
 		int index = GET_INDEX(pos);
 		struct copy_state *st = &GET_STATE(brick, index);
 		if (max-- <= 0) {
@@ -707,6 +1028,10 @@ static int _copy_thread(void *data)
 	brick->copy_error_count = 0;
 	brick->verify_ok_count = 0;
 	brick->verify_error_count = 0;
+	brick->tree_skipped = 0;
+	brick->tree_probe_count = 0;
+	brick->tree_probe_equal_count = 0;
+	_clear_tree(brick);
 	mars_power_led_on((void*)brick, true);
 	brick->trigger = true;
 
@@ -738,6 +1063,7 @@ static int _copy_thread(void *data)
 		 brick->copy_end);
 
 	_clear_all_mref(brick);
+	_clear_probes(brick);
 	mars_power_led_off((void*)brick, true);
 	MARS_DBG("--------------- copy_thread done.\n");
 	return 0;
@@ -840,6 +1166,13 @@ char *copy_statistics(struct copy_brick *brick, int verbose)
 		 "copy_error_count = %d "
 		 "verify_ok_count = %d "
 		 "verify_error_count = %d "
+		 "verify_digest = %s "
+		 "verify_rehash_count = %d "
+		 "tree_depth = %d "
+		 "tree_leaf_size = %d "
+		 "tree_probes = %d "
+		 "tree_equal = %d "
+		 "tree_skipped = %lld "
 		 "low_dirty = %d "
 		 "is_aborting = %d "
 		 "clash = %lu | "
@@ -854,6 +1187,13 @@ char *copy_statistics(struct copy_brick *brick, int verbose)
 		 brick->copy_error_count,
 		 brick->verify_ok_count,
 		 brick->verify_error_count,
+		 _copy_digest(brick) >= 0 && _copy_digest(brick) < MARS_DIGEST_MAX ? mars_digest_name[_copy_digest(brick)] : "unknown",
+		 brick->verify_rehash_count,
+		 _tree_depth(brick),
+		 brick->tree_leaf_size,
+		 brick->tree_probe_count,
+		 brick->tree_probe_equal_count,
+		 brick->tree_skipped,
 		 brick->low_dirty,
 		 brick->is_aborting,
 		 brick->clash,
@@ -937,6 +1277,7 @@ static int copy_brick_construct(struct copy_brick *brick)
 		memset(sub_table, 0, PAGE_SIZE);
 	}
 
+	brick->peer_digest = -1;
 	init_waitqueue_head(&brick->event);
 	sema_init(&brick->mutex, 1);
 	return 0;
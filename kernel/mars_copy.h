@@ -14,7 +14,21 @@ extern int mars_copy_overlap;
 extern int mars_copy_read_prio;
 extern int mars_copy_write_prio;
 extern int mars_copy_read_max_fly;
+extern int mars_copy_verify_digest;
 extern int mars_copy_write_max_fly;
+extern int mars_copy_tree_depth;
+extern int mars_copy_tree_leaf_kb;
+
+/* Hierarchical delta sync.
+ * Level 0 ranges have tree_leaf_size, each higher level is
+ * COPY_TREE_FANOUT times larger. Ranges are compared by digests,
+ * read in pieces of COPY_TREE_PIECE in parallel.
+ */
+#define COPY_TREE_MAX_DEPTH  8
+#define COPY_TREE_FANOUT_SHIFT 3
+#define COPY_TREE_PIECE      (512 * 1024)
+#define COPY_TREE_SLOTS      32
+#define COPY_TREE_MAX_RANGE  (COPY_TREE_PIECE * COPY_TREE_SLOTS)
 
 enum {
 	COPY_STATE_RESET    = -1,
@@ -39,9 +53,16 @@ struct copy_state {
 	short error;
 };
 
+struct copy_tree_probe {
+	struct mref_object *table[2];
+	bool active[2];
+	int error;
+};
+
 struct copy_mref_aspect {
 	GENERIC_ASPECT(mref);
 	struct copy_brick *brick;
+	struct copy_tree_probe *probe;
 	int queue;
 };
 
@@ -54,10 +75,13 @@ struct copy_brick {
 	int io_prio;
 	int append_mode; // 1 = passively, 2 = actively
 	bool verify_mode; // 0 = copy, 1 = checksum+compare
+	int verify_digest; // MARS_DIGEST_* used by verify_mode
 	bool repair_mode; // whether to repair in case of verify errors
 	bool recheck_mode; // whether to re-check after repairs (costs performance)
 	bool utilize_mode; // utilize already copied data
 	bool abort_mode;  // abort on IO error (default is retry forever)
+	int tree_depth;     // 0 = off, otherwise number of levels above the leaves
+	int tree_leaf_size; // in bytes, multiple of PAGE_SIZE
 	// readonly from outside
 	loff_t copy_last; // current working position
 	struct timespec copy_last_stamp;
@@ -65,9 +89,14 @@ struct copy_brick {
 	int copy_error_count;
 	int verify_ok_count;
 	int verify_error_count;
+	int verify_rehash_count;
+	long long tree_skipped;  // bytes found equal by digests
+	int tree_probe_count;
+	int tree_probe_equal_count;
 	bool low_dirty;
 	bool is_aborting;
 	// internal
+	int peer_digest; // MARS_DIGEST_* answered by the peer, -1 = not yet known
 	bool trigger;
 	unsigned long clash;
 	atomic_t total_clash_count;
@@ -79,6 +108,13 @@ struct copy_brick {
 	struct semaphore mutex;
 	struct task_struct *thread;
 	struct copy_state **st;
+	// hierarchical delta sync
+	struct copy_tree_probe tree_probe[COPY_TREE_SLOTS];
+	loff_t tree_diff_end[COPY_TREE_MAX_DEPTH + 1];
+	loff_t tree_probe_pos;
+	int tree_probe_len;
+	int tree_probe_level;
+	int tree_probe_nr;
 };
 
 struct copy_input {
@@ -10,6 +10,8 @@
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/utsname.h>
+#include <linux/hash.h>
+#include <asm/local.h>
 
 #include "mars.h"
 #include "mars_client.h"
@@ -81,6 +83,7 @@ const struct meta mars_mref_meta[] = {
 	META_INI(ref_may_write,    struct mref_object, FIELD_INT),
 	META_INI(ref_prio,         struct mref_object, FIELD_INT),
 	META_INI(ref_cs_mode,      struct mref_object, FIELD_INT),
+	META_INI(ref_cs_algo,      struct mref_object, FIELD_INT),
 	META_INI(ref_timeout,      struct mref_object, FIELD_INT),
 	META_INI(ref_total_size,   struct mref_object, FIELD_INT),
 	META_INI(ref_checksum,     struct mref_object, FIELD_INT),
@@ -88,6 +91,7 @@ const struct meta mars_mref_meta[] = {
 	META_INI(ref_rw,           struct mref_object, FIELD_INT),
 	META_INI(ref_id,           struct mref_object, FIELD_INT),
 	META_INI(ref_skip_sync,    struct mref_object, FIELD_INT),
+	META_INI(ref_trace_id,     struct mref_object, FIELD_INT),
 	{}
 };
 EXPORT_SYMBOL_GPL(mars_mref_meta);
@@ -105,31 +109,69 @@ EXPORT_SYMBOL_GPL(mars_timespec_meta);
 // crypto stuff
 
 #include <linux/crypto.h>
+#include <linux/crc32c.h>
+
+/* Each CPU has its own transform, so parallel hashing does not
+ * serialize on a single instance. The semaphore is only contended
+ * when a thread has been migrated to another CPU meanwhile.
+ */
+struct mars_digest_ctx {
+	struct crypto_hash *tfm;
+	struct semaphore mutex;
+};
+
+static DEFINE_PER_CPU(struct mars_digest_ctx, mars_digest_ctx);
 
-static struct crypto_hash *mars_tfm = NULL;
-static struct semaphore tfm_sem = __SEMAPHORE_INITIALIZER(tfm_sem, 1);
 int mars_digest_size = 0;
 EXPORT_SYMBOL_GPL(mars_digest_size);
 
-void mars_digest(unsigned char *digest, void *data, int len)
+const char *mars_digest_name[MARS_DIGEST_MAX] = {
+	[MARS_DIGEST_MD5]    = "md5",
+	[MARS_DIGEST_CRC32C] = "crc32c",
+};
+EXPORT_SYMBOL_GPL(mars_digest_name);
+
+static
+void _mars_digest_md5(unsigned char *digest, void *data, int len)
 {
+	struct mars_digest_ctx *ctx = &per_cpu(mars_digest_ctx, raw_smp_processor_id());
 	struct hash_desc desc = {
-		.tfm = mars_tfm,
+		.tfm = ctx->tfm,
 		.flags = 0,
 	};
 	struct scatterlist sg;
 
-	memset(digest, 0, mars_digest_size);
-
-	// TODO: use per-thread instance, omit locking
-	down(&tfm_sem);
+	down(&ctx->mutex);
 
 	crypto_hash_init(&desc);
 	sg_init_table(&sg, 1);
 	sg_set_buf(&sg, data, len);
 	crypto_hash_update(&desc, &sg, sg.length);
 	crypto_hash_final(&desc, digest);
-	up(&tfm_sem);
+	up(&ctx->mutex);
+}
+
+void mars_digest_algo(int algo, unsigned char *digest, void *data, int len)
+{
+	memset(digest, 0, mars_digest_size);
+
+	switch (algo) {
+	case MARS_DIGEST_CRC32C:
+	{
+		u32 crc = crc32c(~0U, data, len);
+		memcpy(digest, &crc, sizeof(crc));
+		break;
+	}
+	case MARS_DIGEST_MD5:
+	default:
+		_mars_digest_md5(digest, data, len);
+	}
+}
+EXPORT_SYMBOL_GPL(mars_digest_algo);
+
+void mars_digest(unsigned char *digest, void *data, int len)
+{
+	mars_digest_algo(MARS_DIGEST_MD5, digest, data, len);
 }
 EXPORT_SYMBOL_GPL(mars_digest);
 
@@ -141,7 +183,13 @@ void mref_checksum(struct mref_object *mref)
 	if (mref->ref_cs_mode <= 0 || !mref->ref_data)
 		return;
 
-	mars_digest(checksum, mref->ref_data, mref->ref_len);
+	/* Unknown algorithms (e.g. requested by a newer peer) are
+	 * answered by MD5. The caller can see this from ref_cs_algo.
+	 */
+	if (unlikely(mref->ref_cs_algo < 0 || mref->ref_cs_algo >= MARS_DIGEST_MAX))
+		mref->ref_cs_algo = MARS_DIGEST_MD5;
+
+	mars_digest_algo(mref->ref_cs_algo, checksum, mref->ref_data, mref->ref_len);
 
 	len = sizeof(mref->ref_checksum);
 	if (len > mars_digest_size)
@@ -197,7 +245,7 @@ void mars_log(const char *fmt, ...)
 }
 EXPORT_SYMBOL_GPL(mars_log);
 
-void mars_trace(struct mref_object *mref, const char *info)
+void _mars_trace_stamp(struct mref_object *mref, const char *info)
 {
 	int index = mref->ref_traces;
 	if (likely(index < MAX_TRACES)) {
@@ -206,7 +254,7 @@ void mars_trace(struct mref_object *mref, const char *info)
 		mref->ref_traces++;
 	}
 }
-EXPORT_SYMBOL_GPL(mars_trace);
+EXPORT_SYMBOL_GPL(_mars_trace_stamp);
 
 void mars_log_trace(struct mref_object *mref)
 {
@@ -249,6 +297,174 @@ EXPORT_SYMBOL_GPL(mars_log_trace);
 
 #endif // MARS_TRACING
 
+/* Sampled tracing into per-CPU rings.
+ * Writers only run on their own CPU, but may be interrupted by other
+ * writers (e.g. from IO completion). Thus slots are reserved by an
+ * atomic increment, and each record is validated by its sequence
+ * number, which is written last.
+ * The single reader may be overtaken by the writers. Overwritten
+ * records are counted in mars_trace_lost.
+ */
+
+int mars_trace_rate = 0;
+EXPORT_SYMBOL_GPL(mars_trace_rate);
+
+int mars_trace_lost = 0;
+EXPORT_SYMBOL_GPL(mars_trace_lost);
+
+struct mars_trace_rec {
+	unsigned long tr_seq; // index + 1 when valid
+	unsigned long long tr_stamp; // ns from cpu_clock()
+	long long tr_id;
+	loff_t tr_pos;
+	int    tr_len;
+	int    tr_rw;
+	char   tr_point[MARS_TRACE_POINT];
+};
+
+struct mars_trace_ring {
+	atomic_long_t tr_head; // next slot to write
+	unsigned long tr_tail; // next slot to read
+	// also updated from interrupt context on the same CPU
+	local_t tr_sample_count;
+	local_t tr_id_count;
+	struct mars_trace_rec tr_recs[MARS_TRACE_RING];
+};
+
+static DEFINE_PER_CPU(struct mars_trace_ring *, mars_trace_ring);
+static DEFINE_MUTEX(trace_read_mutex);
+
+/* Generated ids carry a hash of my_id() in their high bits, such that
+ * they don't collide with the ids received from other hosts.
+ */
+#define MARS_TRACE_HOST_BITS  16
+#define MARS_TRACE_LOCAL_BITS (63 - MARS_TRACE_HOST_BITS)
+
+static long long mars_trace_host_tag = 0;
+
+static
+void _init_trace_host_tag(void)
+{
+	const char *name = my_id();
+	unsigned int hash = 0;
+
+	while (name && *name)
+		hash = hash * 31 + (unsigned char)*name++;
+	mars_trace_host_tag = (long long)hash_32(hash, MARS_TRACE_HOST_BITS) << MARS_TRACE_LOCAL_BITS;
+}
+
+void _mars_trace(struct mref_object *mref, const char *info)
+{
+	struct mars_trace_ring *ring;
+	struct mars_trace_rec *rec;
+	unsigned long index;
+	int rate = ACCESS_ONCE(mars_trace_rate);
+	int cpu;
+
+	if (rate <= 0 || mref->ref_trace_id < 0)
+		return;
+
+	cpu = get_cpu();
+	ring = per_cpu(mars_trace_ring, cpu);
+	if (unlikely(!ring))
+		goto done;
+
+	// first trace point of this mref: decide about sampling
+	if (!mref->ref_trace_id) {
+		if (((unsigned long)local_inc_return(&ring->tr_sample_count) - 1) % rate) {
+			mref->ref_trace_id = -1;
+			goto done;
+		}
+		// unique without any global counter
+		mref->ref_trace_id = (long long)local_inc_return(&ring->tr_id_count) * nr_cpu_ids + cpu;
+		mref->ref_trace_id &= (1LL << MARS_TRACE_LOCAL_BITS) - 1;
+		mref->ref_trace_id |= mars_trace_host_tag;
+	}
+
+	index = atomic_long_inc_return(&ring->tr_head) - 1;
+	rec = &ring->tr_recs[index % MARS_TRACE_RING];
+	rec->tr_seq = 0;
+	smp_wmb();
+	rec->tr_stamp = cpu_clock(cpu);
+	rec->tr_id = mref->ref_trace_id;
+	rec->tr_pos = mref->ref_pos;
+	rec->tr_len = mref->ref_len;
+	rec->tr_rw = mref->ref_rw;
+	strncpy(rec->tr_point, info, MARS_TRACE_POINT - 1);
+	rec->tr_point[MARS_TRACE_POINT - 1] = '\0';
+	smp_wmb();
+	rec->tr_seq = index + 1;
+
+done:
+	put_cpu();
+}
+EXPORT_SYMBOL_GPL(_mars_trace);
+
+/* Drain the rings into buf, one line per record:
+ * cpu stamp_ns id rw pos len point
+ * Returns the number of bytes, 0 when all rings are empty.
+ */
+int mars_trace_read(char *buf, int maxlen)
+{
+	int len = 0;
+	int cpu;
+
+	mutex_lock(&trace_read_mutex);
+	for_each_possible_cpu(cpu) {
+		struct mars_trace_ring *ring = per_cpu(mars_trace_ring, cpu);
+		unsigned long head;
+
+		if (!ring)
+			continue;
+		head = atomic_long_read(&ring->tr_head);
+		if (head - ring->tr_tail > MARS_TRACE_RING) {
+			mars_trace_lost += head - ring->tr_tail - MARS_TRACE_RING;
+			ring->tr_tail = head - MARS_TRACE_RING;
+		}
+		while (ring->tr_tail != head) {
+			struct mars_trace_rec *rec = &ring->tr_recs[ring->tr_tail % MARS_TRACE_RING];
+			struct mars_trace_rec copy;
+			unsigned long seq;
+			char line[128];
+			int this_len;
+
+			seq = ACCESS_ONCE(rec->tr_seq);
+			smp_rmb();
+			memcpy(&copy, rec, sizeof(copy));
+			smp_rmb();
+			if (seq != ring->tr_tail + 1 ||
+			    ACCESS_ONCE(rec->tr_seq) != seq) {
+				// not yet complete: retry next time
+				if (seq <= ring->tr_tail)
+					break;
+				// overwritten meanwhile
+				mars_trace_lost++;
+				ring->tr_tail++;
+				continue;
+			}
+			copy.tr_point[MARS_TRACE_POINT - 1] = '\0';
+			this_len = scnprintf(line, sizeof(line),
+					     "%d %llu %lld %d %lld %d %s\n",
+					     cpu,
+					     copy.tr_stamp,
+					     copy.tr_id,
+					     copy.tr_rw,
+					     copy.tr_pos,
+					     copy.tr_len,
+					     copy.tr_point);
+			if (len + this_len > maxlen)
+				goto done;
+			memcpy(buf + len, line, this_len);
+			len += this_len;
+			ring->tr_tail++;
+		}
+	}
+done:
+	mutex_unlock(&trace_read_mutex);
+	return len;
+}
+EXPORT_SYMBOL_GPL(mars_trace_read);
+
 /////////////////////////////////////////////////////////////////////
 
 // power led handling
@@ -259,7 +475,7 @@ void mars_power_led_on(struct mars_brick *brick, bool val)
 	if (val != oldval) {
 		//MARS_DBG("brick '%s' type '%s' led_on %d -> %d\n", brick->brick_path, brick->type->type_name, oldval, val);
 		set_led_on(&brick->power, val);
-		mars_trigger();
+		mars_trigger_path(brick->brick_path);
 	}
 }
 EXPORT_SYMBOL_GPL(mars_power_led_on);
@@ -270,7 +486,7 @@ void mars_power_led_off(struct mars_brick *brick, bool val)
 	if (val != oldval) {
 		//MARS_DBG("brick '%s' type '%s' led_off %d -> %d\n", brick->brick_path, brick->type->type_name, oldval, val);
 		set_led_off(&brick->power, val);
-		mars_trigger();
+		mars_trigger_path(brick->brick_path);
 	}
 }
 EXPORT_SYMBOL_GPL(mars_power_led_off);
@@ -282,6 +498,8 @@ EXPORT_SYMBOL_GPL(mars_power_led_off);
 
 void (*_mars_trigger)(void) = NULL;
 EXPORT_SYMBOL_GPL(_mars_trigger);
+void (*_mars_trigger_path)(const char *path) = NULL;
+EXPORT_SYMBOL_GPL(_mars_trigger_path);
 
 struct mm_struct *mm_fake = NULL;
 EXPORT_SYMBOL_GPL(mm_fake);
@@ -289,8 +507,37 @@ struct task_struct *mm_fake_task = NULL;
 atomic_t mm_fake_count = ATOMIC_INIT(0);
 EXPORT_SYMBOL_GPL(mm_fake_count);
 
+static
+void _free_digest_ctx(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct mars_digest_ctx *ctx = &per_cpu(mars_digest_ctx, cpu);
+		if (ctx->tfm) {
+			crypto_free_hash(ctx->tfm);
+			ctx->tfm = NULL;
+		}
+	}
+}
+
+static
+void _free_trace_rings(void)
+{
+	int cpu;
+
+	mars_trace_rate = 0;
+	for_each_possible_cpu(cpu) {
+		brick_mem_free(per_cpu(mars_trace_ring, cpu));
+		per_cpu(mars_trace_ring, cpu) = NULL;
+	}
+}
+
 int __init init_mars(void)
 {
+	int status;
+	int cpu;
+
 	MARS_INF("init_mars()\n");
 
 	set_fake();
@@ -311,25 +558,46 @@ int __init init_mars(void)
 	}
 #endif
 
-	mars_tfm = crypto_alloc_hash("md5", 0, CRYPTO_ALG_ASYNC);
-	if (!mars_tfm) {
-		MARS_ERR("cannot alloc crypto hash\n");
-		return -ENOMEM;
-	}
-	if (IS_ERR(mars_tfm)) {
-		MARS_ERR("alloc crypto hash failed, status = %d\n", (int)PTR_ERR(mars_tfm));
-		return PTR_ERR(mars_tfm);
+	_init_trace_host_tag();
+	for_each_possible_cpu(cpu) {
+		// tracing remains off on this CPU when this fails
+		per_cpu(mars_trace_ring, cpu) = brick_zmem_alloc(sizeof(struct mars_trace_ring));
 	}
-#if 0
-	if (crypto_tfm_alg_type(crypto_hash_tfm(mars_tfm)) != CRYPTO_ALG_TYPE_DIGEST) {
-		MARS_ERR("bad crypto hash type\n");
-		return -EINVAL;
+
+	for_each_possible_cpu(cpu) {
+		struct mars_digest_ctx *ctx = &per_cpu(mars_digest_ctx, cpu);
+		struct crypto_hash *tfm;
+
+		sema_init(&ctx->mutex, 1);
+		tfm = crypto_alloc_hash("md5", 0, CRYPTO_ALG_ASYNC);
+		if (!tfm) {
+			MARS_ERR("cannot alloc crypto hash\n");
+			status = -ENOMEM;
+			goto err;
+		}
+		if (IS_ERR(tfm)) {
+			MARS_ERR("alloc crypto hash failed, status = %d\n", (int)PTR_ERR(tfm));
+			status = PTR_ERR(tfm);
+			goto err;
+		}
+		ctx->tfm = tfm;
+		mars_digest_size = crypto_hash_digestsize(tfm);
 	}
-#endif
-	mars_digest_size = crypto_hash_digestsize(mars_tfm);
 	MARS_INF("digest_size = %d\n", mars_digest_size);
 
 	return 0;
+
+err:
+	_free_digest_ctx();
+	_free_trace_rings();
+#ifdef MARS_TRACING
+	if (mars_log_file) {
+		filp_close(mars_log_file, NULL);
+		mars_log_file = NULL;
+	}
+#endif
+	put_fake();
+	return status;
 }
 
 void __exit exit_mars(void)
@@ -338,9 +606,9 @@ void __exit exit_mars(void)
 
 	put_fake();
 
-	if (mars_tfm) {
-		crypto_free_hash(mars_tfm);
-	}
+	_free_trace_rings();
+
+	_free_digest_ctx();
 
 #ifdef MARS_TRACING
 	if (mars_log_file) {
@@ -979,7 +979,7 @@ static int if_release(struct gendisk *gd, fmode_t mode)
 		}
 
 		MARS_DBG("status button=%d led_on=%d led_off=%d\n", brick->power.button, brick->power.led_on, brick->power.led_off);
-		mars_trigger();
+		mars_trigger_path(brick->brick_path);
 	}
 	return 0;
 }
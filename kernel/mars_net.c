@@ -16,10 +16,11 @@
 #include <linux/string.h>
 #include <linux/moduleparam.h>
 
+#include <linux/lz4.h>
+
 #include "mars.h"
 #include "mars_net.h"
 
-#undef USE_SENDPAGE // FIXME: does not work, leads to data corruption (probably due to races with asynchrous sending)
 #define USE_BUFFERING
 
 /* Low-level network traffic
@@ -161,6 +162,8 @@ int mars_create_socket(struct mars_socket *msock, struct sockaddr_storage *addr,
 		goto final;
 	}
 	atomic_set(&msock->s_count, 1);
+	INIT_LIST_HEAD(&msock->s_pin_list);
+	spin_lock_init(&msock->s_pin_lock);
 
 	status = sock_create_kern(AF_INET, SOCK_STREAM, IPPROTO_TCP, &msock->s_socket);
 	if (unlikely(status < 0 || !msock->s_socket)) {
@@ -232,6 +235,8 @@ int mars_accept_socket(struct mars_socket *new_msock, struct mars_socket *old_ms
 		memset(new_msock, 0, sizeof(struct mars_socket));
 		new_msock->s_socket = new_socket;
 		atomic_set(&new_msock->s_count, 1);
+		INIT_LIST_HEAD(&new_msock->s_pin_list);
+		spin_lock_init(&new_msock->s_pin_lock);
 		new_msock->s_alive = true;
 		new_msock->s_debug_nr = ++current_debug_nr;
 		MARS_DBG("#%d successfully accepted socket #%d\n", old_msock->s_debug_nr, new_msock->s_debug_nr);
@@ -262,6 +267,8 @@ bool mars_get_socket(struct mars_socket *msock)
 }
 EXPORT_SYMBOL_GPL(mars_get_socket);
 
+static void _mars_reap_pins(struct mars_socket *msock, bool force);
+
 void mars_put_socket(struct mars_socket *msock)
 {
 	MARS_LOW("#%d put socket %p s_count=%d\n", msock->s_debug_nr, msock->s_socket, atomic_read(&msock->s_count));
@@ -269,9 +276,26 @@ void mars_put_socket(struct mars_socket *msock)
 		MARS_ERR("#%d bad nesting on msock = %p sock = %p\n", msock->s_debug_nr, msock, msock->s_socket);
 	} else if (atomic_dec_and_test(&msock->s_count)) {
 		struct socket *sock = msock->s_socket;
+		struct sock *sk = NULL;
 		int i;
 
 		MARS_DBG("#%d closing socket %p\n", msock->s_debug_nr, sock);
+		/* tcp_close() would still transmit the queued data after
+		 * sock_release(), but the owners of pinned data may re-use
+		 * it as soon as we are gone. Thus abort the connection
+		 * (RST), and keep the pins until the stack has freed all
+		 * skbs referencing them.
+		 */
+		_mars_reap_pins(msock, false);
+		if (sock && sock->sk && !list_empty(&msock->s_pin_list)) {
+			struct linger linger = {
+				.l_onoff = 1,
+				.l_linger = 0,
+			};
+			_setsockopt(sock, SOL_SOCKET, SO_LINGER, linger);
+			sk = sock->sk;
+			sock_hold(sk);
+		}
 		if (likely(sock && cmpxchg(&msock->s_alive, true, false))) {
 			kernel_sock_shutdown(sock, SHUT_WR);
 		}
@@ -279,6 +303,19 @@ void mars_put_socket(struct mars_socket *msock)
 			MARS_DBG("#%d releasing socket %p\n", msock->s_debug_nr, sock);
 			sock_release(sock);
 		}
+		if (sk) {
+			unsigned long timeout = jiffies + default_tcp_params.tcp_timeout * HZ;
+
+			while (sk_wmem_alloc_get(sk) > 0) {
+				if (unlikely(time_is_before_jiffies(timeout))) {
+					MARS_WRN("#%d pinned data still queued after abort\n", msock->s_debug_nr);
+					break;
+				}
+				brick_msleep(10);
+			}
+			sock_put(sk);
+		}
+		_mars_reap_pins(msock, true);
 		for (i = 0; i < MAX_DESC_CACHE; i++) {
 			if (msock->s_desc_send[i])
 				brick_block_free(msock->s_desc_send[i], PAGE_SIZE);
@@ -286,7 +323,11 @@ void mars_put_socket(struct mars_socket *msock)
 				brick_block_free(msock->s_desc_recv[i], PAGE_SIZE);
 		}
 		brick_block_free(msock->s_buffer, PAGE_SIZE);
+		brick_block_free(msock->s_rbuffer, PAGE_SIZE);
+		brick_block_free(msock->s_compress_work, LZ4_MEM_COMPRESS);
 		memset(msock, 0, sizeof(struct mars_socket));
+		INIT_LIST_HEAD(&msock->s_pin_list);
+		spin_lock_init(&msock->s_pin_lock);
 	}
 }
 EXPORT_SYMBOL_GPL(mars_put_socket);
@@ -325,57 +366,213 @@ done:
 }
 EXPORT_SYMBOL_GPL(mars_socket_is_alive);
 
+/* Zero-copy sending.
+ *
+ * kernel_sendpage() does not copy the data, the skbs just reference
+ * the pages. Thus the data must not be modified until the TCP stack
+ * is really done with it. This was the reason for the data corruption
+ * of the old USE_SENDPAGE variant: the caller re-used the buffer
+ * as soon as the send call returned.
+ *
+ * Each zero-copy transfer creates a struct mars_pin holding an extra
+ * page reference on each of its pages, and remembers the TCP write
+ * sequence number after the transfer. Once the peer has acknowledged
+ * everything up to this sequence number, the data is never looked
+ * at again and the pin can be released.
+ * Pins are released in FIFO order.
+ *
+ * Callers must not re-use the data buffer as long as mars_pin_busy()
+ * reports it.
+ */
+int mars_net_zerocopy_min = PAGE_SIZE; // 0 = switched off
+EXPORT_SYMBOL_GPL(mars_net_zerocopy_min);
+
+#define MARS_PIN_MAX 256
+
+struct mars_pin {
+	struct list_head pin_head;
+	const void *pin_cookie;
+	u32 pin_seq;
+	int pin_nr;
+	struct page *pin_page[0];
+};
+
 static
-int _mars_send_raw(struct mars_socket *msock, const void *buf, int len)
+void _mars_unpin(struct mars_pin *pin)
+{
+	int i;
+
+	for (i = 0; i < pin->pin_nr; i++)
+		put_page(pin->pin_page[i]);
+	brick_mem_free(pin);
+}
+
+static
+struct mars_pin *_mars_pin(const void *buf, int len)
+{
+	struct mars_pin *pin;
+	int nr;
+
+	if (mars_net_zerocopy_min <= 0 || len < mars_net_zerocopy_min)
+		return NULL;
+	// only whole pages can be exclusively owned by the buffer
+	if (((unsigned long)buf) & (PAGE_SIZE - 1))
+		return NULL;
+	nr = (len + PAGE_SIZE - 1) / PAGE_SIZE;
+	if (nr > MARS_PIN_MAX)
+		return NULL;
+
+	pin = brick_mem_alloc(sizeof(struct mars_pin) + nr * sizeof(struct page*));
+	if (unlikely(!pin))
+		return NULL;
+	INIT_LIST_HEAD(&pin->pin_head);
+	pin->pin_cookie = NULL;
+	pin->pin_seq = 0;
+	pin->pin_nr = 0;
+
+	while (pin->pin_nr < nr) {
+		int offset = 0;
+		int this_len = PAGE_SIZE;
+		struct page *page;
+
+		page = brick_iomap((void*)buf + pin->pin_nr * PAGE_SIZE, &offset, &this_len);
+		// sendpage() needs refcounted pages
+		if (unlikely(!page || PageSlab(page) || page_count(page) <= 0)) {
+			_mars_unpin(pin);
+			return NULL;
+		}
+		get_page(page);
+		pin->pin_page[pin->pin_nr++] = page;
+	}
+	return pin;
+}
+
+static
+void _mars_reap_pins(struct mars_socket *msock, bool force)
+{
+	struct socket *sock = msock->s_socket;
+	LIST_HEAD(tmp_list);
+	unsigned long flags;
+
+	traced_lock(&msock->s_pin_lock, flags);
+	while (!list_empty(&msock->s_pin_list)) {
+		struct mars_pin *pin = container_of(msock->s_pin_list.next, struct mars_pin, pin_head);
+		if (!force &&
+		    (!sock || !sock->sk || before(tcp_sk(sock->sk)->snd_una, pin->pin_seq)))
+			break;
+		list_move_tail(&pin->pin_head, &tmp_list);
+	}
+	traced_unlock(&msock->s_pin_lock, flags);
+
+	while (!list_empty(&tmp_list)) {
+		struct mars_pin *pin = container_of(tmp_list.next, struct mars_pin, pin_head);
+		list_del_init(&pin->pin_head);
+		_mars_unpin(pin);
+	}
+}
+
+/* After a shutdown, the peer will not process the data anymore.
+ */
+bool mars_pin_busy(struct mars_socket *msock, const void *cookie)
+{
+	struct mars_pin *pin;
+	bool res = false;
+	unsigned long flags;
+
+	if (!mars_socket_is_alive(msock))
+		goto done;
+
+	_mars_reap_pins(msock, false);
+
+	traced_lock(&msock->s_pin_lock, flags);
+	list_for_each_entry(pin, &msock->s_pin_list, pin_head) {
+		if (pin->pin_cookie == cookie) {
+			res = true;
+			break;
+		}
+	}
+	traced_unlock(&msock->s_pin_lock, flags);
+
+done:
+	return res;
+}
+EXPORT_SYMBOL_GPL(mars_pin_busy);
+
+void mars_pin_wait(struct mars_socket *msock, const void *cookie)
+{
+	unsigned long timeout = jiffies + default_tcp_params.tcp_timeout * HZ;
+
+	while (mars_pin_busy(msock, cookie)) {
+		if (unlikely(time_is_before_jiffies(timeout))) {
+			MARS_WRN("#%d pinned data not acknowledged\n", msock->s_debug_nr);
+			break;
+		}
+		brick_msleep(10);
+	}
+}
+EXPORT_SYMBOL_GPL(mars_pin_wait);
+
+/* Send a vector of buffers.
+ * Each call to the network stack may consume several vector elements
+ * at once. The vector is modified.
+ * In zero-copy mode, the pages are sent one by one.
+ */
+static
+int _mars_send_raw(struct mars_socket *msock, struct kvec *vec, int nr, int flags, bool zerocopy)
 {
 	int sleeptime = 1000 / HZ;
 	int sent = 0;
+	int len = 0;
 	int status = 0;
+	int i;
+
+	for (i = 0; i < nr; i++)
+		len += vec[i].iov_len;
 
 	msock->s_send_cnt = 0;
 	while (len > 0) {
 		int this_len = len;
 		struct socket *sock = msock->s_socket;
 
+		// skip exhausted elements
+		while (!vec->iov_len) {
+			vec++;
+			nr--;
+		}
+
 		if (unlikely(!sock || !mars_net_is_alive || brick_thread_should_stop())) {
 			MARS_WRN("interrupting, sent = %d\n", sent);
 			status = -EIDRM;
 			break;
 		}
 
-#ifdef USE_SENDPAGE // FIXME: does not work, leads to data corruption (probably due to races with asynchrous sending)
-		{
+		msock->s_send_calls++;
+		if (zerocopy) {
 			int page_offset = 0;
 			struct page *page;
-			int flags = MSG_NOSIGNAL;
-			page = brick_iomap(buf, &page_offset, &this_len);
+			int this_flags = flags | MSG_NOSIGNAL;
+			this_len = vec->iov_len;
+			page = brick_iomap(vec->iov_base, &page_offset, &this_len);
 			if (unlikely(!page)) {
-				MARS_ERR("cannot iomap() kernel address %p\n", buf);
+				MARS_ERR("cannot iomap() kernel address %p\n", vec->iov_base);
 				status = -EINVAL;
 				break;
 			}
 
 			if (this_len < len)
-				flags |= MSG_MORE;
+				this_flags |= MSG_MORE;
 			
-			status = kernel_sendpage(sock, page, page_offset, this_len, flags);
+			status = kernel_sendpage(sock, page, page_offset, this_len, this_flags);
 			if (status > 0 && status != this_len) {
-				MARS_WRN("#%d status = %d this_len = %d\n", msock->s_debug_nr, status, this_len);
+				MARS_IO("#%d status = %d this_len = %d\n", msock->s_debug_nr, status, this_len);
 			}
-		}
-#else // spare code, activate in case of problems with sendpage()
-		{
-			struct kvec iov = {
-				.iov_base = (void*)buf,
-				.iov_len  = this_len,
-			};
+		} else {
 			struct msghdr msg = {
-				.msg_iov = (struct iovec*)&iov,
-				.msg_flags = 0 | MSG_NOSIGNAL,
+				.msg_iov = (struct iovec*)vec,
+				.msg_flags = flags | MSG_NOSIGNAL,
 			};
-			status = kernel_sendmsg(sock, &msg, &iov, 1, this_len);
+			status = kernel_sendmsg(sock, &msg, vec, nr, this_len);
 		}
-#endif
 
 		if (status == -EAGAIN) {
 			if (msock->s_send_abort > 0 && ++msock->s_send_cnt > msock->s_send_abort) {
@@ -409,8 +606,16 @@ int _mars_send_raw(struct mars_socket *msock, const void *buf, int len)
 		}
 
 		len -= status;
-		buf += status;
 		sent += status;
+		// advance the vector
+		for (i = status; i > 0; vec++, nr--) {
+			int this_step = i < vec->iov_len ? i : vec->iov_len;
+			vec->iov_base += this_step;
+			vec->iov_len -= this_step;
+			i -= this_step;
+			if (vec->iov_len)
+				break;
+		}
 		sleeptime = 1000 / HZ;
 	}
 
@@ -420,6 +625,16 @@ int _mars_send_raw(struct mars_socket *msock, const void *buf, int len)
 	return status;
 }
 
+static inline
+int _mars_send_buf(struct mars_socket *msock, const void *buf, int len, int flags, bool zerocopy)
+{
+	struct kvec vec = {
+		.iov_base = (void*)buf,
+		.iov_len  = len,
+	};
+	return _mars_send_raw(msock, &vec, 1, flags, zerocopy);
+}
+
 int mars_send_raw(struct mars_socket *msock, const void *buf, int len, bool cork)
 {
 #ifdef USE_BUFFERING
@@ -453,18 +668,37 @@ restart:
 	}
 
 	if (msock->s_pos > 0) {
-		status = _mars_send_raw(msock, msock->s_buffer, msock->s_pos);
-		MARS_IO("#%d buffer send %d bytes status=%d\n", msock->s_debug_nr, msock->s_pos, status);
+		/* Bulk data directly follows the buffered header
+		 * in the same call.
+		 */
+		struct kvec vec[2] = {
+			{
+				.iov_base = msock->s_buffer,
+				.iov_len  = msock->s_pos,
+			},
+			{
+				.iov_base = (void*)buf,
+				.iov_len  = rest,
+			},
+		};
+		int nr = rest >= PAGE_SIZE ? 2 : 1;
+
+		status = _mars_send_raw(msock, vec, nr, 0, false);
+		MARS_IO("#%d buffer send %d+%d bytes status=%d\n", msock->s_debug_nr, msock->s_pos, nr > 1 ? rest : 0, status);
 		if (status < 0)
 			goto done;
 		
 		brick_block_free(msock->s_buffer, PAGE_SIZE);
 		msock->s_buffer = NULL;
 		msock->s_pos = 0;
+		if (nr > 1) {
+			status = rest;
+			goto done;
+		}
 	}
 
 	if (rest >= PAGE_SIZE) {
-		status = _mars_send_raw(msock, buf, rest);
+		status = _mars_send_buf(msock, buf, rest, 0, false);
 		MARS_IO("#%d bulk send %d bytes status=%d\n", msock->s_debug_nr, rest, status);
 		goto done;
 	} else if (rest > 0) {
@@ -474,7 +708,7 @@ restart:
 
 done:
 #else
-	status = _mars_send_raw(msock, buf, len);
+	status = _mars_send_buf(msock, buf, len, 0, false);
 #endif
 	if (status < 0 && msock->s_shutdown_on_err)
 		mars_shutdown_socket(msock);
@@ -486,6 +720,94 @@ final:
 }
 EXPORT_SYMBOL_GPL(mars_send_raw);
 
+/* Send a data buffer, using zero-copy when possible.
+ * The cookie identifies the pin for mars_pin_busy().
+ */
+static
+int mars_send_data(struct mars_socket *msock, const void *buf, int len, const void *cookie)
+{
+	struct mars_pin *pin;
+	unsigned long flags;
+	int status = -EINVAL;
+
+#ifdef USE_BUFFERING
+	/* A corked header and a single page of payload go out
+	 * together in one vectored call. Copying one page is cheaper
+	 * than a separate stack call for the header.
+	 */
+	if (msock->s_buffer && msock->s_pos > 0 && len <= PAGE_SIZE)
+		return mars_send_raw(msock, buf, len, false);
+#endif
+
+	pin = _mars_pin(buf, len);
+	if (!pin)
+		return mars_send_raw(msock, buf, len, false);
+
+	if (!mars_get_socket(msock)) {
+		_mars_unpin(pin);
+		goto final;
+	}
+
+	MARS_IO("#%d zero-copy sending len=%d bytes\n", msock->s_debug_nr, len);
+
+#ifdef USE_BUFFERING
+	// flush the corked header, but don't push it out
+	if (msock->s_buffer && msock->s_pos > 0) {
+		status = _mars_send_buf(msock, msock->s_buffer, msock->s_pos, MSG_MORE, false);
+		if (unlikely(status < 0)) {
+			_mars_unpin(pin);
+			goto done;
+		}
+		brick_block_free(msock->s_buffer, PAGE_SIZE);
+		msock->s_buffer = NULL;
+		msock->s_pos = 0;
+	}
+#endif
+
+	status = _mars_send_buf(msock, buf, len, 0, true);
+
+	/* Even after errors, some of the pages may be still
+	 * referenced by the stack.
+	 */
+	pin->pin_cookie = cookie;
+	if (likely(msock->s_socket && msock->s_socket->sk))
+		pin->pin_seq = tcp_sk(msock->s_socket->sk)->write_seq;
+	traced_lock(&msock->s_pin_lock, flags);
+	list_add_tail(&pin->pin_head, &msock->s_pin_list);
+	traced_unlock(&msock->s_pin_lock, flags);
+
+#ifdef USE_BUFFERING
+done:
+#endif
+	if (status < 0 && msock->s_shutdown_on_err)
+		mars_shutdown_socket(msock);
+
+	mars_put_socket(msock);
+
+final:
+	return status;
+}
+
+#ifdef USE_BUFFERING
+/* Small pieces like headers and meta data are read ahead into
+ * s_rbuffer, such that a whole struct is usually fetched by a single
+ * kernel_recvmsg().
+ */
+static inline
+int _mars_recv_buffered(struct mars_socket *msock, void *buf, int len)
+{
+	int avail = msock->s_rlen - msock->s_rpos;
+
+	if (avail <= 0)
+		return 0;
+	if (len > avail)
+		len = avail;
+	memcpy(buf, msock->s_rbuffer + msock->s_rpos, len);
+	msock->s_rpos += len;
+	return len;
+}
+#endif
+
 /* Note: buf may be NULL. In this case, the data is simply consumed,
  * like /dev/null
  */
@@ -509,6 +831,10 @@ int mars_recv_raw(struct mars_socket *msock, void *buf, int minlen, int maxlen)
 
 	MARS_IO("#%d receiving len=%d/%d bytes\n", msock->s_debug_nr, minlen, maxlen);
 
+#ifdef USE_BUFFERING
+	done = _mars_recv_buffered(msock, buf, maxlen);
+#endif
+
 	msock->s_recv_cnt = 0;
 	while (done < minlen) {
 		struct kvec iov = {
@@ -521,6 +847,19 @@ int mars_recv_raw(struct mars_socket *msock, void *buf, int minlen, int maxlen)
 			.msg_flags = MSG_NOSIGNAL,
 		};
 		struct socket *sock = msock->s_socket;
+		bool buffered = false;
+
+#ifdef USE_BUFFERING
+		if (iov.iov_len < PAGE_SIZE) {
+			if (!msock->s_rbuffer)
+				msock->s_rbuffer = brick_block_alloc(0, PAGE_SIZE);
+			if (likely(msock->s_rbuffer)) {
+				iov.iov_base = msock->s_rbuffer;
+				iov.iov_len = PAGE_SIZE;
+				buffered = true;
+			}
+		}
+#endif
 
 		if (unlikely(!sock)) {
 			MARS_WRN("#%d socket has disappeared\n", msock->s_debug_nr);
@@ -535,9 +874,10 @@ int mars_recv_raw(struct mars_socket *msock, void *buf, int minlen, int maxlen)
 			goto err;
 		}
 
-		MARS_LOW("#%d done %d, fetching %d bytes\n", msock->s_debug_nr, done, maxlen-done);
+		MARS_LOW("#%d done %d, fetching %d bytes\n", msock->s_debug_nr, done, (int)iov.iov_len);
 
-		status = kernel_recvmsg(sock, &msg, &iov, 1, maxlen-done, msg.msg_flags);
+		msock->s_recv_calls++;
+		status = kernel_recvmsg(sock, &msg, &iov, 1, iov.iov_len, msg.msg_flags);
 
 		MARS_LOW("#%d status = %d\n", msock->s_debug_nr, status);
 
@@ -571,6 +911,13 @@ int mars_recv_raw(struct mars_socket *msock, void *buf, int minlen, int maxlen)
 			MARS_WRN("#%d bad recvmsg, status = %d\n", msock->s_debug_nr, status);
 			goto err;
 		}
+#ifdef USE_BUFFERING
+		if (buffered) {
+			msock->s_rpos = 0;
+			msock->s_rlen = status;
+			status = _mars_recv_buffered(msock, buf + done, maxlen - done);
+		}
+#endif
 		done += status;
 		sleeptime = 1000 / HZ;
 	}
@@ -1005,24 +1352,141 @@ const struct meta mars_cmd_meta[] = {
 	META_INI_SUB(cmd_stamp, struct mars_cmd, mars_timespec_meta),
 	META_INI(cmd_code, struct mars_cmd, FIELD_INT),
 	META_INI(cmd_int1, struct mars_cmd, FIELD_INT),
+	META_INI(cmd_compress, struct mars_cmd, FIELD_INT),
+	META_INI(cmd_generation, struct mars_cmd, FIELD_INT),
 	META_INI(cmd_str1, struct mars_cmd, FIELD_STRING),
 	{}
 };
 EXPORT_SYMBOL_GPL(mars_cmd_meta);
 
 
+/* Payloads are only compressed when the peer has agreed upon it
+ * during CMD_CONNECT. Old peers don't know the cmd_compress field,
+ * thus they will never see CMD_FLAG_COMPRESSED.
+ * Decompression is always possible, it is driven by the flag.
+ * Compressed payloads are preceded by their length.
+ */
+#define MARS_COMPRESS_MIN 512
+
+static
+void *_mars_compress(struct mars_socket *msock, const void *data, int len, int *packed_len)
+{
+	void *packed;
+	size_t dst_len;
+	long long start;
+	int status;
+
+	if (msock->s_compress != MARS_COMPRESS_LZ4 || len < MARS_COMPRESS_MIN)
+		return NULL;
+
+	if (!msock->s_compress_work) {
+		msock->s_compress_work = brick_block_alloc(0, LZ4_MEM_COMPRESS);
+		if (unlikely(!msock->s_compress_work))
+			return NULL;
+	}
+	packed = brick_block_alloc(0, lz4_compressbound(len));
+	if (unlikely(!packed))
+		return NULL;
+
+	dst_len = lz4_compressbound(len);
+	start = cpu_clock(raw_smp_processor_id());
+	status = lz4_compress(data, len, packed, &dst_len, msock->s_compress_work);
+	msock->s_compress_stat.cs_ns += cpu_clock(raw_smp_processor_id()) - start;
+	msock->s_compress_stat.cs_raw += len;
+
+	// incompressible data is sent as-is
+	if (unlikely(status < 0) || dst_len >= (size_t)len) {
+		msock->s_compress_stat.cs_packed += len;
+		brick_block_free(packed, lz4_compressbound(len));
+		return NULL;
+	}
+	msock->s_compress_stat.cs_packed += dst_len;
+	*packed_len = dst_len;
+	return packed;
+}
+
+static
+int _mars_send_payload(struct mars_socket *msock, struct mref_object *mref, void *packed, int packed_len)
+{
+	int status;
+
+	if (!packed)
+		return mars_send_data(msock, mref->ref_data, mref->ref_len, mref);
+
+	status = mars_send_raw(msock, &packed_len, sizeof(packed_len), true);
+	if (likely(status >= 0))
+		status = mars_send_raw(msock, packed, packed_len, false);
+	return status;
+}
+
+static
+int _mars_recv_payload(struct mars_socket *msock, struct mref_object *mref, struct mars_cmd *cmd)
+{
+	void *packed = NULL;
+	int packed_len = 0;
+	size_t dst_len;
+	long long start;
+	int status;
+
+	if (!(cmd->cmd_code & CMD_FLAG_COMPRESSED))
+		return mars_recv_raw(msock, mref->ref_data, mref->ref_len, mref->ref_len);
+
+	status = mars_recv_raw(msock, &packed_len, sizeof(packed_len), sizeof(packed_len));
+	if (unlikely(status < 0))
+		goto done;
+	status = -EBADMSG;
+	if (unlikely(packed_len <= 0 || packed_len > lz4_compressbound(mref->ref_len))) {
+		MARS_WRN("#%d bad compressed length %d for ref_len = %d\n", msock->s_debug_nr, packed_len, mref->ref_len);
+		goto done;
+	}
+	status = -ENOMEM;
+	packed = brick_block_alloc(0, packed_len);
+	if (unlikely(!packed))
+		goto done;
+	status = mars_recv_raw(msock, packed, packed_len, packed_len);
+	if (unlikely(status < 0))
+		goto done;
+
+	dst_len = mref->ref_len;
+	start = cpu_clock(raw_smp_processor_id());
+	status = lz4_decompress_unknownoutputsize(packed, packed_len, mref->ref_data, &dst_len);
+	msock->s_decompress_stat.cs_ns += cpu_clock(raw_smp_processor_id()) - start;
+	msock->s_decompress_stat.cs_raw += mref->ref_len;
+	msock->s_decompress_stat.cs_packed += packed_len;
+	if (unlikely(status < 0 || dst_len != mref->ref_len)) {
+		MARS_WRN("#%d decompression failed, status = %d len = %d ref_len = %d\n", msock->s_debug_nr, status, (int)dst_len, mref->ref_len);
+		status = -EBADMSG;
+		goto done;
+	}
+	status = mref->ref_len;
+
+done:
+	brick_block_free(packed, packed_len);
+	return status;
+}
+
 int mars_send_mref(struct mars_socket *msock, struct mref_object *mref)
 {
 	struct mars_cmd cmd = {
 		.cmd_code = CMD_MREF,
 		.cmd_int1 = mref->ref_id,
 	};
+	void *packed = NULL;
+	int packed_len = 0;
 	int seq = 0;
 	int status;
 
+	mars_trace(mref, "net_send_mref");
+
 	if (mref->ref_rw != 0 && mref->ref_data && mref->ref_cs_mode < 2)
 		cmd.cmd_code |= CMD_FLAG_HAS_DATA;
 
+	if (cmd.cmd_code & CMD_FLAG_HAS_DATA) {
+		packed = _mars_compress(msock, mref->ref_data, mref->ref_len, &packed_len);
+		if (packed)
+			cmd.cmd_code |= CMD_FLAG_COMPRESSED;
+	}
+
 	get_lamport(&cmd.cmd_stamp);
 
 	status = desc_send_struct(msock, &cmd, mars_cmd_meta, true);
@@ -1030,14 +1494,17 @@ int mars_send_mref(struct mars_socket *msock, struct mref_object *mref)
 		goto done;
 
 	seq = 0;
+	msock->s_send_mrefs++;
 	status = desc_send_struct(msock, mref, mars_mref_meta, cmd.cmd_code & CMD_FLAG_HAS_DATA);
 	if (status < 0)
 		goto done;
 
 	if (cmd.cmd_code & CMD_FLAG_HAS_DATA) {
-		status = mars_send_raw(msock, mref->ref_data, mref->ref_len, false);
+		status = _mars_send_payload(msock, mref, packed, packed_len);
 	}
 done:
+	if (packed)
+		brick_block_free(packed, lz4_compressbound(mref->ref_len));
 	return status;
 }
 EXPORT_SYMBOL_GPL(mars_send_mref);
@@ -1046,10 +1513,14 @@ int mars_recv_mref(struct mars_socket *msock, struct mref_object *mref, struct m
 {
 	int status;
 
+	msock->s_recv_mrefs++;
 	status = desc_recv_struct(msock, mref, mars_mref_meta, __LINE__);
 	if (status < 0)
 		goto done;
 
+	// the sampling decision of the sender is transferred via ref_trace_id
+	mars_trace(mref, "net_recv_mref");
+
 	set_lamport(&cmd->cmd_stamp);
 
 	if (cmd->cmd_code & CMD_FLAG_HAS_DATA) {
@@ -1059,7 +1530,7 @@ int mars_recv_mref(struct mars_socket *msock, struct mref_object *mref, struct m
 			status = -ENOMEM;
 			goto done;
 		}
-		status = mars_recv_raw(msock, mref->ref_data, mref->ref_len, mref->ref_len);
+		status = _mars_recv_payload(msock, mref, cmd);
 		if (status < 0)
 			MARS_WRN("#%d mref_len = %d, status = %d\n", msock->s_debug_nr, mref->ref_len, status);
 	}
@@ -1074,12 +1545,22 @@ int mars_send_cb(struct mars_socket *msock, struct mref_object *mref)
 		.cmd_code = CMD_CB,
 		.cmd_int1 = mref->ref_id,
 	};
+	void *packed = NULL;
+	int packed_len = 0;
 	int seq = 0;
 	int status;
 
+	mars_trace(mref, "net_send_cb");
+
 	if (mref->ref_rw == 0 && mref->ref_data && mref->ref_cs_mode < 2)
 		cmd.cmd_code |= CMD_FLAG_HAS_DATA;
 
+	if (cmd.cmd_code & CMD_FLAG_HAS_DATA) {
+		packed = _mars_compress(msock, mref->ref_data, mref->ref_len, &packed_len);
+		if (packed)
+			cmd.cmd_code |= CMD_FLAG_COMPRESSED;
+	}
+
 	get_lamport(&cmd.cmd_stamp);
 
 	status = desc_send_struct(msock, &cmd, mars_cmd_meta, true);
@@ -1087,15 +1568,18 @@ int mars_send_cb(struct mars_socket *msock, struct mref_object *mref)
 		goto done;
 
 	seq = 0;
+	msock->s_send_mrefs++;
 	status = desc_send_struct(msock, mref, mars_mref_meta, cmd.cmd_code & CMD_FLAG_HAS_DATA);
 	if (status < 0)
 		goto done;
 
 	if (cmd.cmd_code & CMD_FLAG_HAS_DATA) {
 		MARS_IO("#%d sending blocklen = %d\n", msock->s_debug_nr, mref->ref_len);
-		status = mars_send_raw(msock, mref->ref_data, mref->ref_len, false);
+		status = _mars_send_payload(msock, mref, packed, packed_len);
 	}
 done:
+	if (packed)
+		brick_block_free(packed, lz4_compressbound(mref->ref_len));
 	return status;
 }
 EXPORT_SYMBOL_GPL(mars_send_cb);
@@ -1104,10 +1588,13 @@ int mars_recv_cb(struct mars_socket *msock, struct mref_object *mref, struct mar
 {
 	int status;
 
+	msock->s_recv_mrefs++;
 	status = desc_recv_struct(msock, mref, mars_mref_meta, __LINE__);
 	if (status < 0)
 		goto done;
 
+	mars_trace(mref, "net_recv_cb");
+
 	set_lamport(&cmd->cmd_stamp);
 
 	if (cmd->cmd_code & CMD_FLAG_HAS_DATA) {
@@ -1117,7 +1604,7 @@ int mars_recv_cb(struct mars_socket *msock, struct mref_object *mref, struct mar
 			goto done;
 		}
 		MARS_IO("#%d receiving blocklen = %d\n", msock->s_debug_nr, mref->ref_len);
-		status = mars_recv_raw(msock, mref->ref_data, mref->ref_len, mref->ref_len);
+		status = _mars_recv_payload(msock, mref, cmd);
 	}
 done:
 	return status;
@@ -9,6 +9,7 @@
 #include "brick.h"
 
 extern int mars_net_default_port;
+extern int mars_net_zerocopy_min;
 extern bool mars_net_is_alive;
 
 #define MAX_FIELD_LEN   32
@@ -20,6 +21,36 @@ struct mars_desc_cache {
 	s32   cache_items;
 };
 
+/* On-the-wire compression of data payloads.
+ */
+#define MARS_COMPRESS_NONE 0
+#define MARS_COMPRESS_LZ4  1
+#define MARS_COMPRESS_MAX  2
+
+struct mars_compress_stat {
+	long long cs_raw;    // uncompressed bytes
+	long long cs_packed; // bytes on the wire
+	long long cs_ns;     // cpu time
+};
+
+static inline
+int mars_compress_percent(struct mars_compress_stat *cs)
+{
+	if (cs->cs_raw <= 0)
+		return 100;
+	return cs->cs_packed * 100 / cs->cs_raw;
+}
+
+static inline
+int mars_compress_us_per_mb(struct mars_compress_stat *cs)
+{
+	long long mb = cs->cs_raw >> 20;
+
+	if (mb <= 0)
+		mb = 1;
+	return cs->cs_ns / 1000 / mb;
+}
+
 struct mars_desc_item {
 	char  field_name[MAX_FIELD_LEN];
 	s32   field_type;
@@ -36,6 +67,9 @@ struct mars_desc_item {
  * Later, some buffering was added in order to take advantage of
  * kernel_sendpage().
  * Caching of meta description has also been added.
+ * Receiving of small pieces is buffered as well.
+ * Zero-copy sending keeps the data pages pinned in s_pin_list
+ * until the peer has acknowledged them.
  */
 struct mars_socket {
 	struct socket *s_socket;
@@ -47,10 +81,24 @@ struct mars_socket {
 	int s_recv_abort;
 	int s_send_cnt;
 	int s_recv_cnt;
+	void *s_rbuffer;
+	int s_rpos;
+	int s_rlen;
+	int s_compress; // negotiated with the peer
+	void *s_compress_work;
+	struct mars_compress_stat s_compress_stat;
+	struct mars_compress_stat s_decompress_stat;
+	// statistics
+	int s_send_calls;
+	int s_recv_calls;
+	int s_send_mrefs;
+	int s_recv_mrefs;
 	bool s_shutdown_on_err;
 	bool s_alive;
 	struct mars_desc_cache *s_desc_send[MAX_DESC_CACHE];
 	struct mars_desc_cache *s_desc_recv[MAX_DESC_CACHE];
+	struct list_head s_pin_list;
+	spinlock_t s_pin_lock;
 };
 
 struct mars_tcp_params {
@@ -77,11 +125,14 @@ enum {
 
 #define CMD_FLAG_MASK     255
 #define CMD_FLAG_HAS_DATA 256
+#define CMD_FLAG_COMPRESSED 512
 
 struct mars_cmd {
 	struct timespec cmd_stamp; // for automatic lamport clock
 	int cmd_code;
 	int cmd_int1;
+	int cmd_compress; // CMD_CONNECT: requested / granted compression
+	long long cmd_generation; // CMD_GETENTS: only dents changed after this generation (0 = all)
 	//int cmd_int2;
 	//int cmd_int3;
 	char *cmd_str1;
@@ -107,6 +158,11 @@ extern bool mars_socket_is_alive(struct mars_socket *msock);
 extern int mars_send_raw(struct mars_socket *msock, const void *buf, int len, bool cork);
 extern int mars_recv_raw(struct mars_socket *msock, void *buf, int minlen, int maxlen);
 
+/* Zero-copy data buffers must not be re-used while they are pinned.
+ */
+extern bool mars_pin_busy(struct mars_socket *msock, const void *cookie);
+extern void mars_pin_wait(struct mars_socket *msock, const void *cookie);
+
 /* Mid-level generic field data exchange
  */
 extern int mars_send_struct(struct mars_socket *msock, const void *data, const struct meta *meta);
@@ -119,6 +175,8 @@ extern int _mars_recv_struct(struct mars_socket *msock, void *data, const struct
 /* High-level transport of mars structures
  */
 extern int mars_send_dent_list(struct mars_socket *msock, struct list_head *anchor);
+extern int mars_send_dent_delta(struct mars_socket *msock, struct list_head *anchor, long long since);
+extern int mars_copy_dent_delta(struct list_head *anchor, long long since, struct list_head *copy);
 extern int mars_recv_dent_list(struct mars_socket *msock, struct list_head *anchor);
 
 extern int mars_send_mref(struct mars_socket *msock, struct mref_object *mref);
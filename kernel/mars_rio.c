@@ -0,0 +1,777 @@
+// (c) 2010 Thomas Schoebel-Theuer / 1&1 Internet AG
+// (c) 2026 Thomas Schoebel-Theuer
+
+//#define BRICK_DEBUGGING
+#define MARS_DEBUGGING
+//#define IO_DEBUGGING
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/string.h>
+#include <linux/list.h>
+#include <linux/types.h>
+#include <linux/blkdev.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/file.h>
+
+#include "mars.h"
+#include "lib_timing.h"
+#include "lib_mapfree.h"
+
+#include "mars_rio.h"
+
+int rio_nr_workers = 4;
+EXPORT_SYMBOL_GPL(rio_nr_workers);
+
+static struct timing_stats timings[3] = {};
+
+///////////////////////// own type definitions ////////////////////////
+
+////////////////// some helpers //////////////////
+
+static inline
+void _sq_enqueue(struct rio_output *output, struct rio_mref_aspect *mref_a, int prio)
+{
+	unsigned long flags;
+
+	prio++;
+	if (unlikely(prio < 0)) {
+		prio = 0;
+	} else if (unlikely(prio >= MARS_PRIO_NR)) {
+		prio = MARS_PRIO_NR - 1;
+	}
+
+	mref_a->enqueue_stamp = cpu_clock(raw_smp_processor_id());
+
+	traced_lock(&output->sq_lock, flags);
+	list_add_tail(&mref_a->io_head, &output->sq_list[prio]);
+	atomic_inc(&output->sq_count);
+	traced_unlock(&output->sq_lock, flags);
+
+	wake_up_interruptible(&output->sq_event);
+}
+
+/* Grab a batch of up to max requests, higher priorities first.
+ */
+static inline
+int _sq_dequeue_batch(struct rio_output *output, struct rio_mref_aspect *batch[], int max)
+{
+	int count = 0;
+	int prio;
+	unsigned long flags;
+
+	traced_lock(&output->sq_lock, flags);
+	for (prio = 0; prio < MARS_PRIO_NR && count < max; prio++) {
+		struct list_head *start = &output->sq_list[prio];
+		while (start->next != start && count < max) {
+			struct list_head *tmp = start->next;
+			list_del_init(tmp);
+			atomic_dec(&output->sq_count);
+			batch[count++] = container_of(tmp, struct rio_mref_aspect, io_head);
+		}
+	}
+	traced_unlock(&output->sq_lock, flags);
+
+	return count;
+}
+
+static inline
+void _cq_add(struct rio_output *output, struct list_head *tmp_list, int count)
+{
+	unsigned long flags;
+
+	traced_lock(&output->cq_lock, flags);
+	list_splice_tail_init(tmp_list, &output->cq_list);
+	atomic_add(count, &output->cq_count);
+	traced_unlock(&output->cq_lock, flags);
+
+	wake_up_interruptible(&output->cq_event);
+}
+
+////////////////// own brick / input / output operations //////////////////
+
+static
+loff_t get_total_size(struct rio_output *output)
+{
+	struct file *file;
+	struct inode *inode;
+	loff_t min;
+
+	file = output->mf->mf_filp;
+	if (unlikely(!file || !file->f_mapping)) {
+		MARS_ERR("file is not open\n");
+		return -EILSEQ;
+	}
+	inode = file->f_mapping->host;
+	if (unlikely(!inode)) {
+		MARS_ERR("file %p has no inode\n", file);
+		return -EILSEQ;
+	}
+
+	min = i_size_read(inode);
+
+	// same workaround for page cache races as in the aio brick
+	if (!output->brick->is_static_device) {
+		loff_t max = 0;
+		mf_get_dirty(output->mf, &min, &max, 0, 99);
+	}
+
+	return min;
+}
+
+static int rio_ref_get(struct rio_output *output, struct mref_object *mref)
+{
+	loff_t total_size;
+
+	if (unlikely(!output->mf)) {
+		MARS_ERR("brick is not switched on\n");
+		return -EILSEQ;
+	}
+
+	if (unlikely(mref->ref_len <= 0)) {
+		MARS_ERR("bad ref_len=%d\n", mref->ref_len);
+		return -EILSEQ;
+	}
+
+	total_size = get_total_size(output);
+	if (unlikely(total_size < 0)) {
+		return total_size;
+	}
+	mref->ref_total_size = total_size;
+
+	if (mref->ref_initialized) {
+		_mref_get(mref);
+		return mref->ref_len;
+	}
+
+	/* Buffered IO.
+	 */
+	if (!mref->ref_data) {
+		struct rio_mref_aspect *mref_a = rio_mref_get_aspect(output->brick, mref);
+		if (unlikely(!mref_a)) {
+			MARS_ERR("bad mref_a\n");
+			return -EILSEQ;
+		}
+		mref->ref_data = brick_block_alloc(mref->ref_pos, (mref_a->alloc_len = mref->ref_len));
+		if (unlikely(!mref->ref_data)) {
+			MARS_ERR("ENOMEM %d bytes\n", mref->ref_len);
+			return -ENOMEM;
+		}
+		mref_a->do_dealloc = true;
+		atomic_inc(&output->total_alloc_count);
+		atomic_inc(&output->alloc_count);
+	}
+
+	_mref_get_first(mref);
+	return mref->ref_len;
+}
+
+static void rio_ref_put(struct rio_output *output, struct mref_object *mref)
+{
+	struct file *file;
+	struct rio_mref_aspect *mref_a;
+
+	if (!_mref_put(mref)) {
+		goto done;
+	}
+
+	if (output->mf && (file = output->mf->mf_filp) && file->f_mapping && file->f_mapping->host) {
+		mref->ref_total_size = get_total_size(output);
+	}
+
+	mref_a = rio_mref_get_aspect(output->brick, mref);
+	if (mref_a && mref_a->do_dealloc) {
+		brick_block_free(mref->ref_data, mref_a->alloc_len);
+		atomic_dec(&output->alloc_count);
+	}
+	rio_free_mref(mref);
+ done:;
+}
+
+static
+void _complete(struct rio_output *output, struct rio_mref_aspect *mref_a, int err)
+{
+	struct mref_object *mref;
+
+	CHECK_PTR(mref_a, fatal);
+	mref = mref_a->object;
+	CHECK_PTR(mref, fatal);
+
+	mars_trace(mref, "rio_endio");
+
+	if (err < 0) {
+		MARS_ERR("IO error %d at pos=%lld len=%d (mref=%p ref_data=%p)\n", err, mref->ref_pos, mref->ref_len, mref, mref->ref_data);
+	} else {
+		mref_checksum(mref);
+		mref->ref_flags |= MREF_UPTODATE;
+	}
+
+	CHECKED_CALLBACK(mref, err, err_found);
+
+done:
+	if (mref->ref_rw) {
+		atomic_dec(&output->write_count);
+	} else {
+		atomic_dec(&output->read_count);
+	}
+
+	mf_remove_dirty(output->mf, &mref_a->di);
+
+	rio_ref_put(output, mref);
+	atomic_dec(&mars_global_io_flying);
+	return;
+
+err_found:
+	MARS_FAT("giving up...\n");
+	goto done;
+
+fatal:
+	MARS_FAT("bad pointer, giving up...\n");
+}
+
+static void rio_ref_io(struct rio_output *output, struct mref_object *mref)
+{
+	struct rio_mref_aspect *mref_a;
+
+	mref_a = rio_mref_get_aspect(output->brick, mref);
+	if (unlikely(!mref_a)) {
+		MARS_FAT("cannot get aspect\n");
+		SIMPLE_CALLBACK(mref, -EINVAL);
+		return;
+	}
+
+	_mref_get(mref);
+	atomic_inc(&mars_global_io_flying);
+
+	// statistics
+	if (mref->ref_rw) {
+		atomic_inc(&output->total_write_count);
+		atomic_inc(&output->write_count);
+	} else {
+		atomic_inc(&output->total_read_count);
+		atomic_inc(&output->read_count);
+	}
+
+	if (unlikely(!output->mf || !output->mf->mf_filp)) {
+		_complete(output, mref_a, -EINVAL);
+		return;
+	}
+
+	mapfree_set(output->mf, mref->ref_pos, -1);
+
+	MARS_IO("RIO rw=%d pos=%lld len=%d data=%p\n", mref->ref_rw, mref->ref_pos, mref->ref_len, mref->ref_data);
+
+	mref_a->di.dirty_stage = 0;
+	if (mref->ref_rw) {
+		mf_insert_dirty(output->mf, &mref_a->di);
+	}
+
+	_sq_enqueue(output, mref_a, mref->ref_prio);
+}
+
+static
+int rio_sync(struct file *file)
+{
+#if defined(S_BIAS) || (defined(RHEL_MAJOR) && (RHEL_MAJOR < 7))
+	return vfs_fsync_range(file, file->f_path.dentry, 0, LLONG_MAX, 0);
+#else
+	return vfs_fsync_range(file, 0, LLONG_MAX, 0);
+#endif
+}
+
+/* Returns false when the request has been requeued,
+ * because a read is waiting for the file to grow.
+ */
+static
+bool _rio_do_io(struct rio_output *output, struct rio_mref_aspect *mref_a)
+{
+	struct mref_object *mref = mref_a->object;
+	struct file *file = output->mf->mf_filp;
+	loff_t pos = mref->ref_pos;
+	mm_segment_t oldfs;
+	int status;
+
+	// check for reads crossing the EOF boundary (special case)
+	if (mref->ref_timeout > 0 && !mref->ref_rw) {
+		loff_t len;
+
+		mref->ref_total_size = get_total_size(output);
+		len = mref->ref_total_size - mref->ref_pos;
+		if (len <= 0) {
+			if (!mref_a->start_jiffies) {
+				mref_a->start_jiffies = jiffies;
+			}
+			if ((long long)jiffies - mref_a->start_jiffies <= mref->ref_timeout) {
+				if (atomic_read(&output->sq_count) <= 0) {
+					atomic_inc(&output->total_msleep_count);
+					brick_msleep(1000 * 4 / HZ);
+				}
+				_sq_enqueue(output, mref_a, MARS_PRIO_LOW);
+				return false;
+			}
+			MARS_DBG("ENODATA %lld\n", len);
+			mref_a->status = -ENODATA;
+			return true;
+		}
+		if (mref->ref_len > len)
+			mref->ref_len = len;
+	}
+
+	mars_trace(mref, "rio_submit");
+	mref_a->di.dirty_stage = 1;
+
+	oldfs = get_fs();
+	set_fs(get_ds());
+	if (mref->ref_rw) {
+		(void)TIME_STATS(&timings[1], status = vfs_write(file, mref->ref_data, mref->ref_len, &pos));
+	} else {
+		(void)TIME_STATS(&timings[0], status = vfs_read(file, mref->ref_data, mref->ref_len, &pos));
+	}
+	set_fs(oldfs);
+
+	mref_a->di.dirty_stage = 2;
+	mapfree_set(output->mf, mref->ref_pos, mref->ref_pos + mref->ref_len);
+
+	mref_a->status = status;
+	mref_a->link_sync =
+		status >= 0 &&
+		mref->ref_rw &&
+		output->brick->o_fdsync &&
+		!mref->ref_skip_sync;
+	return true;
+}
+
+static
+int rio_worker_thread(void *data)
+{
+	struct rio_output *output = data;
+
+	MARS_DBG("worker thread has started on '%s'.\n", output->brick->brick_path);
+
+	while (!brick_thread_should_stop() || atomic_read(&output->sq_count) > 0) {
+		struct rio_mref_aspect *batch[RIO_BATCH_MAX];
+		LIST_HEAD(tmp_list);
+		int count;
+		int done = 0;
+		int i;
+
+		wait_event_interruptible_timeout(
+			output->sq_event,
+			atomic_read(&output->sq_count) > 0 || brick_thread_should_stop(),
+			HZ / 4);
+
+		count = _sq_dequeue_batch(output, batch, RIO_BATCH_MAX);
+		if (!count)
+			continue;
+
+		atomic_inc(&output->total_batch_count);
+		for (i = 0; i < count; i++) {
+			if (!_rio_do_io(output, batch[i]))
+				continue;
+			list_add_tail(&batch[i]->io_head, &tmp_list);
+			done++;
+		}
+
+		if (done > 0)
+			_cq_add(output, &tmp_list, done);
+	}
+
+	MARS_DBG("worker thread has stopped.\n");
+	return 0;
+}
+
+/* The reaper completes everything in the completion queue.
+ * All linked writes which have been reaped together share one
+ * fsync, which is also shared with other outputs on the same file.
+ */
+static
+int rio_reaper_thread(void *data)
+{
+	struct rio_output *output = data;
+
+	MARS_DBG("reaper thread has started on '%s'.\n", output->brick->brick_path);
+
+	while (!brick_thread_should_stop() || atomic_read(&output->cq_count) > 0) {
+		LIST_HEAD(tmp_list);
+		LIST_HEAD(link_list);
+		unsigned long flags;
+		int count;
+
+		wait_event_interruptible_timeout(
+			output->cq_event,
+			atomic_read(&output->cq_count) > 0 || brick_thread_should_stop(),
+			HZ / 4);
+
+		traced_lock(&output->cq_lock, flags);
+		list_replace_init(&output->cq_list, &tmp_list);
+		count = atomic_read(&output->cq_count);
+		atomic_sub(count, &output->cq_count);
+		traced_unlock(&output->cq_lock, flags);
+
+		if (list_empty(&tmp_list))
+			continue;
+
+		atomic_inc(&output->total_reap_count);
+
+		while (!list_empty(&tmp_list)) {
+			struct rio_mref_aspect *mref_a = container_of(tmp_list.next, struct rio_mref_aspect, io_head);
+
+			list_del_init(&mref_a->io_head);
+			if (mref_a->link_sync) {
+				list_add_tail(&mref_a->io_head, &link_list);
+				continue;
+			}
+			mref_a->di.dirty_stage = 3;
+			_complete(output, mref_a, mref_a->status);
+		}
+
+		if (!list_empty(&link_list)) {
+			bool saved = false;
+			int err;
+
+			(void)TIME_STATS(
+				&timings[2],
+				err = mf_group_sync(output->mf, rio_sync, &saved)
+				);
+			if (saved) {
+				atomic_inc(&output->total_fdsync_saved_count);
+			} else {
+				atomic_inc(&output->total_fdsync_count);
+			}
+			if (unlikely(err < 0)) {
+				MARS_ERR("FDSYNC error %d\n", err);
+			}
+
+			while (!list_empty(&link_list)) {
+				struct rio_mref_aspect *mref_a = container_of(link_list.next, struct rio_mref_aspect, io_head);
+
+				list_del_init(&mref_a->io_head);
+				atomic_inc(&output->total_link_count);
+				mref_a->di.dirty_stage = 3;
+				_complete(output, mref_a, err < 0 ? err : mref_a->status);
+			}
+		}
+	}
+
+	MARS_DBG("reaper thread has stopped.\n");
+	return 0;
+}
+
+static int rio_get_info(struct rio_output *output, struct mars_info *info)
+{
+	struct file *file;
+
+	if (unlikely(!output ||
+		     !output->mf ||
+		     !(file = output->mf->mf_filp) ||
+		     !file->f_mapping ||
+		     !file->f_mapping->host))
+		return -EINVAL;
+
+	info->tf_align = 1;
+	info->tf_min_size = 1;
+	info->current_size = get_total_size(output);
+
+	MARS_DBG("determined file size = %lld\n", info->current_size);
+
+	return 0;
+}
+
+//////////////// informational / statistics ///////////////
+
+static noinline
+char *rio_statistics(struct rio_brick *brick, int verbose)
+{
+	struct rio_output *output = brick->outputs[0];
+	char *res = brick_string_alloc(4096);
+	int pos = 0;
+	if (!res)
+		return NULL;
+
+	pos += report_timing(&timings[0], res + pos, 4096 - pos);
+	pos += report_timing(&timings[1], res + pos, 4096 - pos);
+	pos += report_timing(&timings[2], res + pos, 4096 - pos);
+
+	snprintf(res + pos, 4096 - pos,
+		 "workers = %d "
+		 "total "
+		 "reads = %d "
+		 "writes = %d "
+		 "allocs = %d "
+		 "batches = %d "
+		 "reaps = %d "
+		 "linked = %d "
+		 "fdsyncs = %d "
+		 "fdsync_saved = %d "
+		 "msleeps = %d | "
+		 "flying reads = %d "
+		 "writes = %d "
+		 "allocs = %d "
+		 "sq = %d "
+		 "cq = %d\n",
+		 output->nr_workers,
+		 atomic_read(&output->total_read_count),
+		 atomic_read(&output->total_write_count),
+		 atomic_read(&output->total_alloc_count),
+		 atomic_read(&output->total_batch_count),
+		 atomic_read(&output->total_reap_count),
+		 atomic_read(&output->total_link_count),
+		 atomic_read(&output->total_fdsync_count),
+		 atomic_read(&output->total_fdsync_saved_count),
+		 atomic_read(&output->total_msleep_count),
+		 atomic_read(&output->read_count),
+		 atomic_read(&output->write_count),
+		 atomic_read(&output->alloc_count),
+		 atomic_read(&output->sq_count),
+		 atomic_read(&output->cq_count));
+
+	return res;
+}
+
+static noinline
+void rio_reset_statistics(struct rio_brick *brick)
+{
+	struct rio_output *output = brick->outputs[0];
+	atomic_set(&output->total_read_count, 0);
+	atomic_set(&output->total_write_count, 0);
+	atomic_set(&output->total_alloc_count, 0);
+	atomic_set(&output->total_batch_count, 0);
+	atomic_set(&output->total_reap_count, 0);
+	atomic_set(&output->total_link_count, 0);
+	atomic_set(&output->total_fdsync_count, 0);
+	atomic_set(&output->total_fdsync_saved_count, 0);
+	atomic_set(&output->total_msleep_count, 0);
+}
+
+//////////////// object / aspect constructors / destructors ///////////////
+
+static int rio_mref_aspect_init_fn(struct generic_aspect *_ini)
+{
+	struct rio_mref_aspect *ini = (void*)_ini;
+	INIT_LIST_HEAD(&ini->io_head);
+	INIT_LIST_HEAD(&ini->di.dirty_head);
+	ini->di.dirty_mref = ini->object;
+	return 0;
+}
+
+static void rio_mref_aspect_exit_fn(struct generic_aspect *_ini)
+{
+	struct rio_mref_aspect *ini = (void*)_ini;
+	CHECK_HEAD_EMPTY(&ini->di.dirty_head);
+	CHECK_HEAD_EMPTY(&ini->io_head);
+}
+
+MARS_MAKE_STATICS(rio);
+
+////////////////////// brick constructors / destructors ////////////////////
+
+static int rio_brick_construct(struct rio_brick *brick)
+{
+	return 0;
+}
+
+static
+void rio_stop_threads(struct rio_output *output)
+{
+	int i;
+
+	// workers first, they feed the reaper
+	for (i = 0; i < RIO_MAX_WORKERS; i++) {
+		if (!output->worker[i])
+			continue;
+		MARS_DBG("stopping worker %d\n", i);
+		brick_thread_stop(output->worker[i]);
+		output->worker[i] = NULL;
+	}
+	if (output->reaper) {
+		MARS_DBG("stopping reaper\n");
+		brick_thread_stop(output->reaper);
+		output->reaper = NULL;
+	}
+	output->nr_workers = 0;
+}
+
+static int rio_switch(struct rio_brick *brick)
+{
+	static int index;
+	struct rio_output *output = brick->outputs[0];
+	const char *path = output->brick->brick_path;
+	int flags = O_RDWR | O_LARGEFILE;
+	int nr_workers;
+	int status = 0;
+	int i;
+
+	MARS_DBG("power.button = %d\n", brick->power.button);
+	if (!brick->power.button)
+		goto cleanup;
+
+	if (brick->power.led_on || output->mf)
+		goto done;
+
+	mars_power_led_off((void*)brick, false);
+
+	if (brick->o_creat) {
+		flags |= O_CREAT;
+		MARS_DBG("using O_CREAT on %s\n", path);
+	}
+	if (brick->o_direct) {
+		flags |= O_DIRECT;
+		MARS_DBG("using O_DIRECT on %s\n", path);
+	}
+
+	output->mf = mapfree_get(path, flags);
+	if (unlikely(!output->mf)) {
+		MARS_ERR("could not open file = '%s' flags = %d\n", path, flags);
+		status = -ENOENT;
+		goto err;
+	}
+
+	output->index = ++index;
+
+	nr_workers = rio_nr_workers;
+	if (nr_workers < 1)
+		nr_workers = 1;
+	else if (nr_workers > RIO_MAX_WORKERS)
+		nr_workers = RIO_MAX_WORKERS;
+
+	status = -ENOENT;
+	output->reaper = brick_thread_create(rio_reaper_thread, output, "mars_rio_c%d", output->index);
+	if (unlikely(!output->reaper)) {
+		MARS_ERR("cannot create reaper thread\n");
+		goto err;
+	}
+	for (i = 0; i < nr_workers; i++) {
+		output->worker[i] = brick_thread_create(rio_worker_thread, output, "mars_rio_w%d.%d", output->index, i);
+		if (unlikely(!output->worker[i])) {
+			MARS_ERR("cannot create worker thread %d\n", i);
+			goto err;
+		}
+		output->nr_workers++;
+	}
+	status = 0;
+
+	MARS_DBG("opened file '%s'\n", path);
+	mars_power_led_on((void*)brick, true);
+
+done:
+	return 0;
+
+err:
+	MARS_ERR("status = %d\n", status);
+cleanup:
+	if (brick->power.led_off) {
+		goto done;
+	}
+
+	mars_power_led_on((void*)brick, false);
+
+	rio_stop_threads(output);
+
+	mars_power_led_off((void*)brick, true);
+
+	MARS_DBG("switch off led_off = %d status = %d\n", brick->power.led_off, status);
+	if (output->mf) {
+		MARS_DBG("closing file = '%s'\n", output->mf->mf_name);
+		mapfree_put(output->mf);
+		output->mf = NULL;
+	}
+	return status;
+}
+
+static int rio_output_construct(struct rio_output *output)
+{
+	int i;
+
+	for (i = 0; i < MARS_PRIO_NR; i++) {
+		INIT_LIST_HEAD(&output->sq_list[i]);
+	}
+	spin_lock_init(&output->sq_lock);
+	init_waitqueue_head(&output->sq_event);
+	INIT_LIST_HEAD(&output->cq_list);
+	spin_lock_init(&output->cq_lock);
+	init_waitqueue_head(&output->cq_event);
+	return 0;
+}
+
+static int rio_output_destruct(struct rio_output *output)
+{
+	if (unlikely(output->reaper)) {
+		MARS_ERR("active threads detected\n");
+	}
+	return 0;
+}
+
+///////////////////////// static structs ////////////////////////
+
+static struct rio_brick_ops rio_brick_ops = {
+	.brick_switch = rio_switch,
+	.brick_statistics = rio_statistics,
+	.reset_statistics = rio_reset_statistics,
+};
+
+static struct rio_output_ops rio_output_ops = {
+	.mref_get = rio_ref_get,
+	.mref_put = rio_ref_put,
+	.mref_io = rio_ref_io,
+	.mars_get_info = rio_get_info,
+};
+
+const struct rio_input_type rio_input_type = {
+	.type_name = "rio_input",
+	.input_size = sizeof(struct rio_input),
+};
+
+static const struct rio_input_type *rio_input_types[] = {
+	&rio_input_type,
+};
+
+const struct rio_output_type rio_output_type = {
+	.type_name = "rio_output",
+	.output_size = sizeof(struct rio_output),
+	.master_ops = &rio_output_ops,
+	.output_construct = &rio_output_construct,
+	.output_destruct = &rio_output_destruct,
+};
+
+static const struct rio_output_type *rio_output_types[] = {
+	&rio_output_type,
+};
+
+const struct rio_brick_type rio_brick_type = {
+	.type_name = "rio_brick",
+	.brick_size = sizeof(struct rio_brick),
+	.max_inputs = 0,
+	.max_outputs = 1,
+	.master_ops = &rio_brick_ops,
+	.aspect_types = rio_aspect_types,
+	.default_input_types = rio_input_types,
+	.default_output_types = rio_output_types,
+	.brick_construct = &rio_brick_construct,
+};
+EXPORT_SYMBOL_GPL(rio_brick_type);
+
+////////////////// module init stuff /////////////////////////
+
+int __init init_mars_rio(void)
+{
+	MARS_DBG("init_rio()\n");
+	_rio_brick_type = (void*)&rio_brick_type;
+	return rio_register_brick_type();
+}
+
+void __exit exit_mars_rio(void)
+{
+	MARS_DBG("exit_rio()\n");
+	rio_unregister_brick_type();
+}
+
+#ifndef CONFIG_MARS_HAVE_BIGMODULE
+MODULE_DESCRIPTION("MARS rio brick");
+MODULE_AUTHOR("Thomas Schoebel-Theuer <tst@1und1.de>");
+MODULE_LICENSE("GPL");
+
+module_init(init_mars_rio);
+module_exit(exit_mars_rio);
+#endif
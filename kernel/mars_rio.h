@@ -0,0 +1,82 @@
+// (c) 2012 Thomas Schoebel-Theuer / 1&1 Internet AG
+#ifndef MARS_RIO_H
+#define MARS_RIO_H
+
+#include "lib_mapfree.h"
+
+/* Ring IO brick.
+ *
+ * Alternative to the aio brick for files.
+ * Requests are put into a submission queue which is served by a
+ * small pool of worker threads doing ordinary kernel IO, without any
+ * userspace context. Results go to a completion queue which is reaped
+ * by a single thread. Writes needing a sync are linked to the next
+ * fsync operation, which is shared by all writes reaped together.
+ */
+
+#define RIO_MAX_WORKERS  16
+#define RIO_BATCH_MAX    16
+
+extern int rio_nr_workers;
+
+struct rio_mref_aspect {
+	GENERIC_ASPECT(mref);
+	struct list_head io_head;
+	struct dirty_info di;
+	unsigned long long enqueue_stamp;
+	long long start_jiffies;
+	int alloc_len;
+	int status;
+	bool do_dealloc;
+	bool link_sync;
+};
+
+struct rio_brick {
+	MARS_BRICK(rio);
+	// parameters
+	bool o_creat;
+	bool o_direct;
+	bool o_fdsync;
+	bool is_static_device;
+};
+
+struct rio_input {
+	MARS_INPUT(rio);
+};
+
+struct rio_output {
+	MARS_OUTPUT(rio);
+        // private
+	struct mapfree_info *mf;
+	// submission queue, served by the workers
+	struct list_head sq_list[MARS_PRIO_NR];
+	spinlock_t sq_lock;
+	wait_queue_head_t sq_event;
+	atomic_t sq_count;
+	// completion queue, reaped by a single thread
+	struct list_head cq_list;
+	spinlock_t cq_lock;
+	wait_queue_head_t cq_event;
+	atomic_t cq_count;
+	struct task_struct *worker[RIO_MAX_WORKERS];
+	struct task_struct *reaper;
+	int nr_workers;
+	// statistics
+	int index;
+	atomic_t total_read_count;
+	atomic_t total_write_count;
+	atomic_t total_alloc_count;
+	atomic_t total_batch_count;
+	atomic_t total_reap_count;
+	atomic_t total_link_count;
+	atomic_t total_fdsync_count;
+	atomic_t total_fdsync_saved_count;
+	atomic_t total_msleep_count;
+	atomic_t read_count;
+	atomic_t write_count;
+	atomic_t alloc_count;
+};
+
+MARS_TYPES(rio);
+
+#endif
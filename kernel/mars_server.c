@@ -15,6 +15,7 @@
 #include "mars_bio.h"
 #include "mars_aio.h"
 #include "mars_sio.h"
+#include "mars_rio.h"
 
 ///////////////////////// own type definitions ////////////////////////
 
@@ -30,12 +31,43 @@ EXPORT_SYMBOL_GPL(server_handler_count);
 
 ///////////////////////// own helper functions ////////////////////////
 
+static
+void _cb_put(struct server_brick *brick, struct server_mref_aspect *mref_a)
+{
+	struct mref_object *mref = mref_a->object;
+
+	if (mref_a->do_put) {
+		GENERIC_INPUT_CALL(brick->inputs[0], mref_put, mref);
+		atomic_dec(&brick->in_flight);
+	} else {
+		mars_free_mref(mref);
+	}
+}
+
+/* Zero-copy data must not be released before the stack is done with it.
+ * The pins are released in FIFO order, so we can stop at the first
+ * busy one.
+ */
+static
+void _cb_put_pinned(struct server_brick *brick, struct list_head *pin_list)
+{
+	struct mars_socket *sock = &brick->handler_socket;
+
+	while (!list_empty(pin_list)) {
+		struct server_mref_aspect *mref_a = container_of(pin_list->next, struct server_mref_aspect, cb_head);
+		if (mars_pin_busy(sock, mref_a->object))
+			break;
+		list_del_init(&mref_a->cb_head);
+		_cb_put(brick, mref_a);
+	}
+}
 
 static
 int cb_thread(void *data)
 {
 	struct server_brick *brick = data;
 	struct mars_socket *sock = &brick->handler_socket;
+	LIST_HEAD(pin_list);
 	bool aborted = false;
 	bool ok = mars_get_socket(sock);
 	int status = -EINVAL;
@@ -47,17 +79,19 @@ int cb_thread(void *data)
 	brick->cb_running = true;
 	wake_up_interruptible(&brick->startup_event);
 
-        while (!brick_thread_should_stop() || !list_empty(&brick->cb_read_list) || !list_empty(&brick->cb_write_list) || atomic_read(&brick->in_flight) > 0) {
+        while (!brick_thread_should_stop() || !list_empty(&brick->cb_read_list) || !list_empty(&brick->cb_write_list) || atomic_read(&brick->in_flight) > 0 || !list_empty(&pin_list)) {
 		struct server_mref_aspect *mref_a;
 		struct mref_object *mref;
 		struct list_head *tmp;
 		unsigned long flags;
 		
+		_cb_put_pinned(brick, &pin_list);
+
 		wait_event_interruptible_timeout(
 			brick->cb_event,
 			!list_empty(&brick->cb_read_list) ||
 			!list_empty(&brick->cb_write_list),
-			1 * HZ);
+			list_empty(&pin_list) ? 1 * HZ : 1);
 
 		traced_lock(&brick->cb_lock, flags);
 		tmp = brick->cb_write_list.next;
@@ -96,12 +130,11 @@ int cb_thread(void *data)
 			mars_shutdown_socket(sock);
 		}
 
-		if (mref_a->do_put) {
-			GENERIC_INPUT_CALL(brick->inputs[0], mref_put, mref);
-			atomic_dec(&brick->in_flight);
-		} else {
-			mars_free_mref(mref);
+		if (mars_pin_busy(sock, mref)) {
+			list_add_tail(&mref_a->cb_head, &pin_list);
+			continue;
 		}
+		_cb_put(brick, mref_a);
 	}
 
 	mars_shutdown_socket(sock);
@@ -245,6 +278,21 @@ int _set_server_sio_params(struct mars_brick *_brick, void *private)
 	return 1;
 }
 
+static
+int _set_server_rio_params(struct mars_brick *_brick, void *private)
+{
+	struct rio_brick *rio_brick = (void*)_brick;
+	if (_brick->type != (void*)_rio_brick_type) {
+		MARS_ERR("bad brick type\n");
+		return -EINVAL;
+	}
+	rio_brick->o_creat = false;
+	rio_brick->o_direct = false;
+	rio_brick->o_fdsync = false;
+	MARS_INF("name = '%s' path = '%s'\n", _brick->brick_name, _brick->brick_path);
+	return 1;
+}
+
 static
 int _set_server_aio_params(struct mars_brick *_brick, void *private)
 {
@@ -252,6 +300,9 @@ int _set_server_aio_params(struct mars_brick *_brick, void *private)
 	if (_brick->type == (void*)_sio_brick_type) {
 		return _set_server_sio_params(_brick, private);
 	}
+	if (_brick->type == (void*)_rio_brick_type) {
+		return _set_server_rio_params(_brick, private);
+	}
 	if (_brick->type != (void*)_aio_brick_type) {
 		MARS_ERR("bad brick type\n");
 		return -EINVAL;
@@ -273,6 +324,9 @@ int _set_server_bio_params(struct mars_brick *_brick, void *private)
 	if (_brick->type == (void*)_sio_brick_type) {
 		return _set_server_sio_params(_brick, private);
 	}
+	if (_brick->type == (void*)_rio_brick_type) {
+		return _set_server_rio_params(_brick, private);
+	}
 	if (_brick->type != (void*)_bio_brick_type) {
 		MARS_ERR("bad brick type\n");
 		return -EINVAL;
@@ -286,12 +340,89 @@ int _set_server_bio_params(struct mars_brick *_brick, void *private)
 	return 1;
 }
 
+/* Cached snapshot of the /mars tree for CMD_GETENTS.
+ * All handlers share one persistent dent list, which is rescanned at
+ * most once per server_getents_cache_ms (and only incrementally when
+ * mars_incremental_scan is enabled).
+ * Each dent is stamped with the generation of its last change, such
+ * that peers can ask for the changes since their last known generation.
+ */
+int server_getents_cache_ms = 200;
+EXPORT_SYMBOL_GPL(server_getents_cache_ms);
+
+static struct mars_global getents_global = {
+	.dent_anchor = LIST_HEAD_INIT(getents_global.dent_anchor),
+	.brick_anchor = LIST_HEAD_INIT(getents_global.brick_anchor),
+	.global_power = {
+		.button = true,
+	},
+	.dent_mutex = __RWSEM_INITIALIZER(getents_global.dent_mutex),
+	.brick_mutex = __RWSEM_INITIALIZER(getents_global.brick_mutex),
+	.main_event = __WAIT_QUEUE_HEAD_INITIALIZER(getents_global.main_event),
+};
+static DEFINE_MUTEX(getents_mutex);
+static long long getents_jiffies = 0;
+static long long getents_generation = 0;
+static bool getents_valid = false;
+
 static
-int dummy_worker(struct mars_global *global, struct mars_dent *dent, bool prepare, bool direction)
+int getents_worker(struct mars_global *global, struct mars_dent *dent, bool prepare, bool direction)
 {
+	// forget dents whose inode has gone (children first)
+	if (prepare && dent->d_vanished && !dent->d_child_count)
+		dent->d_killme = true;
 	return 0;
 }
 
+static
+bool _dent_changed(struct mars_dent *dent)
+{
+	return !dent->d_generation ||
+		dent->new_stat.mode != dent->old_stat.mode ||
+		dent->new_stat.size != dent->old_stat.size ||
+		timespec_compare(&dent->new_stat.mtime, &dent->old_stat.mtime) ||
+		timespec_compare(&dent->new_stat.ctime, &dent->old_stat.ctime);
+}
+
+static
+void getents_refresh(void)
+{
+	struct list_head *tmp;
+	long long generation;
+
+	mutex_lock(&getents_mutex);
+	if (getents_valid && server_getents_cache_ms > 0 &&
+	    (long long)jiffies - getents_jiffies < (long long)msecs_to_jiffies(server_getents_cache_ms))
+		goto done;
+
+	(void)mars_dent_work(&getents_global, "/mars", sizeof(struct mars_dent), light_checker, getents_worker, &getents_global, 3);
+	getents_jiffies = jiffies;
+	getents_valid = true;
+
+	/* Starting from the lamport clock ensures that generations keep
+	 * growing over restarts of the server.
+	 */
+	if (!getents_generation) {
+		struct timespec now;
+		get_lamport(&now);
+		getents_generation = (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+	}
+	generation = getents_generation + 1;
+
+	down_write(&getents_global.dent_mutex);
+	for (tmp = getents_global.dent_anchor.next; tmp != &getents_global.dent_anchor; tmp = tmp->next) {
+		struct mars_dent *dent = container_of(tmp, struct mars_dent, dent_link);
+		if (_dent_changed(dent)) {
+			dent->d_generation = generation;
+			getents_generation = generation;
+		}
+	}
+	up_write(&getents_global.dent_mutex);
+
+done:
+	mutex_unlock(&getents_mutex);
+}
+
 static
 int handler_thread(void *data)
 {
@@ -357,33 +488,35 @@ int handler_thread(void *data)
 		}
 		case CMD_GETENTS:
 		{
-			struct mars_global local = {
-				.dent_anchor = LIST_HEAD_INIT(local.dent_anchor),
-				.brick_anchor = LIST_HEAD_INIT(local.brick_anchor),
-				.global_power = {
-					.button = true,
-				},
-				.main_event = __WAIT_QUEUE_HEAD_INITIALIZER(local.main_event),
-			};
+			LIST_HEAD(tmp_list);
+			long long since = cmd.cmd_generation;
 
 			status = -EINVAL;
 			if (unlikely(!cmd.cmd_str1))
 				break;
 
-			init_rwsem(&local.dent_mutex);
-			init_rwsem(&local.brick_mutex);
+			getents_refresh();
 
-			status = mars_dent_work(&local, "/mars", sizeof(struct mars_dent), light_checker, dummy_worker, &local, 3);
+			/* Never hold the lock during network IO, otherwise
+			 * a stalled peer would block all others.
+			 */
+			down_read(&getents_global.dent_mutex);
+			// unknown generation (e.g. from an old snapshot) => send all
+			if (since > getents_generation)
+				since = 0;
+			status = mars_copy_dent_delta(&getents_global.dent_anchor, since, &tmp_list);
+			up_read(&getents_global.dent_mutex);
 
-			down(&brick->socket_sem);
-			status = mars_send_dent_list(sock, &local.dent_anchor);
-			up(&brick->socket_sem);
+			if (status >= 0) {
+				down(&brick->socket_sem);
+				status = mars_send_dent_list(sock, &tmp_list);
+				up(&brick->socket_sem);
+			}
+			mars_free_dent_all(NULL, &tmp_list);
 
 			if (status < 0) {
 				MARS_WRN("#%d could not send dentry information, status = %d\n", sock->s_debug_nr, status);
 			}
-
-			mars_free_dent_all(&local, &local.dent_anchor);
 			break;
 		}
 		case CMD_CONNECT:
@@ -395,6 +528,12 @@ int handler_thread(void *data)
 			CHECK_PTR(path, err);
 			CHECK_PTR_NULL(_bio_brick_type, err);
 
+			/* Clients may open several connections (channels) to
+			 * the same path. Each of them gets its own server
+			 * brick; the client keeps the ordering per position.
+			 */
+			MARS_DBG("#%d connect channel %d to '%s'\n", sock->s_debug_nr, cmd.cmd_int1, path);
+
 			if (!brick->global || !mars_global || !mars_global->global_power.button) {
 				MARS_WRN("#%d system is not alive\n", sock->s_debug_nr);
 				goto err;
@@ -423,6 +562,12 @@ int handler_thread(void *data)
 			}
 			
 		err:
+			/* Grant the requested payload compression when we know
+			 * the method. Old clients never request anything.
+			 */
+			if (cmd.cmd_compress <= MARS_COMPRESS_NONE || cmd.cmd_compress >= MARS_COMPRESS_MAX || status < 0)
+				cmd.cmd_compress = MARS_COMPRESS_NONE;
+			sock->s_compress = cmd.cmd_compress;
 			cmd.cmd_int1 = status;
 			down(&brick->socket_sem);
 			status = mars_send_struct(sock, &cmd, mars_cmd_meta);
@@ -583,10 +728,28 @@ char *server_statistics(struct server_brick *brick, int verbose)
 	snprintf(res, 1024,
 		 "cb_running = %d "
 		 "handler_running = %d "
-		 "in_flight = %d\n",
+		 "in_flight = %d | "
+		 "send_calls = %d "
+		 "send_mrefs = %d "
+		 "recv_calls = %d "
+		 "recv_mrefs = %d | "
+		 "compress = %d "
+		 "compress_percent = %d "
+		 "compress_us_per_mb = %d "
+		 "decompress_percent = %d "
+		 "decompress_us_per_mb = %d\n",
 		 brick->cb_running,
 		 brick->handler_running,
-		 atomic_read(&brick->in_flight));
+		 atomic_read(&brick->in_flight),
+		 brick->handler_socket.s_send_calls,
+		 brick->handler_socket.s_send_mrefs,
+		 brick->handler_socket.s_recv_calls,
+		 brick->handler_socket.s_recv_mrefs,
+		 brick->handler_socket.s_compress,
+		 mars_compress_percent(&brick->handler_socket.s_compress_stat),
+		 mars_compress_us_per_mb(&brick->handler_socket.s_compress_stat),
+		 mars_compress_percent(&brick->handler_socket.s_decompress_stat),
+		 mars_compress_us_per_mb(&brick->handler_socket.s_decompress_stat));
 
         return res;
 }
@@ -829,6 +992,8 @@ void __exit exit_mars_server(void)
 		MARS_INF("closing server socket %d...\n", i);
 		mars_put_socket(&server_socket[i]);
 	}
+
+	mars_free_dent_all(&getents_global, &getents_global.dent_anchor);
 }
 
 int __init init_mars_server(void)
@@ -8,6 +8,7 @@
 #include "lib_limiter.h"
 
 extern int server_show_statist;
+extern int server_getents_cache_ms;
 
 extern struct mars_limiter server_limiter;
 
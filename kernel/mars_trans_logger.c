@@ -37,6 +37,7 @@
 #define CONF_TRANS_CHUNKSIZE    (128 * 1024)
 #endif
 #define CONF_TRANS_MAX_MREF_SIZE PAGE_SIZE
+#define CONF_TRANS_REPLAY_CHUNKSIZE (CONF_TRANS_CHUNKSIZE * 8)
 //#define CONF_TRANS_ALIGN      PAGE_SIZE // FIXME: does not work
 #define CONF_TRANS_ALIGN      0
 
@@ -52,9 +53,18 @@
 
 struct trans_logger_hash_anchor {
 	struct rw_semaphore hash_mutex;
-	struct list_head hash_anchor;
+	struct rb_root hash_root;
+	unsigned long long hash_seq;
+	int hash_max_len;
 };
 
+#define CHECK_HASH_EMPTY(mref_a)					\
+do {									\
+	if (BRICK_CHECKING && unlikely(!RB_EMPTY_NODE(&(mref_a)->hash_node))) { \
+		MARS_ERR("%d: mref %p is still hashed\n", __LINE__, (mref_a)->object); \
+	}								\
+} while (0)
+
 #define NR_HASH_PAGES       64
 
 #define MAX_HASH_PAGES      (PAGE_SIZE / sizeof(struct trans_logger_hash_anchor*))
@@ -74,6 +84,12 @@ int trans_logger_do_crc =
 #endif
 EXPORT_SYMBOL_GPL(trans_logger_do_crc);
 
+int trans_logger_crc_type = LOG_CRC_MD5;
+EXPORT_SYMBOL_GPL(trans_logger_crc_type);
+
+int trans_logger_group_delay_us = 0;
+EXPORT_SYMBOL_GPL(trans_logger_group_delay_us);
+
 int trans_logger_mem_usage; // in KB
 EXPORT_SYMBOL_GPL(trans_logger_mem_usage);
 
@@ -86,6 +102,45 @@ EXPORT_SYMBOL_GPL(trans_logger_resume);
 int trans_logger_replay_timeout = 1; // in s
 EXPORT_SYMBOL_GPL(trans_logger_replay_timeout);
 
+int trans_logger_lazy_replay_kb = 0;
+EXPORT_SYMBOL_GPL(trans_logger_lazy_replay_kb);
+
+int trans_logger_replay_depth = 512;
+EXPORT_SYMBOL_GPL(trans_logger_replay_depth);
+
+int trans_logger_phase_workers = 0;
+EXPORT_SYMBOL_GPL(trans_logger_phase_workers);
+
+int trans_logger_pool_size = 0;
+EXPORT_SYMBOL_GPL(trans_logger_pool_size);
+
+/* The shared logger pool, see below.
+ */
+static struct logger_pool {
+	spinlock_t lock;
+	struct list_head anchor;
+	wait_queue_head_t event;
+	atomic_t event_gen;
+	struct mutex start_mutex;
+	struct task_struct *thread[TL_POOL_MAX];
+	int nr_threads;
+	unsigned long long vclock;
+	atomic64_t busy_ns;
+} logger_pool = {
+	.lock = __SPIN_LOCK_UNLOCKED(logger_pool.lock),
+	.anchor = LIST_HEAD_INIT(logger_pool.anchor),
+	.event = __WAIT_QUEUE_HEAD_INITIALIZER(logger_pool.event),
+	.event_gen = ATOMIC_INIT(0),
+	.start_mutex = __MUTEX_INITIALIZER(logger_pool.start_mutex),
+};
+
+static inline
+void _pool_wakeup(void)
+{
+	atomic_inc(&logger_pool.event_gen);
+	wake_up_interruptible(&logger_pool.event);
+}
+
 struct writeback_group global_writeback = {
 	.lock = __RW_LOCK_UNLOCKED(global_writeback.lock),
 	.group_anchor = LIST_HEAD_INIT(global_writeback.group_anchor),
@@ -192,6 +247,21 @@ void qq_dec_flying(struct logger_queue *q)
 	q_logger_dec_flying(q);
 }
 
+/* Queue latency: from insertion until the first fetch.
+ * Elements which are pushed back are not accounted again.
+ */
+static inline
+void qq_account_wait(struct logger_queue *q, struct logger_head *lh)
+{
+	unsigned long long now = cpu_clock(raw_smp_processor_id());
+
+	if (likely(lh->lh_stamp && now > lh->lh_stamp)) {
+		atomic64_add(now - lh->lh_stamp, &q->q_wait_ns);
+		atomic_inc(&q->q_wait_count);
+	}
+	lh->lh_stamp = 0;
+}
+
 static inline
 void qq_mref_insert(struct logger_queue *q, struct trans_logger_mref_aspect *mref_a)
 {
@@ -201,12 +271,29 @@ void qq_mref_insert(struct logger_queue *q, struct trans_logger_mref_aspect *mre
 
 	mars_trace(mref, q->q_insert_info);
 
+	mref_a->lh.lh_stamp = cpu_clock(raw_smp_processor_id());
 	q_logger_insert(q, &mref_a->lh);
 }
 
+/* Writebacks are traced on behalf of their first original request.
+ */
+static inline
+void qq_wb_trace(struct writeback_info *wb, const char *info)
+{
+	if (unlikely(mars_trace_rate > 0) && !list_empty(&wb->w_collect_list)) {
+		struct trans_logger_mref_aspect *orig_mref_a;
+
+		orig_mref_a = container_of(wb->w_collect_list.next, struct trans_logger_mref_aspect, collect_head);
+		mars_trace(orig_mref_a->object, info);
+	}
+}
+
 static inline
 void qq_wb_insert(struct logger_queue *q, struct writeback_info *wb)
 {
+	qq_wb_trace(wb, q->q_insert_info);
+
+	wb->w_lh.lh_stamp = cpu_clock(raw_smp_processor_id());
 	q_logger_insert(q, &wb->w_lh);
 }
 
@@ -224,6 +311,7 @@ void qq_mref_pushback(struct logger_queue *q, struct trans_logger_mref_aspect *m
 static inline
 void qq_wb_pushback(struct logger_queue *q, struct writeback_info *wb)
 {
+	qq_wb_trace(wb, q->q_pushback_info);
 	q->pushback_count++;
 	q_logger_pushback(q, &wb->w_lh);
 }
@@ -237,6 +325,7 @@ struct trans_logger_mref_aspect *qq_mref_fetch(struct logger_queue *q)
 	test = q_logger_fetch(q);
 
 	if (test) {
+		qq_account_wait(q, test);
 		mref_a = container_of(test, struct trans_logger_mref_aspect, lh);
 		_mref_check(mref_a->object);
 		mars_trace(mref_a->object, q->q_fetch_info);
@@ -253,7 +342,9 @@ struct writeback_info *qq_wb_fetch(struct logger_queue *q)
 	test = q_logger_fetch(q);
 
 	if (test) {
+		qq_account_wait(q, test);
 		res = container_of(test, struct writeback_info, w_lh);
+		qq_wb_trace(res, q->q_fetch_info);
 	}
 	return res;
 }
@@ -271,83 +362,155 @@ int hash_fn(loff_t pos)
 }
 
 static inline
-struct trans_logger_mref_aspect *_hash_find(struct list_head *start, loff_t pos, int *max_len, bool use_collect_head, bool find_unstable)
+struct trans_logger_hash_anchor *hash_anchor(struct trans_logger_brick *brick, loff_t pos)
 {
-	struct list_head *tmp;
-	struct trans_logger_mref_aspect *res = NULL;
-	int len = *max_len;
-#ifdef HASH_DEBUGGING
-	int count = 0;
-#endif
-	
-	/* The lists are always sorted according to age (newest first).
-	 * Caution: there may be duplicates in the list, some of them
-	 * overlapping with the search area in many different ways.
-	 */
-	for (tmp = start->next; tmp != start; tmp = tmp->next) {
+	int hash = hash_fn(pos);
+	struct trans_logger_hash_anchor *sub_table = brick->hash_table[hash / HASH_PER_PAGE];
+	return &sub_table[hash % HASH_PER_PAGE];
+}
+
+/* Each hash anchor holds a tree sorted by ref_pos.
+ * Since no element may cross a REGION_SIZE boundary and all elements
+ * are shorter than hash_max_len, only elements starting after
+ * pos - hash_max_len can overlap with pos.
+ * Return the leftmost of them.
+ */
+static inline
+struct rb_node *_hash_first(struct trans_logger_hash_anchor *start, loff_t pos, int *probes)
+{
+	struct rb_node *node = start->hash_root.rb_node;
+	struct rb_node *res = NULL;
+	loff_t min_pos = pos - start->hash_max_len;
+
+	while (node) {
 		struct trans_logger_mref_aspect *test_a;
-		struct mref_object *test;
-		int diff;
-#ifdef HASH_DEBUGGING
-		static int max = 0;
-		if (++count > max) {
-			max = count;
-			if (!(max % 100)) {
-				MARS_INF("hash max=%d hash=%d (pos=%lld)\n", max, hash_fn(pos), pos);
-			}
-		}
-#endif
-		if (use_collect_head) {
-			test_a = container_of(tmp, struct trans_logger_mref_aspect, collect_head);
+		test_a = rb_entry(node, struct trans_logger_mref_aspect, hash_node);
+		(*probes)++;
+		if (test_a->object->ref_pos > min_pos) {
+			res = node;
+			node = node->rb_left;
 		} else {
-			test_a = container_of(tmp, struct trans_logger_mref_aspect, hash_head);
+			node = node->rb_right;
 		}
-		test = test_a->object;
-		
-		_mref_check(test);
+	}
+	return res;
+}
 
-		// are the regions overlapping?
-		if (pos >= test->ref_pos + test->ref_len || pos + len <= test->ref_pos) {
-			continue; // not relevant
+struct hash_probe {
+	loff_t pos;
+	int    len;
+	int    max_len;
+	struct trans_logger_mref_aspect *res;
+};
+
+/* Caution: there may be duplicates, some of them overlapping with
+ * the search area in many different ways.
+ * The age of an element is given by its hash_seq (newest = highest),
+ * so the result does not depend on the order of visiting.
+ * Two passes are needed:
+ *  1 = determine the newest element covering pos
+ *  2 = clip max_len at any newer element starting after pos
+ * When searching for unstable elements, a stable result means that
+ * the data at pos is already stable, so nothing is found. Stable
+ * elements starting after pos only clip max_len like any other.
+ */
+static inline
+void _hash_check(struct hash_probe *hp, struct trans_logger_mref_aspect *test_a, int pass)
+{
+	struct mref_object *test = test_a->object;
+	unsigned long long limit;
+
+	_mref_check(test);
+
+	// are the regions overlapping?
+	if (hp->pos >= test->ref_pos + test->ref_len || hp->pos + hp->len <= test->ref_pos) {
+		return; // not relevant
+	}
+
+	switch (pass) {
+	case 1:
+		if (test->ref_pos <= hp->pos &&
+		    (!hp->res || test_a->hash_seq > hp->res->hash_seq)) {
+			hp->res = test_a;
 		}
-		
-		// searching for unstable elements (only in special cases)
-		if (find_unstable && test_a->is_stable)
-			break;
-		
-		diff = test->ref_pos - pos;
-		if (diff <= 0) {
-			int restlen = test->ref_len + diff;
-			res = test_a;
-			if (restlen < len) {
-				len = restlen;
-			}
-			break;
+		break;
+	default:
+		limit = hp->res ? hp->res->hash_seq : 0;
+		if (test->ref_pos > hp->pos && test_a->hash_seq > limit) {
+			int diff = test->ref_pos - hp->pos;
+			if (diff < hp->max_len)
+				hp->max_len = diff;
+		}
+	}
+}
+
+/* Search either in the tree of the anchor, or (when collect_list
+ * is given) in a list of previously collected elements.
+ */
+static inline
+struct trans_logger_mref_aspect *_hash_find(struct trans_logger_hash_anchor *start, struct list_head *collect_list, loff_t pos, int *max_len, bool find_unstable, int *probes)
+{
+	struct hash_probe hp = {
+		.pos = pos,
+		.len = *max_len,
+		.max_len = *max_len,
+	};
+	int pass;
+
+	for (pass = 1; pass <= 2; pass++) {
+		if (pass == 2 && hp.res && !(find_unstable && hp.res->is_stable)) {
+			int restlen = hp.res->object->ref_pos + hp.res->object->ref_len - pos;
+			if (restlen < hp.max_len)
+				hp.max_len = restlen;
 		}
-		if (diff < len) {
-			len = diff;
+		if (collect_list) {
+			struct list_head *tmp;
+			for (tmp = collect_list->next; tmp != collect_list; tmp = tmp->next) {
+				struct trans_logger_mref_aspect *test_a;
+				test_a = container_of(tmp, struct trans_logger_mref_aspect, collect_head);
+				(*probes)++;
+				_hash_check(&hp, test_a, pass);
+			}
+		} else {
+			struct rb_node *node;
+			for (node = _hash_first(start, pos, probes); node; node = rb_next(node)) {
+				struct trans_logger_mref_aspect *test_a;
+				test_a = rb_entry(node, struct trans_logger_mref_aspect, hash_node);
+				(*probes)++;
+				if (test_a->object->ref_pos >= pos + hp.len)
+					break;
+				_hash_check(&hp, test_a, pass);
+			}
 		}
 	}
 
-	*max_len = len;
-	return res;
+#ifdef HASH_DEBUGGING
+	{
+		static int max = 0;
+		if (*probes > max + 100) {
+			max = *probes;
+			MARS_INF("probes max=%d hash=%d (pos=%lld)\n", max, hash_fn(pos), pos);
+		}
+	}
+#endif
+	*max_len = hp.max_len;
+	if (find_unstable && hp.res && hp.res->is_stable)
+		return NULL;
+	return hp.res;
 }
 
 static noinline
 struct trans_logger_mref_aspect *hash_find(struct trans_logger_brick *brick, loff_t pos, int *max_len, bool find_unstable)
 {
-	
-	int hash = hash_fn(pos);
-	struct trans_logger_hash_anchor *sub_table = brick->hash_table[hash / HASH_PER_PAGE];
-	struct trans_logger_hash_anchor *start = &sub_table[hash % HASH_PER_PAGE];
+	struct trans_logger_hash_anchor *start = hash_anchor(brick, pos);
 	struct trans_logger_mref_aspect *res;
-	//unsigned int flags;
+	int probes = 0;
 
 	atomic_inc(&brick->total_hash_find_count);
 
 	down_read(&start->hash_mutex);
 
-	res = _hash_find(&start->hash_anchor, pos, max_len, false, find_unstable);
+	res = _hash_find(start, NULL, pos, max_len, find_unstable, &probes);
 
 	/* Ensure the found mref can't go away...
 	 */
@@ -356,20 +519,21 @@ struct trans_logger_mref_aspect *hash_find(struct trans_logger_brick *brick, lof
 	
 	up_read(&start->hash_mutex);
 
+	atomic64_add(probes, &brick->total_hash_probe_count);
 	return res;
 }
 
 static noinline
 void hash_insert(struct trans_logger_brick *brick, struct trans_logger_mref_aspect *elem_a)
 {
-        int hash = hash_fn(elem_a->object->ref_pos);
-	struct trans_logger_hash_anchor *sub_table = brick->hash_table[hash / HASH_PER_PAGE];
-	struct trans_logger_hash_anchor *start = &sub_table[hash % HASH_PER_PAGE];
-        //unsigned int flags;
+	struct mref_object *elem = elem_a->object;
+	struct trans_logger_hash_anchor *start = hash_anchor(brick, elem->ref_pos);
+	struct rb_node **link;
+	struct rb_node *parent = NULL;
 
 #if 1
-	CHECK_HEAD_EMPTY(&elem_a->hash_head);
-	_mref_check(elem_a->object);
+	CHECK_HASH_EMPTY(elem_a);
+	_mref_check(elem);
 #endif
 
 	// only for statistics:
@@ -378,7 +542,24 @@ void hash_insert(struct trans_logger_brick *brick, struct trans_logger_mref_aspe
 
 	down_write(&start->hash_mutex);
 
-        list_add(&elem_a->hash_head, &start->hash_anchor);
+	/* Duplicates are sorted according to age (oldest first).
+	 */
+	link = &start->hash_root.rb_node;
+	while (*link) {
+		struct trans_logger_mref_aspect *test_a;
+		parent = *link;
+		test_a = rb_entry(parent, struct trans_logger_mref_aspect, hash_node);
+		if (elem->ref_pos < test_a->object->ref_pos) {
+			link = &parent->rb_left;
+		} else {
+			link = &parent->rb_right;
+		}
+	}
+	elem_a->hash_seq = ++start->hash_seq;
+	if (elem->ref_len > start->hash_max_len)
+		start->hash_max_len = elem->ref_len;
+	rb_link_node(&elem_a->hash_node, parent, link);
+	rb_insert_color(&elem_a->hash_node, &start->hash_root);
 	elem_a->is_hashed = true;
 
 	up_write(&start->hash_mutex);
@@ -392,16 +573,11 @@ void hash_extend(struct trans_logger_brick *brick, loff_t *_pos, int *_len, stru
 {
 	loff_t pos = *_pos;
 	int len = *_len;
-        int hash = hash_fn(pos);
-	struct trans_logger_hash_anchor *sub_table = brick->hash_table[hash / HASH_PER_PAGE];
-	struct trans_logger_hash_anchor *start = &sub_table[hash % HASH_PER_PAGE];
-	struct list_head *tmp;
+	struct trans_logger_hash_anchor *start = hash_anchor(brick, pos);
+	struct rb_node *node;
+	int probes = 0;
 	bool extended;
-        //unsigned int flags;
-#ifdef HASH_DEBUGGING
-	int count = 0;
-	static int max = 0;
-#endif
+
 	if (collect_list) {
 		CHECK_HEAD_EMPTY(collect_list);
 	}
@@ -413,21 +589,23 @@ void hash_extend(struct trans_logger_brick *brick, loff_t *_pos, int *_len, stru
 	do {
 		extended = false;
 
-		for (tmp = start->hash_anchor.next; tmp != &start->hash_anchor; tmp = tmp->next) {
+		for (node = _hash_first(start, pos, &probes); node; node = rb_next(node)) {
 			struct trans_logger_mref_aspect *test_a;
 			struct mref_object *test;
 			loff_t diff;
-#ifdef HASH_DEBUGGING
-			count++;
-#endif
-			
-			test_a = container_of(tmp, struct trans_logger_mref_aspect, hash_head);
+
+			probes++;
+			test_a = rb_entry(node, struct trans_logger_mref_aspect, hash_node);
 			test = test_a->object;
 			
 			_mref_check(test);
 
+			// sorted by ref_pos => no further overlaps possible
+			if (test->ref_pos >= pos + len)
+				break;
+
 			// are the regions overlapping?
-			if (pos >= test->ref_pos + test->ref_len || pos + len <= test->ref_pos) {
+			if (pos >= test->ref_pos + test->ref_len) {
 				continue; // not relevant
 			}
 
@@ -457,31 +635,19 @@ void hash_extend(struct trans_logger_brick *brick, loff_t *_pos, int *_len, stru
 	*_pos = pos;
 	*_len = len;
 
-#ifdef HASH_DEBUGGING
-	if (count > max + 100) {
-		int i = 0;
-		max = count;
-		MARS_INF("iterations max=%d hash=%d (pos=%lld len=%d)\n", max, hash, pos, len);
-		for (tmp = start->hash_anchor.next; tmp != &start->hash_anchor; tmp = tmp->next) {
-			struct trans_logger_mref_aspect *test_a;
-			struct mref_object *test;
-			test_a = container_of(tmp, struct trans_logger_mref_aspect, hash_head);
-			test = test_a->object;
-			MARS_INF("%03d   pos = %lld len = %d collected = %d\n", i++, test->ref_pos, test->ref_len, test_a->is_collected);
-		}
-		MARS_INF("----------------\n");
-	}
-#endif
-
-	for (tmp = start->hash_anchor.next; tmp != &start->hash_anchor; tmp = tmp->next) {
+	for (node = _hash_first(start, pos, &probes); node; node = rb_next(node)) {
 		struct trans_logger_mref_aspect *test_a;
 		struct mref_object *test;
 		
-		test_a = container_of(tmp, struct trans_logger_mref_aspect, hash_head);
+		probes++;
+		test_a = rb_entry(node, struct trans_logger_mref_aspect, hash_node);
 		test = test_a->object;
 		
+		if (test->ref_pos >= pos + len)
+			break;
+
 		// are the regions overlapping?
-		if (pos >= test->ref_pos + test->ref_len || pos + len <= test->ref_pos) {
+		if (pos >= test->ref_pos + test->ref_len) {
 			continue; // not relevant
 		}
 		
@@ -497,10 +663,11 @@ void hash_extend(struct trans_logger_brick *brick, loff_t *_pos, int *_len, stru
 
  collision:
 	up_read(&start->hash_mutex);
+	atomic64_add(probes, &brick->total_hash_probe_count);
 }
 
 /* Atomically put all elements from the list.
- * All elements must reside in the same collision list.
+ * All elements must reside in the same hash anchor.
  */
 static inline
 void hash_put_all(struct trans_logger_brick *brick, struct list_head *list)
@@ -508,7 +675,6 @@ void hash_put_all(struct trans_logger_brick *brick, struct list_head *list)
 	struct list_head *tmp;
 	struct trans_logger_hash_anchor *start = NULL;
 	int first_hash = -1;
-	//unsigned int flags;
 
 	for (tmp = list->next; tmp != list; tmp = tmp->next) {
 		struct trans_logger_mref_aspect *elem_a;
@@ -522,8 +688,7 @@ void hash_put_all(struct trans_logger_brick *brick, struct list_head *list)
 
 		hash = hash_fn(elem->ref_pos);
 		if (!start) {
-			struct trans_logger_hash_anchor *sub_table = brick->hash_table[hash / HASH_PER_PAGE];
-			start = &sub_table[hash % HASH_PER_PAGE];
+			start = hash_anchor(brick, elem->ref_pos);
 			first_hash = hash;
 			down_write(&start->hash_mutex);
 		} else if (unlikely(hash != first_hash)) {
@@ -534,13 +699,16 @@ void hash_put_all(struct trans_logger_brick *brick, struct list_head *list)
 			continue;
 		}
 
-		list_del_init(&elem_a->hash_head);
+		rb_erase(&elem_a->hash_node, &start->hash_root);
+		RB_CLEAR_NODE(&elem_a->hash_node);
 		elem_a->is_hashed = false;
 		atomic_dec(&brick->hash_count);
 	}
 
 err:	
 	if (start) {
+		if (RB_EMPTY_ROOT(&start->hash_root))
+			start->hash_max_len = 0;
 		up_write(&start->hash_mutex);
 	}
 }
@@ -550,9 +718,7 @@ void hash_ensure_stableness(struct trans_logger_brick *brick, struct trans_logge
 {
 	if (!mref_a->is_stable) {
 		struct mref_object *mref = mref_a->object;
-		int hash = hash_fn(mref->ref_pos);
-		struct trans_logger_hash_anchor *sub_table = brick->hash_table[hash / HASH_PER_PAGE];
-		struct trans_logger_hash_anchor *start = &sub_table[hash % HASH_PER_PAGE];
+		struct trans_logger_hash_anchor *start = hash_anchor(brick, mref->ref_pos);
 
 		down_write(&start->hash_mutex);
 
@@ -601,6 +767,32 @@ EXPORT_SYMBOL_GPL(global_mshadow_count);
 atomic64_t global_mshadow_used  = ATOMIC64_INIT(0);
 EXPORT_SYMBOL_GPL(global_mshadow_used);
 
+/* Shadow buffers are allocated on the home node of the brick,
+ * if there is one. Usage is accounted per node.
+ */
+static inline
+int _shadow_node_index(void *data)
+{
+	int nid = page_to_nid(virt_to_page(data));
+	return nid < TL_MAX_NODES ? nid : TL_MAX_NODES - 1;
+}
+
+static inline
+void *_shadow_alloc(struct trans_logger_brick *brick, loff_t pos, int len)
+{
+	void *data = brick_block_alloc_node(pos, len, brick->numa_node);
+	if (likely(data))
+		atomic64_add(len, &brick->shadow_mem_node[_shadow_node_index(data)]);
+	return data;
+}
+
+static inline
+void _shadow_free(struct trans_logger_brick *brick, void *data, int len)
+{
+	atomic64_sub(len, &brick->shadow_mem_node[_shadow_node_index(data)]);
+	brick_block_free(data, len);
+}
+
 static noinline
 int trans_logger_get_info(struct trans_logger_output *output, struct mars_info *info)
 {
@@ -724,7 +916,7 @@ int _write_ref_get(struct trans_logger_output *output, struct trans_logger_mref_
 #endif
 
 	// create a new master shadow
-	data = brick_block_alloc(mref->ref_pos, (mref_a->alloc_len = mref->ref_len));
+	data = _shadow_alloc(brick, mref->ref_pos, (mref_a->alloc_len = mref->ref_len));
 	if (unlikely(!data)) {
 		return -ENOMEM;
 	}
@@ -861,7 +1053,7 @@ restart:
 		}
 
 		CHECK_HEAD_EMPTY(&mref_a->lh.lh_head);
-		CHECK_HEAD_EMPTY(&mref_a->hash_head);
+		CHECK_HASH_EMPTY(mref_a);
 		CHECK_HEAD_EMPTY(&mref_a->replay_head);
 		CHECK_HEAD_EMPTY(&mref_a->collect_head);
 		CHECK_HEAD_EMPTY(&mref_a->sub_list);
@@ -876,7 +1068,7 @@ restart:
 		if (shadow_a != mref_a) { // we are a slave shadow
 			//MARS_DBG("slave\n");
 			atomic_dec(&brick->sshadow_count);
-			CHECK_HEAD_EMPTY(&mref_a->hash_head);
+			CHECK_HASH_EMPTY(mref_a);
 			trans_logger_free_mref(mref);
 			// now put the master shadow
 			mref_a = shadow_a;
@@ -885,7 +1077,7 @@ restart:
 		// we are a master shadow
 		CHECK_PTR(mref_a->shadow_data, err);
 		if (mref_a->do_dealloc) {
-			brick_block_free(mref_a->shadow_data, mref_a->alloc_len);
+			_shadow_free(brick, mref_a->shadow_data, mref_a->alloc_len);
 			atomic64_sub(mref->ref_len, &brick->shadow_mem_used);
 			mref_a->shadow_data = NULL;
 			mref_a->do_dealloc = false;
@@ -993,7 +1185,7 @@ void trans_logger_ref_io(struct trans_logger_output *output, struct mref_object
 	if (shadow_a) {
 #if 1
 		CHECK_HEAD_EMPTY(&mref_a->lh.lh_head);
-		CHECK_HEAD_EMPTY(&mref_a->hash_head);
+		CHECK_HASH_EMPTY(mref_a);
 		CHECK_HEAD_EMPTY(&mref_a->pos_head);
 #endif
 		_mref_get(mref); // must be paired with __trans_logger_ref_put()
@@ -1227,6 +1419,10 @@ struct writeback_info *make_writeback(struct trans_logger_brick *brick, loff_t p
 	/* Create sub_mrefs for read of old disk version (phase1)
 	 */
 	if (brick->log_reads) {
+		// like qq_wb_trace(), on behalf of the first collected request
+		struct trans_logger_mref_aspect *first_a = container_of(wb->w_collect_list.next, struct trans_logger_mref_aspect, collect_head);
+		long long trace_id = first_a->object->ref_trace_id;
+
 		while (len > 0) {
 			struct trans_logger_mref_aspect *sub_mref_a;
 			struct mref_object *sub_mref;
@@ -1245,6 +1441,7 @@ struct writeback_info *make_writeback(struct trans_logger_brick *brick, loff_t p
 			sub_mref->ref_may_write = READ;
 			sub_mref->ref_rw = READ;
 			sub_mref->ref_data = NULL;
+			sub_mref->ref_trace_id = mars_trace_child_id(trace_id);
 
 			sub_mref_a = trans_logger_mref_get_aspect(brick, sub_mref);
 			CHECK_PTR(sub_mref_a, err);
@@ -1288,12 +1485,14 @@ struct writeback_info *make_writeback(struct trans_logger_brick *brick, loff_t p
 		struct trans_logger_input *log_input;
 		void *data;
 		int this_len = len;
+		int probes = 0;
 		int diff;
 		int status;
 
 		atomic_inc(&brick->total_hash_find_count);
 
-		orig_mref_a = _hash_find(&wb->w_collect_list, pos, &this_len, true, false);
+		orig_mref_a = _hash_find(NULL, &wb->w_collect_list, pos, &this_len, false, &probes);
+		atomic64_add(probes, &brick->total_hash_probe_count);
 		if (unlikely(!orig_mref_a)) {
 			MARS_FAT("could not find data\n");
 			goto err;
@@ -1318,6 +1517,7 @@ struct writeback_info *make_writeback(struct trans_logger_brick *brick, loff_t p
 		sub_mref->ref_may_write = WRITE;
 		sub_mref->ref_rw = WRITE;
 		sub_mref->ref_data = data;
+		sub_mref->ref_trace_id = mars_trace_child_id(orig_mref->ref_trace_id);
 
 		sub_mref_a = trans_logger_mref_get_aspect(brick, sub_mref);
 		CHECK_PTR(sub_mref_a, err);
@@ -1572,6 +1772,9 @@ bool phase0_startio(struct trans_logger_mref_aspect *orig_mref_a)
 	CHECK_PTR(input, err);
 	logst = &input->logst;
 	logst->do_crc = trans_logger_do_crc;
+	logst->crc_type = trans_logger_crc_type;
+	logst->group_delay_us = trans_logger_group_delay_us;
+	logst->trace_id = orig_mref->ref_trace_id;
 
 	{
 		struct log_header l = {
@@ -1670,7 +1873,7 @@ bool prep_phase_startio(struct trans_logger_mref_aspect *mref_a)
 	// else WRITE
 #if 1
 	CHECK_HEAD_EMPTY(&mref_a->lh.lh_head);
-	CHECK_HEAD_EMPTY(&mref_a->hash_head);
+	CHECK_HASH_EMPTY(mref_a);
 	if (unlikely(mref->ref_flags & (MREF_READING | MREF_WRITING))) {
 		MARS_ERR("bad flags %d\n", mref->ref_flags);
 	}
@@ -1891,6 +2094,9 @@ bool _phase2_startio(struct trans_logger_mref_aspect *sub_mref_a)
 	CHECK_PTR(input, err);
 	logst = &input->logst;
 	logst->do_crc = trans_logger_do_crc;
+	logst->crc_type = trans_logger_crc_type;
+	logst->group_delay_us = trans_logger_group_delay_us;
+	logst->trace_id = sub_mref->ref_trace_id;
 
 	{
 		struct log_header l = {
@@ -2045,6 +2251,7 @@ int run_mref_queue(struct logger_queue *q, bool (*startio)(struct trans_logger_m
 	bool found = false;
 	bool ok;
 	int res = 0;
+	unsigned long long start_stamp = cpu_clock(raw_smp_processor_id());
 
 	do {
 		struct trans_logger_mref_aspect *mref_a;
@@ -2067,6 +2274,9 @@ int run_mref_queue(struct logger_queue *q, bool (*startio)(struct trans_logger_m
 
 done:
 	if (found) {
+		unsigned long long now = cpu_clock(raw_smp_processor_id());
+		if (likely(now > start_stamp))
+			atomic64_add(now - start_stamp, &q->q_busy_ns);
 		mars_limit(&global_writeback.limiter, (total_len - 1) / 1024 + 1);
 		wake_up_interruptible_all(&brick->worker_event);
 	}
@@ -2081,6 +2291,7 @@ int run_wb_queue(struct logger_queue *q, bool (*startio)(struct writeback_info *
 	bool found = false;
 	bool ok;
 	int res = 0;
+	unsigned long long start_stamp = cpu_clock(raw_smp_processor_id());
 
 	do {
 		struct writeback_info *wb;
@@ -2101,6 +2312,9 @@ int run_wb_queue(struct logger_queue *q, bool (*startio)(struct writeback_info *
 
 done:
 	if (found) {
+		unsigned long long now = cpu_clock(raw_smp_processor_id());
+		if (likely(now > start_stamp))
+			atomic64_add(now - start_stamp, &q->q_busy_ns);
 		mars_limit(&global_writeback.limiter, (total_len - 1) / 1024 + 1);
 		wake_up_interruptible_all(&brick->worker_event);
 	}
@@ -2224,6 +2438,7 @@ int _do_ranking(struct trans_logger_brick *brick, struct rank_data rkd[])
 	int i;
 	int floating_mode;
 	int mref_flying;
+	unsigned long eligible = 0;
 	bool delay_callers;
 
 	ranking_start(rkd, LOGGER_QUEUES);
@@ -2337,6 +2552,9 @@ int _do_ranking(struct trans_logger_brick *brick, struct rank_data rkd[])
 			}
 		}
 
+		// all queues reaching this point may be served by phase workers
+		eligible |= 1UL << i;
+
 		ranking_compute(&rkd[i], queue_ranks[floating_mode][i], queued);
 
 		flying = atomic_read(&brick->q_phase[i].q_flying);
@@ -2346,6 +2564,9 @@ int _do_ranking(struct trans_logger_brick *brick, struct rank_data rkd[])
 		ranking_compute(&rkd[i], fly_ranks[floating_mode][i], flying);
 	}
 
+	// the phase workers and the pool clear bits concurrently
+	xchg(&brick->phase_eligible, eligible);
+
 	// finalize it
 	ranking_stop(rkd, LOGGER_QUEUES);
 
@@ -2368,13 +2589,19 @@ void _init_input(struct trans_logger_input *input, loff_t start_pos)
 
 	init_logst(logst, (void*)input, start_pos);
 	logst->signal_event = &brick->worker_event;
+	logst->group_stats = &brick->log_group_stats;
 	logst->align_size = CONF_TRANS_ALIGN;
 	logst->chunk_size = CONF_TRANS_CHUNKSIZE;
 	logst->max_size = CONF_TRANS_MAX_MREF_SIZE;
 
 	
 	input->inf.inf_min_pos = start_pos;
-	input->inf.inf_max_pos = start_pos; // ATTENTION: this remains correct as far as our replay code _never_ kicks off any requests in parallel (which is current state of the "art", relying on BBU caching for performance). WHENEVER YOU CHANGE THIS some day, you MUST maintain the correct end_pos here!
+	/* Although replay dispatches requests in parallel, it never
+	 * advances inf_min_pos past requests still in flight, and it
+	 * drains all of them before terminating. So nothing beyond
+	 * start_pos is outstanding when logging starts here.
+	 */
+	input->inf.inf_max_pos = start_pos;
 	get_lamport(&input->inf.inf_max_pos_stamp);
 	memcpy(&input->inf.inf_min_pos_stamp, &input->inf.inf_max_pos_stamp, sizeof(input->inf.inf_min_pos_stamp));
 
@@ -2457,13 +2684,14 @@ int _nr_flying_inputs(struct trans_logger_brick *brick)
 }
 
 static
-void _flush_inputs(struct trans_logger_brick *brick)
+void _flush_inputs(struct trans_logger_brick *brick, bool force)
 {
 	int i;
 	for (i = TL_INPUT_LOG1; i <= TL_INPUT_LOG2; i++) {
 		struct trans_logger_input *input = brick->inputs[i];
 		struct log_status *logst = &input->logst;
-		if (input->is_operating && logst->count > 0) {
+		if (input->is_operating && logst->count > 0 &&
+		    (force || log_flush_due(logst))) {
 			atomic_inc(&brick->total_flush_count);
 			log_flush(logst);
 		}
@@ -2519,6 +2747,10 @@ void _exit_inputs(struct trans_logger_brick *brick, bool force)
  *  2 = see 1 && flush only when the user is waiting for an answer
  *  3 = see 1 && not 2 && flush only when there is no other activity (background mode)
  * Notice: 3 makes only sense for leftovers where the user is _not_ waiting for
+ *
+ * Except in mode 0, group-append may hold back the flush for at most
+ * trans_logger_group_delay_us, such that records from concurrent writers
+ * are coalesced into one log IO.
  */
 static inline
 void flush_inputs(struct trans_logger_brick *brick, int flush_mode)
@@ -2539,228 +2771,816 @@ void flush_inputs(struct trans_logger_brick *brick, int flush_mode)
 			atomic_read(&brick->q_phase[2].q_flying),
 			atomic_read(&brick->q_phase[3].q_flying)
 			);
-		_flush_inputs(brick);
+		_flush_inputs(brick, flush_mode < 1);
+	}
+}
+
+/* Follow changes of the home node at runtime.
+ */
+static inline
+void _check_thread_node(struct trans_logger_brick *brick)
+{
+	int node = brick->numa_node;
+
+	if (unlikely(node != brick->thread_node)) {
+		MARS_INF("moving logger thread to node %d\n", node);
+		brick->thread_node = node;
+		brick_thread_set_node(current, node);
 	}
 }
 
+/* Optional phase workers.
+ * The logger thread keeps the ranking and phase 0, which writes
+ * the transaction log in order. Phases 1 to 3 are served by one
+ * worker thread each, whenever the ranking marks their queue
+ * as eligible. Thus the ranking remains in charge of admission,
+ * but no longer serializes the phases onto a single CPU.
+ * With log_reads, phase 2 also appends to the logst of the
+ * log inputs, which has no locking of its own. Then phase 2
+ * remains in the logger thread, like phase 0.
+ */
+static inline
+unsigned long _phase_offload_mask(struct trans_logger_brick *brick)
+{
+	unsigned long mask = ((1UL << LOGGER_QUEUES) - 1) & ~1UL;
+
+	if (brick->log_reads)
+		mask &= ~(1UL << 2);
+	return mask;
+}
+
+static inline
+bool _phase_offloaded(struct trans_logger_brick *brick, int phase)
+{
+	return (brick->phase_eligible & _phase_offload_mask(brick) & (1UL << phase)) != 0;
+}
+
 static noinline
-void trans_logger_log(struct trans_logger_brick *brick)
+int _run_phase(struct trans_logger_brick *brick, int phase)
 {
-	struct rank_data rkd[LOGGER_QUEUES] = {};
-	long long old_jiffies = jiffies;
-	long long work_jiffies = jiffies;
-	int interleave = 0;
-	int nr_flying;
+	struct logger_queue *q = &brick->q_phase[phase];
+
+	switch (phase) {
+	case 1:
+		return run_mref_queue(q, phase1_startio, q->q_batchlen, true);
+	case 2:
+		return run_wb_queue(q, phase2_startio, q->q_batchlen);
+	case 3:
+		return run_wb_queue(q, phase3_startio, q->q_batchlen);
+	default:
+		;
+	}
+	return 0;
+}
 
-	brick->replay_code = 0; // indicates "running"
+static
+void _phase_round(struct trans_logger_brick *brick, int phase)
+{
+	struct logger_queue *q = &brick->q_phase[phase];
+	int nr;
 
-	_init_inputs(brick, true);
+	nr = _run_phase(brick, phase);
+	if (unlikely(nr <= 0 && atomic_read(&q->q_queued) > 0)) {
+		q->no_progress_count++;
+		banning_hit(&q->q_banning, 10000);
+	}
+	// let the logger round update the ranking
+	wake_up_interruptible_all(&brick->worker_event);
+}
 
-	mars_power_led_on((void*)brick, true);
+static noinline
+int trans_logger_phase_thread(void *data)
+{
+	struct logger_queue *q = data;
+	struct trans_logger_brick *brick = q->q_brick;
+	int phase = q - brick->q_phase;
 
-	while (!brick_thread_should_stop() || _congested(brick)) {
-		int winner;
-		int nr;
+	MARS_INF("phase %d worker has started.\n", phase);
 
+	while (!brick_thread_should_stop()) {
 		wait_event_interruptible_timeout(
-			brick->worker_event,
-			({
-				winner = _do_ranking(brick, rkd);
-				MARS_IO("winner = %d\n", winner);
-				if (winner < 0) { // no more work to do
-					int flush_mode = 2 - ((int)(jiffies - work_jiffies)) / (HZ * 2);
-					flush_inputs(brick, flush_mode);
-					interleave = 0;
-				} else { // reset the timer whenever something is to do
-					work_jiffies = jiffies;
-				}
-				winner >= 0;
-			}),
+			brick->phase_event[phase],
+			_phase_offloaded(brick, phase) || kthread_should_stop(),
 			HZ / 10);
 
-		atomic_inc(&brick->total_round_count);
+		if (!_phase_offloaded(brick, phase) ||
+		    !test_and_clear_bit(phase, &brick->phase_eligible))
+			continue;
 
-		if (brick->cease_logging) {
-			brick->stopped_logging = true;
-		} else if (brick->stopped_logging && !_congested(brick)) {
-			brick->stopped_logging = false;
-		}
+		_phase_round(brick, phase);
+	}
 
-		_init_inputs(brick, false);
+	MARS_INF("phase %d worker has stopped.\n", phase);
+	return 0;
+}
 
-		switch (winner) {
-		case 0:
-			interleave = 0;
-			nr = run_mref_queue(&brick->q_phase[0], prep_phase_startio, brick->q_phase[0].q_batchlen, true);
-			goto done;
-		case 1:
-			if (interleave >= trans_logger_max_interleave && trans_logger_max_interleave >= 0) {
-				interleave = 0;
-				flush_inputs(brick, 3);
-			}
-			nr = run_mref_queue(&brick->q_phase[1], phase1_startio, brick->q_phase[1].q_batchlen, true);
-			interleave += nr;
-			goto done;
-		case 2:
-			interleave = 0;
-			nr = run_wb_queue(&brick->q_phase[2], phase2_startio, brick->q_phase[2].q_batchlen);
-			goto done;
-		case 3:
-			if (interleave >= trans_logger_max_interleave && trans_logger_max_interleave >= 0) {
-				interleave = 0;
-				flush_inputs(brick, 3);
-			}
-			nr = run_wb_queue(&brick->q_phase[3], phase3_startio, brick->q_phase[3].q_batchlen);
-			interleave += nr;
-		done:
-			if (unlikely(nr <= 0)) {
-				/* This should not happen!
-				 * However, in error situations, the ranking
-				 * algorithm cannot foresee anything.
-				 */
-				brick->q_phase[winner].no_progress_count++;
-				banning_hit(&brick->q_phase[winner].q_banning, 10000);
-				flush_inputs(brick, 0);
-			}
-			ranking_select_done(rkd, winner, nr);
-			break;
+static
+void _kick_phase_workers(struct trans_logger_brick *brick)
+{
+	int i;
 
-		default:
-			;
-		}
+	if (brick->pool_attached) {
+		if (brick->phase_eligible & _phase_offload_mask(brick))
+			_pool_wakeup();
+		return;
+	}
+	for (i = 1; i < LOGGER_QUEUES; i++) {
+		if (_phase_offloaded(brick, i))
+			wake_up_interruptible(&brick->phase_event[i]);
+	}
+}
 
-		/* Update symlinks even during pauses.
-		 */
-		if (winner < 0 && ((long long)jiffies) - old_jiffies >= HZ) {
-			int i;
-			old_jiffies = jiffies;
-			for (i = TL_INPUT_LOG1; i <= TL_INPUT_LOG2; i++) {
-				struct trans_logger_input *input = brick->inputs[i];
-				down(&input->inf_mutex);
-				_inf_callback(input, false);
-				up(&input->inf_mutex);
-			}
-		}
+static
+void _stop_phase_workers(struct trans_logger_brick *brick)
+{
+	int i;
 
-		_exit_inputs(brick, false);
+	for (i = 1; i < LOGGER_QUEUES; i++) {
+		brick_thread_stop(brick->phase_thread[i]);
 	}
+}
 
-	for (;;) {
-		_exit_inputs(brick, true);
-		nr_flying = _nr_flying_inputs(brick);
-		if (nr_flying <= 0)
-			break;
-		MARS_INF("%d inputs are operating\n", nr_flying);
-		brick_msleep(1000);
+static
+bool _start_phase_workers(struct trans_logger_brick *brick)
+{
+	static int index = 0;
+	int i;
+
+	for (i = 1; i < LOGGER_QUEUES; i++) {
+		brick->phase_thread[i] = brick_thread_create(trans_logger_phase_thread, &brick->q_phase[i], "mars_phase%d_%d", i, index);
+		if (unlikely(!brick->phase_thread[i])) {
+			MARS_ERR("cannot create phase %d worker, falling back to a single thread\n", i);
+			_stop_phase_workers(brick);
+			return false;
+		}
+		brick_thread_set_node(brick->phase_thread[i], brick->numa_node);
 	}
+	index++;
+	return true;
 }
 
-////////////////////////////// log replay //////////////////////////////
+/* One round of the logger, split into selection and execution,
+ * such that it can be driven either by the per-brick logger thread
+ * or by the shared logger pool.
+ */
+static
+void _log_state_init(struct trans_logger_brick *brick)
+{
+	memset(brick->log_rkd, 0, sizeof(brick->log_rkd));
+	brick->log_old_jiffies = jiffies;
+	brick->log_work_jiffies = jiffies;
+	brick->log_interleave = 0;
+}
 
 static noinline
-void replay_endio(struct generic_callback *cb)
+int _log_select(struct trans_logger_brick *brick)
 {
-	struct trans_logger_mref_aspect *mref_a = cb->cb_private;
-	struct trans_logger_brick *brick;
-	unsigned long flags;
-
-	LAST_CALLBACK(cb);
-	CHECK_PTR(mref_a, err);
-	brick = mref_a->my_brick;
-	CHECK_PTR(brick, err);
+	int winner;
 
-	if (unlikely(cb->cb_error < 0)) {
-		MARS_ERR("IO error = %d\n", cb->cb_error);
-		goto done;
-	}
+	winner = _do_ranking(brick, brick->log_rkd);
+	if (brick->phase_workers) {
+		unsigned long offload = _phase_offload_mask(brick);
 
-	traced_lock(&brick->replay_lock, flags);
-	list_del_init(&mref_a->replay_head);
-	traced_unlock(&brick->replay_lock, flags);
+		_kick_phase_workers(brick);
+		// only phase 0 (and phase 2 with log_reads) remains for us
+		if (winner >= 0 && (offload & (1UL << winner))) {
+			unsigned long local = brick->phase_eligible & ~offload;
 
-	atomic_dec(&brick->replay_count);
- done:
-	wake_up_interruptible_all(&brick->worker_event);
-	return;
- err:
-	MARS_FAT("cannot handle replay IO\n");
+			winner = local ? __ffs(local) : -1;
+		}
+	}
+	MARS_IO("winner = %d\n", winner);
+	if (winner < 0) { // no more work to do
+		int flush_mode = 2 - ((int)(jiffies - brick->log_work_jiffies)) / (HZ * 2);
+		flush_inputs(brick, flush_mode);
+		brick->log_interleave = 0;
+	} else { // reset the timer whenever something is to do
+		brick->log_work_jiffies = jiffies;
+	}
+	return winner;
 }
 
 static noinline
-bool _has_conflict(struct trans_logger_brick *brick, struct trans_logger_mref_aspect *mref_a)
+void _log_step(struct trans_logger_brick *brick, int winner)
 {
-	struct mref_object *mref = mref_a->object;
+	int nr;
+
+	atomic_inc(&brick->total_round_count);
+
+	if (!brick->pool_attached)
+		_check_thread_node(brick);
+
+	if (brick->cease_logging) {
+		brick->stopped_logging = true;
+	} else if (brick->stopped_logging && !_congested(brick)) {
+		brick->stopped_logging = false;
+	}
+
+	_init_inputs(brick, false);
+
+	switch (winner) {
+	case 0:
+		brick->log_interleave = 0;
+		nr = run_mref_queue(&brick->q_phase[0], prep_phase_startio, brick->q_phase[0].q_batchlen, true);
+		goto done;
+	case 1:
+		if (brick->log_interleave >= trans_logger_max_interleave && trans_logger_max_interleave >= 0) {
+			brick->log_interleave = 0;
+			flush_inputs(brick, 3);
+		}
+		nr = run_mref_queue(&brick->q_phase[1], phase1_startio, brick->q_phase[1].q_batchlen, true);
+		brick->log_interleave += nr;
+		goto done;
+	case 2:
+		brick->log_interleave = 0;
+		nr = run_wb_queue(&brick->q_phase[2], phase2_startio, brick->q_phase[2].q_batchlen);
+		goto done;
+	case 3:
+		if (brick->log_interleave >= trans_logger_max_interleave && trans_logger_max_interleave >= 0) {
+			brick->log_interleave = 0;
+			flush_inputs(brick, 3);
+		}
+		nr = run_wb_queue(&brick->q_phase[3], phase3_startio, brick->q_phase[3].q_batchlen);
+		brick->log_interleave += nr;
+	done:
+		if (unlikely(nr <= 0)) {
+			/* This should not happen!
+			 * However, in error situations, the ranking
+			 * algorithm cannot foresee anything.
+			 */
+			brick->q_phase[winner].no_progress_count++;
+			banning_hit(&brick->q_phase[winner].q_banning, 10000);
+			flush_inputs(brick, 0);
+		}
+		ranking_select_done(brick->log_rkd, winner, nr);
+		break;
+
+	default:
+		;
+	}
+
+	/* Update symlinks even during pauses.
+	 */
+	if (winner < 0 && ((long long)jiffies) - brick->log_old_jiffies >= HZ) {
+		int i;
+		brick->log_old_jiffies = jiffies;
+		for (i = TL_INPUT_LOG1; i <= TL_INPUT_LOG2; i++) {
+			struct trans_logger_input *input = brick->inputs[i];
+			down(&input->inf_mutex);
+			_inf_callback(input, false);
+			up(&input->inf_mutex);
+		}
+	}
+
+	_exit_inputs(brick, false);
+}
+
+static noinline
+void trans_logger_log(struct trans_logger_brick *brick)
+{
+	int nr_flying;
+
+	brick->replay_code = 0; // indicates "running"
+
+	_init_inputs(brick, true);
+	_log_state_init(brick);
+
+	brick->phase_workers = trans_logger_phase_workers > 0 && _start_phase_workers(brick);
+
+	mars_power_led_on((void*)brick, true);
+
+	while (!brick_thread_should_stop() || _congested(brick)) {
+		int winner;
+
+		wait_event_interruptible_timeout(
+			brick->worker_event,
+			(winner = _log_select(brick)) >= 0,
+			HZ / 10);
+
+		_log_step(brick, winner);
+	}
+
+	if (brick->phase_workers) {
+		_stop_phase_workers(brick);
+		brick->phase_workers = false;
+	}
+
+	for (;;) {
+		_exit_inputs(brick, true);
+		nr_flying = _nr_flying_inputs(brick);
+		if (nr_flying <= 0)
+			break;
+		MARS_INF("%d inputs are operating\n", nr_flying);
+		brick_msleep(1000);
+	}
+}
+
+///////////////////////// shared logger pool /////////////////////////
+
+/* When trans_logger_pool_size > 0, bricks in logging mode do not get
+ * their own logger thread. Instead, a fixed pool of workers serves all
+ * attached bricks.
+ * Each brick offers LOGGER_QUEUES units of work. Unit 0 is the logger
+ * round (ranking, phase 0, flushing, logfile switchover) which never
+ * runs concurrently with itself. Units 1 to 3 are the other phases,
+ * offered whenever the ranking marks them as eligible, like with
+ * phase workers. With log_reads, phase 2 stays within unit 0 since
+ * it writes to the same logst as phase 0.
+ * Among all ready units, the one of the brick with the lowest virtual
+ * time wins. The virtual time advances by the consumed time, scaled
+ * by the share weight of the brick (fair share).
+ */
+
+static
+int _pool_wake_fn(wait_queue_t *wait, unsigned mode, int flags, void *key)
+{
+	struct trans_logger_brick *brick = container_of(wait, struct trans_logger_brick, pool_wait);
+
+	brick->pool_kicked = true;
+	_pool_wakeup();
+	return 0;
+}
+
+static
+bool _pool_unit_ready(struct trans_logger_brick *brick, int unit)
+{
+	long long tick;
+
+	if (test_bit(unit, &brick->pool_busy))
+		return false;
+	if (unit > 0)
+		return _phase_offloaded(brick, unit);
+	// work for the logger round is eligible as of the last round => continue immediately
+	if (brick->phase_eligible & ~_phase_offload_mask(brick))
+		return true;
+	if (brick->pool_kicked)
+		return true;
+	// periodic rounds, like the timeout of the logger thread
+	tick = (_congested(brick) || _nr_flying_inputs(brick) > 0) ? HZ / 10 : HZ;
+	return ((long long)jiffies) - brick->pool_last_control >= tick;
+}
+
+static
+struct trans_logger_brick *_pool_fetch(int *unit)
+{
+	struct trans_logger_brick *best = NULL;
 	struct list_head *tmp;
-	bool res = false;
 	unsigned long flags;
+	int best_unit = -1;
 
-	// NOTE: replacing this by rwlock_t will not gain anything, because there exists at most 1 reader at any time
+	traced_lock(&logger_pool.lock, flags);
+	for (tmp = logger_pool.anchor.next; tmp != &logger_pool.anchor; tmp = tmp->next) {
+		struct trans_logger_brick *brick = container_of(tmp, struct trans_logger_brick, pool_head);
+		int i;
 
-	traced_lock(&brick->replay_lock, flags);
+		if (best && brick->pool_vtime >= best->pool_vtime)
+			continue;
+		for (i = 0; i < LOGGER_QUEUES; i++) {
+			if (_pool_unit_ready(brick, i)) {
+				best = brick;
+				best_unit = i;
+				break;
+			}
+		}
+	}
+	if (best) {
+		set_bit(best_unit, &best->pool_busy);
+		if (best_unit > 0)
+			clear_bit(best_unit, &best->phase_eligible);
+		else
+			best->pool_kicked = false;
+		// bricks coming back from idle must not gain unlimited credit
+		if (best->pool_vtime < logger_pool.vclock)
+			best->pool_vtime = logger_pool.vclock;
+		else
+			logger_pool.vclock = best->pool_vtime;
+	}
+	traced_unlock(&logger_pool.lock, flags);
 
-	for (tmp = brick->replay_list.next; tmp != &brick->replay_list; tmp = tmp->next) {
-		struct trans_logger_mref_aspect *tmp_a;
-		struct mref_object *tmp_mref;
+	*unit = best_unit;
+	return best;
+}
 
-		tmp_a = container_of(tmp, struct trans_logger_mref_aspect, replay_head);
-		tmp_mref = tmp_a->object;
-		if (tmp_mref->ref_pos + tmp_mref->ref_len > mref->ref_pos && tmp_mref->ref_pos < mref->ref_pos + mref->ref_len) {
-			res = true;
-			break;
+static
+void _pool_put(struct trans_logger_brick *brick, int unit, unsigned long long start_stamp)
+{
+	unsigned long long now = cpu_clock(raw_smp_processor_id());
+	unsigned long long cost = now > start_stamp ? now - start_stamp : 0;
+	int weight = brick->pool_weight > 0 ? brick->pool_weight : TL_POOL_WEIGHT;
+	unsigned long flags;
+
+	atomic64_add(cost, &brick->pool_busy_ns);
+	atomic64_add(cost, &logger_pool.busy_ns);
+
+	traced_lock(&logger_pool.lock, flags);
+	brick->pool_vtime += cost * TL_POOL_WEIGHT / weight;
+	clear_bit(unit, &brick->pool_busy);
+	traced_unlock(&logger_pool.lock, flags);
+}
+
+/* Returns true when the brick has left the pool.
+ */
+static
+bool _pool_try_detach(struct trans_logger_brick *brick)
+{
+	unsigned long flags;
+	int nr_flying;
+
+	_exit_inputs(brick, true);
+	nr_flying = _nr_flying_inputs(brick);
+	if (nr_flying > 0) {
+		MARS_INF("%d inputs are operating\n", nr_flying);
+		return false; // retry at the next tick
+	}
+
+	traced_lock(&logger_pool.lock, flags);
+	if (brick->pool_busy != 1UL) { // other phases are still running
+		traced_unlock(&logger_pool.lock, flags);
+		return false;
+	}
+	list_del_init(&brick->pool_head);
+	brick->pool_attached = false;
+	traced_unlock(&logger_pool.lock, flags);
+
+	remove_wait_queue(&brick->worker_event, &brick->pool_wait);
+	brick->phase_workers = false;
+	MARS_INF("........... logger has left the pool.\n");
+	return true;
+}
+
+static
+bool _pool_run_control(struct trans_logger_brick *brick)
+{
+	int winner;
+
+	brick->pool_last_control = jiffies;
+	if (brick->pool_stopping && !_congested(brick))
+		return _pool_try_detach(brick);
+
+	winner = _log_select(brick);
+	_log_step(brick, winner);
+	return false;
+}
+
+static noinline
+int trans_logger_pool_thread(void *data)
+{
+	MARS_INF("logger pool worker has started.\n");
+
+	while (!brick_thread_should_stop()) {
+		struct trans_logger_brick *brick;
+		unsigned long long start_stamp;
+		bool detached = false;
+		int gen = atomic_read(&logger_pool.event_gen);
+		int unit;
+
+		brick = _pool_fetch(&unit);
+		if (!brick) {
+			wait_event_interruptible_timeout(
+				logger_pool.event,
+				atomic_read(&logger_pool.event_gen) != gen || kthread_should_stop(),
+				HZ / 10);
+			continue;
+		}
+
+		start_stamp = cpu_clock(raw_smp_processor_id());
+		if (unit > 0)
+			_phase_round(brick, unit);
+		else
+			detached = _pool_run_control(brick);
+		_pool_put(brick, unit, start_stamp);
+
+		if (detached) {
+			mars_power_led_on((void*)brick, false);
+			mars_power_led_off((void*)brick, true);
+		}
+	}
+
+	MARS_INF("logger pool worker has stopped.\n");
+	return 0;
+}
+
+static
+int _pool_start(void)
+{
+	int status = 0;
+
+	mutex_lock(&logger_pool.start_mutex);
+	if (!logger_pool.nr_threads) {
+		int nr = trans_logger_pool_size;
+		int i;
+
+		if (nr > TL_POOL_MAX)
+			nr = TL_POOL_MAX;
+		for (i = 0; i < nr; i++) {
+			struct task_struct *thread;
+
+			thread = brick_thread_create(trans_logger_pool_thread, NULL, "mars_lpool%d", i);
+			if (unlikely(!thread)) {
+				MARS_ERR("cannot create logger pool thread %d\n", i);
+				status = -ENOENT;
+				break;
+			}
+			logger_pool.thread[logger_pool.nr_threads++] = thread;
 		}
 	}
+	if (logger_pool.nr_threads > 0)
+		status = 0;
+	mutex_unlock(&logger_pool.start_mutex);
+	return status;
+}
+
+static
+void _pool_stop(void)
+{
+	mutex_lock(&logger_pool.start_mutex);
+	while (logger_pool.nr_threads > 0) {
+		brick_thread_stop(logger_pool.thread[--logger_pool.nr_threads]);
+	}
+	mutex_unlock(&logger_pool.start_mutex);
+}
+
+static noinline
+int _pool_attach(struct trans_logger_brick *brick)
+{
+	unsigned long flags;
+	int status;
+
+	status = _pool_start();
+	if (unlikely(status < 0))
+		return status;
+
+	brick->replay_code = 0; // indicates "running"
+
+	_init_inputs(brick, true);
+	_log_state_init(brick);
+
+	brick->phase_workers = true; // phases 1 to 3 are also served by the pool
+	brick->pool_busy = 0;
+	brick->pool_stopping = false;
+	brick->pool_kicked = true;
+	brick->pool_last_control = jiffies;
+	init_waitqueue_func_entry(&brick->pool_wait, _pool_wake_fn);
+	add_wait_queue(&brick->worker_event, &brick->pool_wait);
+
+	mars_power_led_on((void*)brick, true);
+	MARS_INF("........... logger has joined the pool.\n");
+
+	traced_lock(&logger_pool.lock, flags);
+	brick->pool_vtime = logger_pool.vclock;
+	list_add_tail(&brick->pool_head, &logger_pool.anchor);
+	brick->pool_attached = true;
+	traced_unlock(&logger_pool.lock, flags);
+
+	_pool_wakeup();
+	return 0;
+}
+
+////////////////////////////// log replay //////////////////////////////
+
+/* Replay dispatching.
+ *
+ * All outstanding replay requests (whether flying or deferred) are kept
+ * in a tree sorted by position. A request may be started only when no
+ * _older_ outstanding request overlaps it. Conflicting requests are
+ * deferred instead of stalling the log reader, so non-overlapping
+ * records are kept in flight up to trans_logger_replay_depth.
+ */
+
+static inline
+struct trans_logger_input *_replay_input(struct trans_logger_brick *brick)
+{
+	struct trans_logger_input *input = brick->inputs[TL_INPUT_WRITEBACK];
+
+	if (!input->connect) {
+		input = brick->inputs[TL_INPUT_READ];
+	}
+	return input;
+}
+
+static noinline
+void replay_endio(struct generic_callback *cb)
+{
+	struct trans_logger_mref_aspect *mref_a = cb->cb_private;
+	struct trans_logger_brick *brick;
+	unsigned long flags;
+
+	LAST_CALLBACK(cb);
+	CHECK_PTR(mref_a, err);
+	brick = mref_a->my_brick;
+	CHECK_PTR(brick, err);
+
+	if (unlikely(cb->cb_error < 0)) {
+		MARS_ERR("IO error = %d\n", cb->cb_error);
+	}
 
+	traced_lock(&brick->replay_lock, flags);
+	rb_erase(&mref_a->replay_node, &brick->replay_root);
+	RB_CLEAR_NODE(&mref_a->replay_node);
+	if (RB_EMPTY_ROOT(&brick->replay_root))
+		brick->replay_max_len = 0;
 	traced_unlock(&brick->replay_lock, flags);
-	return res;
+
+	atomic_dec(&brick->replay_flying);
+	atomic_dec(&brick->replay_count);
+	wake_up_interruptible_all(&brick->worker_event);
+	return;
+ err:
+	MARS_FAT("cannot handle replay IO\n");
+}
+
+/* Check whether any older outstanding request overlaps mref_a.
+ * Must be called with replay_lock held.
+ */
+static
+bool _has_conflict(struct trans_logger_brick *brick, struct trans_logger_mref_aspect *mref_a)
+{
+	struct mref_object *mref = mref_a->object;
+	struct rb_node *node = brick->replay_root.rb_node;
+	struct rb_node *first = NULL;
+	loff_t min_pos = mref->ref_pos - brick->replay_max_len;
+
+	while (node) {
+		struct trans_logger_mref_aspect *test_a;
+		test_a = rb_entry(node, struct trans_logger_mref_aspect, replay_node);
+		if (test_a->object->ref_pos > min_pos) {
+			first = node;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	for (node = first; node; node = rb_next(node)) {
+		struct trans_logger_mref_aspect *test_a;
+		struct mref_object *test;
+
+		test_a = rb_entry(node, struct trans_logger_mref_aspect, replay_node);
+		test = test_a->object;
+		if (test->ref_pos >= mref->ref_pos + mref->ref_len)
+			break;
+		if (test_a->replay_seq < mref_a->replay_seq &&
+		    test->ref_pos + test->ref_len > mref->ref_pos)
+			return true;
+	}
+	return false;
 }
 
+/* Enter a new request into the tree.
+ * Returns true when it must be deferred.
+ */
 static noinline
-void wait_replay(struct trans_logger_brick *brick, struct trans_logger_mref_aspect *mref_a)
+bool replay_insert(struct trans_logger_brick *brick, struct trans_logger_mref_aspect *mref_a)
 {
-	const int max = 512; // limit parallelism somewhat
-	int conflicts = 0;
-	bool ok = false;
+	struct mref_object *mref = mref_a->object;
+	struct rb_node **link;
+	struct rb_node *parent = NULL;
 	unsigned long flags;
+	bool conflict;
 
-	wait_event_interruptible_timeout(brick->worker_event,
-					 atomic_read(&brick->replay_count) < max
-					 && (_has_conflict(brick, mref_a) ? conflicts++ : (ok = true), ok),
-					 60 * HZ);
+	traced_lock(&brick->replay_lock, flags);
 
+	link = &brick->replay_root.rb_node;
+	while (*link) {
+		struct trans_logger_mref_aspect *test_a;
+		parent = *link;
+		test_a = rb_entry(parent, struct trans_logger_mref_aspect, replay_node);
+		if (mref->ref_pos < test_a->object->ref_pos) {
+			link = &parent->rb_left;
+		} else {
+			link = &parent->rb_right;
+		}
+	}
+	mref_a->replay_seq = ++brick->replay_seq;
+	if (mref->ref_len > brick->replay_max_len)
+		brick->replay_max_len = mref->ref_len;
+	rb_link_node(&mref_a->replay_node, parent, link);
+	rb_insert_color(&mref_a->replay_node, &brick->replay_root);
+
+	conflict = _has_conflict(brick, mref_a);
+	if (conflict) {
+		list_add_tail(&mref_a->replay_head, &brick->replay_defer_list);
+		atomic_inc(&brick->replay_deferred);
+	} else {
+		atomic_inc(&brick->replay_flying);
+	}
 	atomic_inc(&brick->replay_count);
+
+	traced_unlock(&brick->replay_lock, flags);
+
 	atomic_inc(&brick->total_replay_count);
-	if (conflicts)
+	if (conflict)
 		atomic_inc(&brick->total_replay_conflict_count);
+	return conflict;
+}
+
+static
+void replay_start(struct trans_logger_brick *brick, struct trans_logger_mref_aspect *mref_a)
+{
+	struct trans_logger_input *input = _replay_input(brick);
+	struct mref_object *mref = mref_a->object;
+
+	mars_trace(mref, "replay_io");
+
+	GENERIC_INPUT_CALL(input, mref_io, mref);
+	GENERIC_INPUT_CALL(input, mref_put, mref);
+}
+
+/* Start all deferred requests whose conflicts have vanished meanwhile.
+ * Deferred requests are kept in replay order, such that overlapping
+ * requests are started in the same order as they appear in the log.
+ */
+static noinline
+int replay_dispatch(struct trans_logger_brick *brick)
+{
+	LIST_HEAD(ready_list);
+	struct list_head *tmp;
+	struct list_head *next;
+	unsigned long flags;
+	int count = 0;
+
+	if (atomic_read(&brick->replay_deferred) <= 0)
+		return 0;
 
 	traced_lock(&brick->replay_lock, flags);
-	list_add(&mref_a->replay_head, &brick->replay_list);
+	for (tmp = brick->replay_defer_list.next; tmp != &brick->replay_defer_list; tmp = next) {
+		struct trans_logger_mref_aspect *mref_a;
+
+		next = tmp->next;
+		mref_a = container_of(tmp, struct trans_logger_mref_aspect, replay_head);
+		if (_has_conflict(brick, mref_a))
+			continue;
+		list_move_tail(tmp, &ready_list);
+		atomic_dec(&brick->replay_deferred);
+		atomic_inc(&brick->replay_flying);
+	}
 	traced_unlock(&brick->replay_lock, flags);
+
+	while ((tmp = ready_list.next) != &ready_list) {
+		struct trans_logger_mref_aspect *mref_a;
+
+		list_del_init(tmp);
+		mref_a = container_of(tmp, struct trans_logger_mref_aspect, replay_head);
+		replay_start(brick, mref_a);
+		count++;
+	}
+	return count;
+}
+
+/* Wait until the number of outstanding requests drops below max,
+ * or until timeout has been reached.
+ * The oldest outstanding request can never be deferred, so progress
+ * is guaranteed as long as the IO completes.
+ */
+static noinline
+void wait_replay(struct trans_logger_brick *brick, int max, long long timeout)
+{
+	long long start = jiffies;
+
+	for (;;) {
+		int flying;
+
+		replay_dispatch(brick);
+		if (atomic_read(&brick->replay_count) < max)
+			break;
+		if (((long long)jiffies) - start >= timeout) {
+			MARS_WRN("replay IO is hanging, %d requests outstanding\n", atomic_read(&brick->replay_count));
+			break;
+		}
+		flying = atomic_read(&brick->replay_flying);
+		wait_event_interruptible_timeout(brick->worker_event,
+						 atomic_read(&brick->replay_flying) < flying ||
+						 atomic_read(&brick->replay_count) < max,
+						 HZ / 10);
+	}
 }
 
 static noinline
 int replay_data(struct trans_logger_brick *brick, loff_t pos, void *buf, int len)
 {
-	struct trans_logger_input *input = brick->inputs[TL_INPUT_WRITEBACK];
+	struct trans_logger_input *input = _replay_input(brick);
+	int depth = trans_logger_replay_depth;
 	int status;
 
 	MARS_IO("got data, pos = %lld, len = %d\n", pos, len);
 
-	if (!input->connect) {
-		input = brick->inputs[TL_INPUT_READ];
-	}
+	if (depth < 1)
+		depth = 1;
+
+	atomic_inc(&brick->total_replay_record_count);
+	atomic64_add(len, &brick->total_replay_bytes);
 
-	/* TODO for better efficiency:
-	 * Instead of starting IO here, just put the data into the hashes
-	 * and queues such that ordinary IO will be corrected.
-	 * Writeback will be lazy then.
-	 * The switch infrastructure must be changed before this
-	 * becomes possible.
+	/* Replay of a single record. The IO is started asynchronously;
+	 * see replay_data_lazy() for the lazy variant.
 	 */
 #ifdef REPLAY_DATA
 	while (len > 0) {
 		struct mref_object *mref;
 		struct trans_logger_mref_aspect *mref_a;
 		
+		// limit parallelism somewhat
+		wait_replay(brick, depth, 60 * HZ);
+
 		status = -ENOMEM;
 		mref = trans_logger_alloc_mref(brick);
 		if (unlikely(!mref)) {
@@ -2795,28 +3615,20 @@ int replay_data(struct trans_logger_brick *brick, loff_t pos, void *buf, int len
 		
 		mars_trace(mref, "replay_start");
 
-		wait_replay(brick, mref_a);
-
-		mars_trace(mref, "replay_io");
-
 		memcpy(mref->ref_data, buf, mref->ref_len);
 
 		SETUP_CALLBACK(mref, replay_endio, mref_a);
 		mref_a->my_brick = brick;
 
-		GENERIC_INPUT_CALL(input, mref_io, mref);
-
-		if (unlikely(mref->ref_len <= 0)) {
-			status = -EINVAL;
-			MARS_ERR("bad ref len = %d (requested = %d)\n", mref->ref_len, len);
-			goto done;
-		}
-
 		pos += mref->ref_len;
 		buf += mref->ref_len;
 		len -= mref->ref_len;
 
-		GENERIC_INPUT_CALL(input, mref_put, mref);
+		/* Deferred requests are started later by replay_dispatch().
+		 * The mref must not be touched anymore after this point.
+		 */
+		if (!replay_insert(brick, mref_a))
+			replay_start(brick, mref_a);
 	}
 #endif
 	status = 0;
@@ -2824,6 +3636,154 @@ int replay_data(struct trans_logger_brick *brick, loff_t pos, void *buf, int len
 	return status;
 }
 
+/* Lazy replay: instead of starting IO for each log record, put the
+ * data into the hashes and queues as if it had been written by an
+ * ordinary write request. Writeback is then done by phase 1 / phase 3,
+ * which collect overlapping records into a single writeback.
+ * Thus repeated overwrites of the same blocks are written only once.
+ */
+static inline
+bool replay_lazy_possible(struct trans_logger_brick *brick, loff_t pos, int len)
+{
+	loff_t base_offset = pos & (loff_t)(REGION_SIZE - 1);
+
+	// the hash requires that REGION_SIZE boundaries are obeyed
+	return brick->lazy_replay &&
+		len > 0 &&
+		len <= CONF_TRANS_MAX_MREF_SIZE &&
+		len <= REGION_SIZE - base_offset;
+}
+
+static noinline
+int replay_data_lazy(struct trans_logger_brick *brick, struct trans_logger_input *input, struct log_header *lh, void *buf, int len, loff_t log_pos)
+{
+	struct mref_object *mref;
+	struct trans_logger_mref_aspect *mref_a;
+	void *data;
+
+	MARS_IO("got data, pos = %lld, len = %d\n", lh->l_pos, len);
+
+	mref = trans_logger_alloc_mref(brick);
+	if (unlikely(!mref)) {
+		MARS_ERR("no memory\n");
+		return -ENOMEM;
+	}
+	mref_a = trans_logger_mref_get_aspect(brick, mref);
+	CHECK_PTR(mref_a, err);
+	CHECK_ASPECT(mref_a, mref, err);
+
+	data = _shadow_alloc(brick, lh->l_pos, (mref_a->alloc_len = len));
+	if (unlikely(!data)) {
+		MARS_ERR("no memory\n");
+		goto err;
+	}
+	memcpy(data, buf, len);
+
+	mref->ref_pos = lh->l_pos;
+	mref->ref_len = len;
+	mref->ref_data = data;
+	mref->ref_may_write = WRITE;
+	mref->ref_rw = WRITE;
+	mref->ref_flags = MREF_UPTODATE;
+
+	mref_a->shadow_data = data;
+	mref_a->do_dealloc = true;
+	mref_a->do_buffered = true;
+	mref_a->shadow_ref = mref_a; // cyclic self-reference => indicates master shadow
+	mref_a->my_brick = brick;
+	mref_a->log_input = input;
+	atomic_inc(&input->log_ref_count);
+	mref_a->stamp = lh->l_stamp;
+	mref_a->log_pos = log_pos;
+	// the data is already persistent in the logfile
+	mref_a->is_dirty = true;
+	mref_a->is_stable = true;
+	mref_a->is_persistent = true;
+	mref_a->is_completed = true;
+
+	atomic64_add(len, &brick->shadow_mem_used);
+	atomic_inc(&brick->mshadow_count);
+	atomic_inc(&brick->total_mshadow_count);
+	atomic_inc(&global_mshadow_count);
+	atomic64_add(len, &global_mshadow_used);
+	atomic_inc(&brick->total_replay_lazy_count);
+	atomic_inc(&brick->total_replay_record_count);
+	atomic64_add(len, &brick->total_replay_bytes);
+
+	atomic_inc(&brick->inner_balance_count);
+	_mref_get_first(mref); // must be paired with __trans_logger_ref_put() in free_writeback()
+
+	hash_insert(brick, mref_a);
+
+	down(&input->inf_mutex);
+	list_add_tail(&mref_a->pos_head, &input->pos_list);
+	atomic_inc(&input->pos_count);
+	up(&input->inf_mutex);
+
+	qq_mref_insert(&brick->q_phase[1], mref_a);
+	return 0;
+
+err:
+	trans_logger_free_mref(mref);
+	return -ENOMEM;
+}
+
+static
+int _replay_mem_used(struct trans_logger_brick *brick, int limit_kb)
+{
+	int used_kb = atomic64_read(&brick->shadow_mem_used) / 1024;
+
+	if (brick_global_memlimit >= 1024) {
+		int global_kb = atomic64_read(&global_mshadow_used) / 1024;
+		// scale to the local limit
+		if (global_kb * 2 >= brick_global_memlimit && used_kb < limit_kb)
+			used_kb = limit_kb;
+	}
+	return used_kb;
+}
+
+/* Start writeback of lazily replayed data when the memory limit is
+ * reached, and throttle the replay when writeback cannot keep up.
+ * When drain is set, wait until everything has been written back.
+ */
+static noinline
+void replay_writeback(struct trans_logger_brick *brick, bool drain)
+{
+	int limit_kb = trans_logger_lazy_replay_kb;
+
+	if (!brick->lazy_replay)
+		return;
+	if (limit_kb < 1)
+		limit_kb = 1;
+
+	for (;;) {
+		int used_kb = _replay_mem_used(brick, limit_kb);
+		int nr;
+
+		if (drain) {
+			if (!_congested(brick))
+				break;
+		} else if (used_kb < limit_kb) {
+			break;
+		}
+
+		nr = run_mref_queue(&brick->q_phase[1], phase1_startio, brick->q_phase[1].q_batchlen, true);
+		nr += run_wb_queue(&brick->q_phase[3], phase3_startio, brick->q_phase[3].q_batchlen);
+
+		// soft limit: only some progress per replayed record
+		if (!drain && used_kb < limit_kb * 2 && nr > 0)
+			break;
+
+		if (nr <= 0) {
+			wait_event_interruptible_timeout(brick->worker_event,
+							 atomic_read(&brick->q_phase[1].q_queued) > 0 ||
+							 atomic_read(&brick->q_phase[3].q_queued) > 0 ||
+							 _replay_mem_used(brick, limit_kb) < limit_kb,
+							 HZ / 10);
+		}
+	}
+}
+
 static noinline
 void trans_logger_replay(struct trans_logger_brick *brick)
 {
@@ -2838,11 +3798,15 @@ void trans_logger_replay(struct trans_logger_brick *brick)
 	int status = 0;
 
 	brick->replay_code = 0; // indicates "running"
+	brick->lazy_replay = trans_logger_lazy_replay_kb > 0 && !brick->log_reads;
 
 	start_pos = brick->replay_start_pos;
 	brick->replay_current_pos = start_pos;
+	brick->replay_start_jiffies = jiffies;
 
 	_init_input(input, start_pos);
+	// read ahead larger chunks of the logfile
+	input->logst.chunk_size = CONF_TRANS_REPLAY_CHUNKSIZE;
 
 	input->inf.inf_min_pos = start_pos;
 	input->inf.inf_max_pos = brick->replay_end_pos;
@@ -2850,7 +3814,7 @@ void trans_logger_replay(struct trans_logger_brick *brick)
 	input->inf.inf_is_replaying = true;
 	input->inf.inf_is_logging = false;
 
-	MARS_INF("starting replay from %lld to %lld\n", start_pos, brick->replay_end_pos);
+	MARS_INF("starting %s replay from %lld to %lld\n", brick->lazy_replay ? "lazy" : "synchronous", start_pos, brick->replay_end_pos);
 	
 	mars_power_led_on((void*)brick, true);
 
@@ -2858,6 +3822,8 @@ void trans_logger_replay(struct trans_logger_brick *brick)
 		void *buf = NULL;
 		int len = 0;
 
+		_check_thread_node(brick);
+
 		if (brick_thread_should_stop() ||
 		   (!brick->continuous_replay_mode && finished_pos >= brick->replay_end_pos)) {
 			status = 0; // treat as EOF
@@ -2917,7 +3883,15 @@ void trans_logger_replay(struct trans_logger_brick *brick)
 		} else if (likely(buf && len)) {
 			if (brick->replay_limiter)
 				mars_limit_sleep(brick->replay_limiter, (len - 1) / 1024 + 1);
-			status = replay_data(brick, lh.l_pos, buf, len);
+			if (replay_lazy_possible(brick, lh.l_pos, len)) {
+				wait_replay(brick, 1, 60 * HZ);
+				status = replay_data_lazy(brick, input, &lh, buf, len, new_finished_pos);
+				replay_writeback(brick, false);
+			} else {
+				// no overtaking of any lazy data
+				replay_writeback(brick, true);
+				status = replay_data(brick, lh.l_pos, buf, len);
+			}
 			MARS_RPL("replay %lld %lld (pos=%lld status=%d)\n", finished_pos, new_finished_pos, lh.l_pos, status);
 			if (unlikely(status < 0)) {
 				brick->replay_code = status;
@@ -2929,25 +3903,49 @@ void trans_logger_replay(struct trans_logger_brick *brick)
 		}
 
 		// do this _after_ any opportunities for errors...
-		if ((atomic_read(&brick->replay_count) <= 0 ||
+		if (brick->lazy_replay) {
+			/* pos_complete() advances inf_min_pos as long as
+			 * lazy writeback is pending.
+			 */
+			if (atomic_read(&input->pos_count) <= 0 &&
+			    ((long long)jiffies) - old_jiffies >= HZ * 3 &&
+			    finished_pos >= 0) {
+				down(&input->inf_mutex);
+				if (atomic_read(&input->pos_count) <= 0 &&
+				    finished_pos > input->inf.inf_min_pos) {
+					input->inf.inf_min_pos = finished_pos;
+					get_lamport(&input->inf.inf_min_pos_stamp);
+				}
+				old_jiffies = jiffies;
+				_inf_callback(input, false);
+				up(&input->inf_mutex);
+			}
+		} else if ((atomic_read(&brick->replay_count) <= 0 ||
 		     ((long long)jiffies) - old_jiffies >= HZ * 3) &&
 		    finished_pos >= 0) {
 			// for safety, wait until the IO queue has drained.
-			wait_event_interruptible_timeout(brick->worker_event, atomic_read(&brick->replay_count) <= 0, 1 * HZ);
+			wait_replay(brick, 1, 1 * HZ);
 
-			down(&input->inf_mutex);
-			input->inf.inf_min_pos = finished_pos;
-			get_lamport(&input->inf.inf_min_pos_stamp);
-			old_jiffies = jiffies;
-			_inf_callback(input, false);
-			up(&input->inf_mutex);
+			// parallel requests may still be flying after the timeout
+			if (atomic_read(&brick->replay_count) <= 0) {
+				down(&input->inf_mutex);
+				input->inf.inf_min_pos = finished_pos;
+				get_lamport(&input->inf.inf_min_pos_stamp);
+				old_jiffies = jiffies;
+				_inf_callback(input, false);
+				up(&input->inf_mutex);
+			}
 		}
 		_exit_inputs(brick, false);
 	}
 
 	MARS_INF("waiting for finish...\n");
 
-	wait_event_interruptible_timeout(brick->worker_event, atomic_read(&brick->replay_count) <= 0, 60 * HZ);
+	replay_writeback(brick, true);
+
+	// never report a position as finished while IO is outstanding
+	while (atomic_read(&brick->replay_count) > 0)
+		wait_replay(brick, 1, 60 * HZ);
 
 	if (unlikely(finished_pos > brick->replay_end_pos)) {
 		MARS_ERR("finished_pos too large: %lld + %d = %lld > %lld\n", input->logst.log_pos, input->logst.offset, finished_pos, brick->replay_end_pos);
@@ -3025,9 +4023,14 @@ int trans_logger_switch(struct trans_logger_brick *brick)
 	struct trans_logger_output *output = brick->outputs[0];
 
 	if (brick->power.button) {
-		if (!brick->thread && brick->power.led_off) {
+		if (!brick->thread && !brick->pool_attached && brick->power.led_off) {
 			mars_power_led_off((void*)brick, false);
 
+			if (!brick->replay_mode && trans_logger_pool_size > 0 &&
+			    _pool_attach(brick) >= 0)
+				return 0;
+
+			brick->thread_node = -1;
 			brick->thread = brick_thread_create(trans_logger_thread, output, "mars_logger%d", index++);
 			if (unlikely(!brick->thread)) {
 				MARS_ERR("cannot create logger thread\n");
@@ -3036,6 +4039,11 @@ int trans_logger_switch(struct trans_logger_brick *brick)
 		}
 	} else {
 		mars_power_led_on((void*)brick, false);
+		if (brick->pool_attached && !brick->pool_stopping) {
+			MARS_INF("leaving the logger pool...\n");
+			brick->pool_stopping = true;
+			wake_up_interruptible_all(&brick->worker_event);
+		}
 		if (brick->thread) {
 			MARS_INF("stopping thread...\n");
 			brick_thread_stop(brick->thread);
@@ -3047,16 +4055,56 @@ int trans_logger_switch(struct trans_logger_brick *brick)
 
 //////////////// informational / statistics ///////////////
 
+static
+long long _hash_probe_avg(struct trans_logger_brick *brick)
+{
+	long long lookups = atomic_read(&brick->total_hash_find_count) + atomic_read(&brick->total_hash_extend_count);
+	if (lookups <= 0)
+		return 0;
+	return atomic64_read(&brick->total_hash_probe_count) / lookups;
+}
+
+static
+long long _crc_rate(int crc_type)
+{
+	long long time = atomic64_read(&log_crc_stats[crc_type].crc_time);
+	if (time <= 0)
+		return 0;
+	// bytes per ns => MB/s
+	return atomic64_read(&log_crc_stats[crc_type].crc_bytes) * 1000 / time;
+}
+
+static
+long long _log_group_avg(struct trans_logger_brick *brick, atomic64_t *val, long long scale)
+{
+	long long ios = atomic64_read(&brick->log_group_stats.grp_ios);
+	if (ios <= 0)
+		return 0;
+	return atomic64_read(val) * scale / ios;
+}
+
+static
+long long _replay_rate(struct trans_logger_brick *brick, long long amount)
+{
+	long long elapsed = ((long long)jiffies) - brick->replay_start_jiffies;
+	if (!brick->replay_mode || elapsed < HZ)
+		return 0;
+	return amount * HZ / elapsed;
+}
+
 static noinline
 char *trans_logger_statistics(struct trans_logger_brick *brick, int verbose)
 {
-	char *res = brick_string_alloc(1024);
+	char *res = brick_string_alloc(3072);
+	int pos;
+	int i;
 	if (!res)
 		return NULL;
 
-	snprintf(res, 1023,
+	snprintf(res, 3071,
 		 "mode replay=%d "
 		 "continuous=%d "
+		 "lazy=%d "
 		 "replay_code=%d "
 		 "log_reads=%d | "
 		 "cease_logging=%d "
@@ -3074,12 +4122,20 @@ char *trans_logger_statistics(struct trans_logger_brick *brick, int verbose)
 		 "total hash_insert=%d "
 		 "hash_find=%d "
 		 "hash_extend=%d "
+		 "hash_probes=%lld (avg %lld) "
 		 "replay=%d "
 		 "replay_conflict=%d  (%d%%) "
+		 "replay_lazy=%d "
+		 "replay_records=%d "
+		 "replay_rate=%lld KB/s %lld records/s "
+		 "crc_type=%d "
+		 "%s=%lld (%lld KB, %lld us, %lld MB/s) "
+		 "%s=%lld (%lld KB, %lld us, %lld MB/s) "
 		 "callbacks=%d "
 		 "reads=%d "
 		 "writes=%d "
 		 "flushes=%d (%d%%) "
+		 "log_ios=%lld (%lld.%02lld records/io, wait %lld us, group_delay %d us) "
 		 "wb_clusters=%d "
 		 "writebacks=%d (%d%%) "
 		 "shortcut=%d (%d%%) "
@@ -3095,7 +4151,7 @@ char *trans_logger_statistics(struct trans_logger_brick *brick, int verbose)
 		 "phase3=%d | "
 		 "current #mrefs = %d "
 		 "shadow_mem_used=%ld/%lld "
-		 "replay_count=%d "
+		 "replay_count=%d (flying=%d deferred=%d) "
 		 "mshadow=%d/%d "
 		 "sshadow=%d "
 		 "hash_count=%d "
@@ -3114,6 +4170,7 @@ char *trans_logger_statistics(struct trans_logger_brick *brick, int verbose)
 		 "phase3=%d+%d <%d/%d>\n",
 		 brick->replay_mode,
 		 brick->continuous_replay_mode,
+		 brick->lazy_replay,
 		 brick->replay_code,
 		 brick->log_reads,
 		 brick->cease_logging,
@@ -3131,14 +4188,36 @@ char *trans_logger_statistics(struct trans_logger_brick *brick, int verbose)
 		 atomic_read(&brick->total_hash_insert_count),
 		 atomic_read(&brick->total_hash_find_count),
 		 atomic_read(&brick->total_hash_extend_count),
+		 (long long)atomic64_read(&brick->total_hash_probe_count),
+		 _hash_probe_avg(brick),
 		 atomic_read(&brick->total_replay_count),
 		 atomic_read(&brick->total_replay_conflict_count),
 		 atomic_read(&brick->total_replay_count) ? atomic_read(&brick->total_replay_conflict_count) * 100 / atomic_read(&brick->total_replay_count) : 0,
+		 atomic_read(&brick->total_replay_lazy_count),
+		 atomic_read(&brick->total_replay_record_count),
+		 _replay_rate(brick, atomic64_read(&brick->total_replay_bytes) / 1024),
+		 _replay_rate(brick, atomic_read(&brick->total_replay_record_count)),
+		 trans_logger_crc_type,
+		 log_crc_name[LOG_CRC_MD5],
+		 (long long)atomic64_read(&log_crc_stats[LOG_CRC_MD5].crc_count),
+		 (long long)atomic64_read(&log_crc_stats[LOG_CRC_MD5].crc_bytes) / 1024,
+		 (long long)atomic64_read(&log_crc_stats[LOG_CRC_MD5].crc_time) / 1000,
+		 _crc_rate(LOG_CRC_MD5),
+		 log_crc_name[LOG_CRC_CRC32C],
+		 (long long)atomic64_read(&log_crc_stats[LOG_CRC_CRC32C].crc_count),
+		 (long long)atomic64_read(&log_crc_stats[LOG_CRC_CRC32C].crc_bytes) / 1024,
+		 (long long)atomic64_read(&log_crc_stats[LOG_CRC_CRC32C].crc_time) / 1000,
+		 _crc_rate(LOG_CRC_CRC32C),
 		 atomic_read(&brick->total_cb_count),
 		 atomic_read(&brick->total_read_count),
 		 atomic_read(&brick->total_write_count),
 		 atomic_read(&brick->total_flush_count),
 		 atomic_read(&brick->total_write_count) ? atomic_read(&brick->total_flush_count) * 100 / atomic_read(&brick->total_write_count) : 0,
+		 (long long)atomic64_read(&brick->log_group_stats.grp_ios),
+		 _log_group_avg(brick, &brick->log_group_stats.grp_records, 100) / 100,
+		 _log_group_avg(brick, &brick->log_group_stats.grp_records, 100) % 100,
+		 _log_group_avg(brick, &brick->log_group_stats.grp_wait, 1) / 1000,
+		 trans_logger_group_delay_us,
 		 atomic_read(&brick->total_writeback_cluster_count),
 		 atomic_read(&brick->total_writeback_count),
 		 atomic_read(&brick->total_writeback_cluster_count) ? atomic_read(&brick->total_writeback_count) * 100 / atomic_read(&brick->total_writeback_cluster_count) : 0,
@@ -3159,6 +4238,8 @@ char *trans_logger_statistics(struct trans_logger_brick *brick, int verbose)
 		 atomic64_read(&brick->shadow_mem_used) / 1024,
 		 brick_global_memlimit,
 		 atomic_read(&brick->replay_count),
+		 atomic_read(&brick->replay_flying),
+		 atomic_read(&brick->replay_deferred),
 		 atomic_read(&brick->mshadow_count),
 		 brick->shadow_mem_limit,
 		 atomic_read(&brick->sshadow_count),
@@ -3191,21 +4272,91 @@ char *trans_logger_statistics(struct trans_logger_brick *brick, int verbose)
 		 atomic_read(&brick->q_phase[3].q_flying),
 		 brick->q_phase[3].pushback_count,
 		 brick->q_phase[3].no_progress_count);
+
+	/* NUMA placement, with shadow memory per node in KB
+	 */
+	pos = strlen(res);
+	pos += snprintf(res + pos, 3071 - pos,
+			"numa_node=%d thread_node=%d shadow_mem_node_kb=",
+			brick->numa_node,
+			brick->thread_node);
+	for (i = 0; i < TL_MAX_NODES && i < nr_node_ids && pos < 3071; i++) {
+		pos += snprintf(res + pos, 3071 - pos,
+				"%s%lld",
+				i ? "/" : "",
+				(long long)atomic64_read(&brick->shadow_mem_node[i]) / 1024);
+	}
+	if (pos < 3071)
+		pos += snprintf(res + pos, 3071 - pos, "\n");
+
+	/* Per phase: busy time in ms and average queue latency in us
+	 */
+	if (pos < 3071)
+		pos += snprintf(res + pos, 3071 - pos,
+				"phase_workers=%d",
+				brick->phase_workers);
+	for (i = 0; i < LOGGER_QUEUES && pos < 3071; i++) {
+		struct logger_queue *q = &brick->q_phase[i];
+		int count = atomic_read(&q->q_wait_count);
+
+		pos += snprintf(res + pos, 3071 - pos,
+				" phase%d_busy=%lldms phase%d_wait=%lldus",
+				i,
+				(long long)atomic64_read(&q->q_busy_ns) / 1000000,
+				i,
+				count > 0 ? (long long)atomic64_read(&q->q_wait_ns) / count / 1000 : 0);
+	}
+	if (pos < 3071)
+		pos += snprintf(res + pos, 3071 - pos, "\n");
+
+	/* Shared logger pool: share of the consumed pool time in percent,
+	 * and the current queue depths.
+	 */
+	if (pos < 3071) {
+		long long pool_total = atomic64_read(&logger_pool.busy_ns);
+
+		snprintf(res + pos, 3071 - pos,
+			 "pool=%d weight=%d share=%lld%% queued=%d/%d/%d/%d\n",
+			 brick->pool_attached,
+			 brick->pool_weight,
+			 pool_total > 0 ? (long long)atomic64_read(&brick->pool_busy_ns) * 100 / pool_total : 0,
+			 atomic_read(&brick->q_phase[0].q_queued),
+			 atomic_read(&brick->q_phase[1].q_queued),
+			 atomic_read(&brick->q_phase[2].q_queued),
+			 atomic_read(&brick->q_phase[3].q_queued));
+	}
 	return res;
 }
 
 static noinline
 void trans_logger_reset_statistics(struct trans_logger_brick *brick)
 {
+	int i;
+
+	for (i = 0; i < LOGGER_QUEUES; i++) {
+		struct logger_queue *q = &brick->q_phase[i];
+
+		atomic64_set(&q->q_busy_ns, 0);
+		atomic64_set(&q->q_wait_ns, 0);
+		atomic_set(&q->q_wait_count, 0);
+	}
 	atomic_set(&brick->total_hash_insert_count, 0);
 	atomic_set(&brick->total_hash_find_count, 0);
 	atomic_set(&brick->total_hash_extend_count, 0);
+	atomic64_set(&brick->total_hash_probe_count, 0);
 	atomic_set(&brick->total_replay_count, 0);
 	atomic_set(&brick->total_replay_conflict_count, 0);
+	atomic_set(&brick->total_replay_lazy_count, 0);
+	atomic_set(&brick->total_replay_record_count, 0);
+	atomic64_set(&brick->total_replay_bytes, 0);
+	brick->replay_start_jiffies = jiffies;
 	atomic_set(&brick->total_cb_count, 0);
 	atomic_set(&brick->total_read_count, 0);
 	atomic_set(&brick->total_write_count, 0);
 	atomic_set(&brick->total_flush_count, 0);
+	atomic64_set(&brick->log_group_stats.grp_ios, 0);
+	atomic64_set(&brick->log_group_stats.grp_records, 0);
+	atomic64_set(&brick->log_group_stats.grp_wait, 0);
 	atomic_set(&brick->total_writeback_count, 0);
 	atomic_set(&brick->total_writeback_cluster_count, 0);
 	atomic_set(&brick->total_shortcut_count, 0);
@@ -3227,8 +4378,9 @@ int trans_logger_mref_aspect_init_fn(struct generic_aspect *_ini)
 	struct trans_logger_mref_aspect *ini = (void*)_ini;
 	ini->lh.lh_pos = &ini->object->ref_pos;
 	INIT_LIST_HEAD(&ini->lh.lh_head);
-	INIT_LIST_HEAD(&ini->hash_head);
+	RB_CLEAR_NODE(&ini->hash_node);
 	INIT_LIST_HEAD(&ini->pos_head);
+	RB_CLEAR_NODE(&ini->replay_node);
 	INIT_LIST_HEAD(&ini->replay_head);
 	INIT_LIST_HEAD(&ini->collect_head);
 	INIT_LIST_HEAD(&ini->sub_list);
@@ -3241,8 +4393,11 @@ void trans_logger_mref_aspect_exit_fn(struct generic_aspect *_ini)
 {
 	struct trans_logger_mref_aspect *ini = (void*)_ini;
 	CHECK_HEAD_EMPTY(&ini->lh.lh_head);
-	CHECK_HEAD_EMPTY(&ini->hash_head);
+	CHECK_HASH_EMPTY(ini);
 	CHECK_HEAD_EMPTY(&ini->pos_head);
+	if (BRICK_CHECKING && unlikely(!RB_EMPTY_NODE(&ini->replay_node))) {
+		MARS_ERR("mref %p is still in replay\n", ini->object);
+	}
 	CHECK_HEAD_EMPTY(&ini->replay_head);
 	CHECK_HEAD_EMPTY(&ini->collect_head);
 	CHECK_HEAD_EMPTY(&ini->sub_list);
@@ -3269,7 +4424,9 @@ void _free_pages(struct trans_logger_brick *brick)
 		}
 		for (j = 0; j < HASH_PER_PAGE; j++) {
 			struct trans_logger_hash_anchor *start = &sub_table[j];
-			CHECK_HEAD_EMPTY(&start->hash_anchor);
+			if (unlikely(!RB_EMPTY_ROOT(&start->hash_root))) {
+				MARS_ERR("hash anchor %d/%d is not empty\n", i, j);
+			}
 		}
 		brick_block_free(sub_table, PAGE_SIZE);
 	}
@@ -3281,6 +4438,11 @@ int trans_logger_brick_construct(struct trans_logger_brick *brick)
 {
 	int i;
 
+	brick->numa_node = -1;
+	brick->thread_node = -1;
+	brick->pool_weight = TL_POOL_WEIGHT;
+	INIT_LIST_HEAD(&brick->pool_head);
+
 	brick->hash_table = brick_block_alloc(0, PAGE_SIZE);
 	if (unlikely(!brick->hash_table)) {
 		MARS_ERR("cannot allocate hash directory table.\n");
@@ -3311,16 +4473,20 @@ int trans_logger_brick_construct(struct trans_logger_brick *brick)
 		for (j = 0; j < HASH_PER_PAGE; j++) {
 			struct trans_logger_hash_anchor *start = &sub_table[j];
 			init_rwsem(&start->hash_mutex);
-			INIT_LIST_HEAD(&start->hash_anchor);
+			start->hash_root = RB_ROOT;
 		}
 	}
 
 	atomic_set(&brick->hash_count, 0);
 	spin_lock_init(&brick->replay_lock);
-	INIT_LIST_HEAD(&brick->replay_list);
+	brick->replay_root = RB_ROOT;
+	INIT_LIST_HEAD(&brick->replay_defer_list);
 	INIT_LIST_HEAD(&brick->group_head);
 	init_waitqueue_head(&brick->worker_event);
 	init_waitqueue_head(&brick->caller_event);
+	for (i = 0; i < LOGGER_QUEUES; i++) {
+		init_waitqueue_head(&brick->phase_event[i]);
+	}
 	qq_init(&brick->q_phase[0], brick);
 	qq_init(&brick->q_phase[1], brick);
 	qq_init(&brick->q_phase[2], brick);
@@ -3348,7 +4514,10 @@ static noinline
 int trans_logger_brick_destruct(struct trans_logger_brick *brick)
 {
 	_free_pages(brick);
-	CHECK_HEAD_EMPTY(&brick->replay_list);
+	CHECK_HEAD_EMPTY(&brick->replay_defer_list);
+	if (unlikely(!RB_EMPTY_ROOT(&brick->replay_root))) {
+		MARS_ERR("replay requests are still outstanding\n");
+	}
 	remove_from_group(&global_writeback, brick);
 	return 0;
 }
@@ -3441,6 +4610,7 @@ int __init init_mars_trans_logger(void)
 void __exit exit_mars_trans_logger(void)
 {
 	MARS_INF("exit_trans_logger()\n");
+	_pool_stop();
 	trans_logger_unregister_brick_type();
 }
 
@@ -5,13 +5,18 @@
 #define REGION_SIZE_BITS      (PAGE_SHIFT + 4)
 #define REGION_SIZE           (1 << REGION_SIZE_BITS)
 #define LOGGER_QUEUES         4
+#define TL_MAX_NODES          8 // NUMA nodes shown separately in the statistics
+#define TL_POOL_MAX           32 // max threads of the shared logger pool
+#define TL_POOL_WEIGHT        100 // default share weight of a resource
 
 #include <linux/time.h>
+#include <linux/rbtree.h>
 
 #include "mars.h"
 #include "lib_log.h"
 #include "lib_pairing_heap.h"
 #include "lib_queue.h"
+#include "lib_rank.h"
 #include "lib_timing.h"
 
 ///////////////////////// global tuning ////////////////////////
@@ -22,10 +27,16 @@
  */
 extern int trans_logger_completion_semantics;
 extern int trans_logger_do_crc;
+extern int trans_logger_crc_type; // LOG_CRC_*
+extern int trans_logger_group_delay_us; // group-append latency budget, 0 = off
 extern int trans_logger_mem_usage; // in KB
 extern int trans_logger_max_interleave;
 extern int trans_logger_resume;
 extern int trans_logger_replay_timeout; // in s
+extern int trans_logger_lazy_replay_kb; // 0 = synchronous replay
+extern int trans_logger_replay_depth; // max outstanding replay requests
+extern int trans_logger_phase_workers; // 0 = all phases in the logger thread
+extern int trans_logger_pool_size; // 0 = one logger thread per brick
 extern atomic_t   global_mshadow_count;
 extern atomic64_t global_mshadow_used;
 
@@ -54,11 +65,16 @@ struct logger_queue {
 	struct banning q_banning;
 	int no_progress_count;
 	int pushback_count;
+	// statistics
+	atomic64_t q_busy_ns;
+	atomic64_t q_wait_ns;
+	atomic_t q_wait_count;
 };
 
 struct logger_head {
 	struct list_head lh_head;
 	loff_t *lh_pos;
+	unsigned long long lh_stamp; // time of queue insertion
 	struct pairing_heap_logger ph;
 };
 
@@ -104,9 +120,12 @@ struct trans_logger_mref_aspect {
 	struct trans_logger_input *my_input;
 	struct trans_logger_input *log_input;
 	struct logger_head lh;
-	struct list_head hash_head;
+	struct rb_node hash_node;
+	unsigned long long hash_seq; // insertion order within the hash anchor
 	//struct list_head q_head;
 	struct list_head pos_head;
+	struct rb_node replay_node;
+	unsigned long long replay_seq; // replay order
 	struct list_head replay_head;
 	struct list_head collect_head;
 	struct pairing_heap_logger ph;
@@ -145,6 +164,7 @@ struct trans_logger_brick {
 	int shadow_mem_limit; // max # master shadows
 	bool replay_mode;   // mode of operation
 	bool continuous_replay_mode;   // mode of operation
+	bool lazy_replay;   // replay via hash and writeback queues
 	bool log_reads;   // additionally log pre-images
 	bool cease_logging; // direct IO without logging (only in case of EMERGENCY)
 	bool debug_shortcut; // only for testing! never use in production!
@@ -152,6 +172,8 @@ struct trans_logger_brick {
 	loff_t replay_end_pos;   // end of replay
 	int new_input_nr;   // whereto we should switchover ASAP
 	int replay_tolerance; // how many bytes to ignore at truncated logfiles
+	int numa_node;      // home node for threads and shadow memory (-1 = none)
+	int pool_weight;    // share weight in the shared logger pool
 	// readonly from outside
 	loff_t replay_current_pos;   // end of replay
 	int log_input_nr;   // where we are currently logging to
@@ -163,13 +185,41 @@ struct trans_logger_brick {
 	struct list_head group_head;
 	loff_t old_margin;
 	spinlock_t replay_lock;
-	struct list_head replay_list;
+	struct rb_root replay_root;
+	unsigned long long replay_seq;
+	int replay_max_len;
+	struct list_head replay_defer_list;
+	long long replay_start_jiffies;
 	struct task_struct *thread;
+	int thread_node;
+	// phase workers (phases 1 to 3, only when enabled)
+	struct task_struct *phase_thread[LOGGER_QUEUES];
+	wait_queue_head_t phase_event[LOGGER_QUEUES];
+	unsigned long phase_eligible;
+	bool phase_workers;
+	// state of the logger rounds
+	struct rank_data log_rkd[LOGGER_QUEUES];
+	long long log_old_jiffies;
+	long long log_work_jiffies;
+	int log_interleave;
+	// shared logger pool
+	struct list_head pool_head;
+	wait_queue_t pool_wait;
+	unsigned long long pool_vtime;
+	long long pool_last_control;
+	unsigned long pool_busy;
+	bool pool_attached;
+	bool pool_stopping;
+	bool pool_kicked;
 	wait_queue_head_t worker_event;
 	wait_queue_head_t caller_event;
 	// statistics
 	atomic64_t shadow_mem_used;
+	atomic64_t shadow_mem_node[TL_MAX_NODES];
+	atomic64_t pool_busy_ns;
 	atomic_t replay_count;
+	atomic_t replay_flying;
+	atomic_t replay_deferred;
 	atomic_t any_fly_count;
 	atomic_t log_fly_count;
 	atomic_t hash_count;
@@ -182,12 +232,17 @@ struct trans_logger_brick {
 	atomic_t total_hash_insert_count;
 	atomic_t total_hash_find_count;
 	atomic_t total_hash_extend_count;
+	atomic64_t total_hash_probe_count;
 	atomic_t total_replay_count;
 	atomic_t total_replay_conflict_count;
+	atomic_t total_replay_lazy_count;
+	atomic_t total_replay_record_count;
+	atomic64_t total_replay_bytes;
 	atomic_t total_cb_count;
 	atomic_t total_read_count;
 	atomic_t total_write_count;
 	atomic_t total_flush_count;
+	struct log_group_stats log_group_stats;
 	atomic_t total_writeback_count;
 	atomic_t total_writeback_cluster_count;
 	atomic_t total_shortcut_count;
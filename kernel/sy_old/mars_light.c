@@ -46,6 +46,7 @@
 #include "../mars_bio.h"
 #include "../mars_sio.h"
 #include "../mars_aio.h"
+#include "../mars_rio.h"
 #include "../mars_trans_logger.h"
 #include "../mars_if.h"
 #include "mars_proc.h"
@@ -124,6 +125,14 @@ EXPORT_SYMBOL_GPL(mars_rollover_interval);
 int mars_scan_interval = CONFIG_MARS_SCAN_INTERVAL;
 EXPORT_SYMBOL_GPL(mars_scan_interval);
 
+int mars_round_delay_ms = 20;
+EXPORT_SYMBOL_GPL(mars_round_delay_ms);
+
+int mars_rounds_full = 0;
+EXPORT_SYMBOL_GPL(mars_rounds_full);
+int mars_rounds_partial = 0;
+EXPORT_SYMBOL_GPL(mars_rounds_partial);
+
 int mars_propagate_interval = CONFIG_MARS_PROPAGATE_INTERVAL;
 EXPORT_SYMBOL_GPL(mars_propagate_interval);
 
@@ -533,6 +542,7 @@ struct mars_rotate {
 	int split_brain_round;
 	int fetch_next_is_available;
 	int relevant_serial;
+	int numa_node;
 	bool has_symlinks;
 	bool res_shutdown;
 	bool has_error;
@@ -627,6 +637,7 @@ int _set_trans_params(struct mars_brick *_brick, void *private)
 struct client_cookie {
 	bool limit_mode;
 	bool create_mode;
+	int compress_mode;
 };
 
 static
@@ -635,7 +646,10 @@ int _set_client_params(struct mars_brick *_brick, void *private)
 	struct client_brick *client_brick = (void*)_brick;
 	struct client_cookie *clc = private;
 	client_brick->io_timeout = 0;
+	client_brick->nr_channels = mars_client_channels;
+	client_brick->stripe_size = mars_client_stripe_kb * 1024;
 	client_brick->limit_mode = clc ? clc->limit_mode : false;
+	client_brick->compress_mode = clc ? clc->compress_mode : MARS_COMPRESS_NONE;
 	client_brick->killme = true;
 	MARS_INF("name = '%s' path = '%s'\n", _brick->brick_name, _brick->brick_path);
 	return 1;
@@ -659,6 +673,23 @@ int _set_sio_params(struct mars_brick *_brick, void *private)
 	return 1;
 }
 
+static
+int _set_rio_params(struct mars_brick *_brick, void *private)
+{
+	struct rio_brick *rio_brick = (void*)_brick;
+	struct client_cookie *clc = private;
+	if (_brick->type != (void*)&rio_brick_type) {
+		MARS_ERR("bad brick type\n");
+		return -EINVAL;
+	}
+	rio_brick->o_creat = clc && clc->create_mode;
+	rio_brick->o_direct = false; // important!
+	rio_brick->o_fdsync = true;
+	rio_brick->killme = true;
+	MARS_INF("name = '%s' path = '%s'\n", _brick->brick_name, _brick->brick_path);
+	return 1;
+}
+
 static
 int _set_aio_params(struct mars_brick *_brick, void *private)
 {
@@ -670,6 +701,9 @@ int _set_aio_params(struct mars_brick *_brick, void *private)
 	if (_brick->type == (void*)&sio_brick_type) {
 		return _set_sio_params(_brick, private);
 	}
+	if (_brick->type == (void*)&rio_brick_type) {
+		return _set_rio_params(_brick, private);
+	}
 	if (_brick->type != (void*)&aio_brick_type) {
 		MARS_ERR("bad brick type\n");
 		return -EINVAL;
@@ -695,6 +729,9 @@ int _set_bio_params(struct mars_brick *_brick, void *private)
 	if (_brick->type == (void*)&sio_brick_type) {
 		return _set_sio_params(_brick, private);
 	}
+	if (_brick->type == (void*)&rio_brick_type) {
+		return _set_rio_params(_brick, private);
+	}
 	if (_brick->type != (void*)&bio_brick_type) {
 		MARS_ERR("bad brick type\n");
 		return -EINVAL;
@@ -765,6 +802,10 @@ int _set_copy_params(struct mars_brick *_brick, void *private)
 	copy_brick->append_mode = COPY_APPEND_MODE;
 	copy_brick->io_prio = COPY_PRIO;
 	copy_brick->verify_mode = cc->verify_mode;
+	copy_brick->verify_digest = mars_copy_verify_digest;
+	// hierarchical delta sync is only used together with verify
+	copy_brick->tree_depth = cc->verify_mode ? mars_copy_tree_depth : 0;
+	copy_brick->tree_leaf_size = (mars_copy_tree_leaf_kb * 1024) & PAGE_MASK;
 	copy_brick->repair_mode = true;
 	copy_brick->killme = true;
 	MARS_INF("name = '%s' path = '%s'\n", _brick->brick_name, _brick->brick_path);
@@ -906,6 +947,45 @@ done:
 	return res;
 }
 
+/* Optional NUMA home node of a resource, given by the
+ * value of todo-$host/numa-node. Returns -1 when absent or invalid.
+ */
+static
+int _check_numa_node(struct mars_global *global, struct mars_dent *parent)
+{
+	int res = -1;
+	struct mars_dent *node_dent;
+	char *path = path_make("%s/todo-%s/numa-node", parent->d_path, my_id());
+
+	if (!path)
+		goto done;
+
+	node_dent = mars_find_dent(global, path);
+	if (!node_dent || !node_dent->new_link)
+		goto done;
+	sscanf(node_dent->new_link, "%d", &res);
+	if (res >= 0 && (res >= nr_node_ids || !node_online(res))) {
+		MARS_WRN("'%s': NUMA node %d is not online\n", path, res);
+		res = -1;
+	}
+
+done:
+	brick_string_free(path);
+	return res;
+}
+
+static
+void _set_numa_node(struct mars_brick *brick, int node)
+{
+	if (!brick)
+		return;
+	if (brick->type == (void*)&aio_brick_type) {
+		((struct aio_brick*)brick)->numa_node = node;
+	} else if (brick->type == (void*)&trans_logger_brick_type) {
+		((struct trans_logger_brick*)brick)->numa_node = node;
+	}
+}
+
 #define skip_part(s) _skip_part(s, ',', ':')
 #define skip_sect(s) _skip_part(s, ':', 0)
 static inline
@@ -1239,7 +1319,7 @@ void _update_info(struct trans_logger_info *inf)
 	rot->infs_is_dirty[hash] = true;
 	traced_unlock(&rot->inf_lock, flags);
 
-	mars_trigger();
+	mars_trigger_path(rot->parent_path);
 done:;
 }
 
@@ -1290,7 +1370,7 @@ void write_info_links(struct mars_rotate *rot)
 	}
 	if (count) {
 		if (inf.inf_min_pos == inf.inf_max_pos)
-			mars_trigger();
+			mars_trigger_path(rot->parent_path);
 		mars_remote_trigger();
 	}
 }
@@ -1313,7 +1393,7 @@ void _make_new_replaylink(struct mars_rotate *rot, char *new_host, int new_seque
 	_update_replay_link(rot, &inf);
 	_update_version_link(rot, &inf);
 
-	mars_trigger();
+	mars_trigger_path(rot->parent_path);
 	mars_remote_trigger();
 }
 
@@ -1428,6 +1508,7 @@ int __make_copy(
 		loff_t end_pos,   // -1 means at EOF of target
 		bool verify_mode,
 		bool limit_mode,
+		int compress_mode,
 		struct copy_brick **__copy)
 {
 	struct mars_brick *copy;
@@ -1435,10 +1516,12 @@ int __make_copy(
 	struct client_cookie clc[2] = {
 		{
 			.limit_mode = limit_mode,
+			.compress_mode = compress_mode,
 		},
 		{
 			.limit_mode = limit_mode,
 			.create_mode = true,
+			.compress_mode = compress_mode,
 		},
 	};
 	int i;
@@ -1562,15 +1645,20 @@ struct mars_peerinfo {
 	struct mars_global *global;
 	char *peer;
 	char *path;
+	char *dent_path; // where run_bones() is called for this peer
 	struct mars_socket socket;
 	struct task_struct *peer_thread;
 	spinlock_t lock;
 	struct list_head peer_head;
 	struct list_head remote_dent_list;
+	struct list_head bones_list; // remote view, only used by run_bones()
 	unsigned long last_remote_jiffies;
+	long long remote_generation; // last known generation of CMD_GETENTS
+	int getents_count;
 	int maxdepth;
 	bool to_remote_trigger;
 	bool from_remote_trigger;
+	bool remote_full; // remote_dent_list is complete, not a delta
 };
 
 static
@@ -1659,7 +1747,7 @@ int _update_file(struct mars_dent *parent, const char *switch_path, const char *
 	}
 
 	MARS_DBG("src = '%s' dst = '%s'\n", tmp, file);
-	status = __make_copy(global, NULL, do_start ? switch_path : "", copy_path, NULL, argv, msg_pair, -1, -1, false, false, &copy);
+	status = __make_copy(global, NULL, do_start ? switch_path : "", copy_path, NULL, argv, msg_pair, -1, -1, false, false, _check_allow(global, parent, "compress"), &copy);
 	if (status >= 0 && copy) {
 		copy->copy_limiter = &rot->fetch_limiter;
 		// FIXME: code is dead
@@ -1888,22 +1976,63 @@ int run_bone(struct mars_peerinfo *peer, struct mars_dent *remote_dent)
 	return status;
 }
 
+/* Merge a delta into the remote view.
+ * Newer versions of a dent replace the older ones.
+ */
+static
+void _merge_bones(struct mars_peerinfo *peer, struct list_head *delta)
+{
+	LIST_HEAD(old_list);
+
+	while (!list_empty(delta)) {
+		struct mars_dent *new = container_of(delta->next, struct mars_dent, dent_link);
+		struct list_head *tmp;
+
+		list_del_init(&new->dent_link);
+		for (tmp = peer->bones_list.next; tmp != &peer->bones_list; tmp = tmp->next) {
+			struct mars_dent *old = container_of(tmp, struct mars_dent, dent_link);
+			if (old->d_path && new->d_path && !strcmp(old->d_path, new->d_path)) {
+				list_move(&old->dent_link, &old_list);
+				break;
+			}
+		}
+		list_add_tail(&new->dent_link, &peer->bones_list);
+	}
+	mars_free_dent_all(NULL, &old_list);
+}
+
+/* All known remote dents are treated on every call, not only the
+ * changed ones. Some of them are skipped depending on the local
+ * state (e.g. a resource not yet existing locally), and they must
+ * be retried later.
+ */
 static
 int run_bones(struct mars_peerinfo *peer)
 {
 	LIST_HEAD(tmp_list);
 	struct list_head *tmp;
 	unsigned long flags;
-	bool run_trigger = false;
+	bool full;
 	int status = 0;
 
 	traced_lock(&peer->lock, flags);
 	list_replace_init(&peer->remote_dent_list, &tmp_list);
+	full = peer->remote_full;
+	peer->remote_full = false;
 	traced_unlock(&peer->lock, flags);
 
-	MARS_DBG("remote_dent_list list_empty = %d\n", list_empty(&tmp_list));
+	MARS_DBG("remote_dent_list list_empty = %d full = %d\n", list_empty(&tmp_list), full);
+
+	if (full) {
+		LIST_HEAD(old_list);
+		list_replace_init(&peer->bones_list, &old_list);
+		list_replace_init(&tmp_list, &peer->bones_list);
+		mars_free_dent_all(NULL, &old_list);
+	} else {
+		_merge_bones(peer, &tmp_list);
+	}
 
-	for (tmp = tmp_list.next; tmp != &tmp_list; tmp = tmp->next) {
+	for (tmp = peer->bones_list.next; tmp != &peer->bones_list; tmp = tmp->next) {
 		struct mars_dent *remote_dent = container_of(tmp, struct mars_dent, dent_link);
 		if (!remote_dent->d_path || !remote_dent->d_name) {
 			MARS_DBG("NULL\n");
@@ -1912,15 +2041,10 @@ int run_bones(struct mars_peerinfo *peer)
 		MARS_IO("path = '%s'\n", remote_dent->d_path);
 		status = run_bone(peer, remote_dent);
 		if (status > 0)
-			run_trigger = true;
+			mars_trigger_path(remote_dent->d_path);
 		//MARS_DBG("path = '%s' worker status = %d\n", remote_dent->d_path, status);
 	}
 
-	mars_free_dent_all(NULL, &tmp_list);
-
-	if (run_trigger) {
-		mars_trigger();
-	}
 	return status;
 }
 
@@ -1941,6 +2065,27 @@ void _peer_cleanup(struct mars_peerinfo *peer)
 
 static DECLARE_WAIT_QUEUE_HEAD(remote_event);
 
+/* Peers fetch only the changes since their last known generation.
+ * For safety, a full dent list is fetched from time to time.
+ * Old servers don't report any generation, thus they always deliver
+ * full lists.
+ */
+#define PEER_FULL_GETENTS 64
+
+static
+long long _max_generation(struct list_head *anchor)
+{
+	struct list_head *tmp;
+	long long res = 0;
+
+	for (tmp = anchor->next; tmp != anchor; tmp = tmp->next) {
+		struct mars_dent *dent = container_of(tmp, struct mars_dent, dent_link);
+		if (dent->d_generation > res)
+			res = dent->d_generation;
+	}
+	return res;
+}
+
 static
 int peer_thread(void *data)
 {
@@ -1979,6 +2124,7 @@ int peer_thread(void *data)
 		show_vals(peer_pairs, "/mars", "connection-from-");
 
 		if (!mars_socket_is_alive(&peer->socket)) {
+			peer->remote_generation = 0;
 			make_msg(peer_pairs, "connection to '%s' (%s) is dead", peer->peer, real_peer);
 			brick_string_free(real_peer);
 			real_peer = mars_translate_hostname(peer->peer);
@@ -2035,6 +2181,9 @@ int peer_thread(void *data)
 
 		if (likely(status >= 0)) {
 			cmd.cmd_code = CMD_GETENTS;
+			if (++peer->getents_count % PEER_FULL_GETENTS == 0)
+				peer->remote_generation = 0;
+			cmd.cmd_generation = peer->remote_generation;
 			status = mars_send_struct(&peer->socket, &cmd, mars_cmd_meta);
 		}
 		if (unlikely(status < 0)) {
@@ -2061,18 +2210,30 @@ int peer_thread(void *data)
 		}
 
 		if (likely(!list_empty(&tmp_list))) {
-			MARS_DBG("got remote denties\n");
+			long long generation = _max_generation(&tmp_list);
+
+			MARS_DBG("got remote denties (generation %lld since %lld)\n", generation, cmd.cmd_generation);
 
 			traced_lock(&peer->lock, flags);
 
-			list_replace_init(&peer->remote_dent_list, &old_list);
-			list_replace_init(&tmp_list, &peer->remote_dent_list);
+			if (cmd.cmd_generation) {
+				// a delta must not drop any unprocessed changes
+				list_splice_tail_init(&tmp_list, &peer->remote_dent_list);
+			} else {
+				list_replace_init(&peer->remote_dent_list, &old_list);
+				list_replace_init(&tmp_list, &peer->remote_dent_list);
+				peer->remote_full = true;
+			}
 
 			traced_unlock(&peer->lock, flags);
 
+			if (generation > peer->remote_generation)
+				peer->remote_generation = generation;
+
 			peer->last_remote_jiffies = jiffies;
 
-			mars_trigger();
+			// only the bones need to run, see make_scan()
+			mars_trigger_path(peer->dent_path);
 
 			mars_free_dent_all(NULL, &old_list);
 		}
@@ -2210,8 +2371,10 @@ static int _kill_peer(void *buf, struct mars_dent *dent)
 	list_replace_init(&peer->remote_dent_list, &tmp_list);
 	traced_unlock(&peer->lock, flags);
 	mars_free_dent_all(NULL, &tmp_list);
+	mars_free_dent_all(NULL, &peer->bones_list);
 	brick_string_free(peer->peer);
 	brick_string_free(peer->path);
+	brick_string_free(peer->dent_path);
 	dent->d_private = NULL;
 	brick_mem_free(peer);
 	return 0;
@@ -2250,10 +2413,12 @@ static int _make_peer(struct mars_global *global, struct mars_dent *dent, char *
 		peer->global = global;
 		peer->peer = brick_strdup(mypeer);
 		peer->path = brick_strdup(path);
+		peer->dent_path = brick_strdup(dent->d_path);
 		peer->maxdepth = 2;
 		spin_lock_init(&peer->lock);
 		INIT_LIST_HEAD(&peer->peer_head);
 		INIT_LIST_HEAD(&peer->remote_dent_list);
+		INIT_LIST_HEAD(&peer->bones_list);
 
 		write_lock(&peer_lock);
 		list_add_tail(&peer->peer_head, &peer_anchor);
@@ -2345,7 +2510,7 @@ void _create_new_logfile(const char *path)
 	} else {
 		MARS_DBG("created empty logfile '%s'\n", path);
 		filp_close(f, NULL);
-		mars_trigger();
+		mars_trigger_path(path);
 	}
 }
 
@@ -2588,6 +2753,7 @@ int make_log_init(void *buf, struct mars_dent *dent)
 	const char *replay_path = NULL;
 	const char *aio_path = NULL;
 	bool switch_on;
+	int weight;
 	int status = 0;
 
 	if (!global->global_power.button) {
@@ -2616,6 +2782,7 @@ int make_log_init(void *buf, struct mars_dent *dent)
 		}
 		rot->fetch_path = fetch_path;
 		rot->global = global;
+		rot->numa_node = -1;
 		parent->d_private = rot;
 		parent->d_private_destruct = rot_destruct;
 		list_add_tail(&rot->rot_head, &rot_anchor);
@@ -2802,6 +2969,21 @@ int make_log_init(void *buf, struct mars_dent *dent)
 	}
 	rot->trans_brick->kill_ptr = (void**)&rot->trans_brick;
 	rot->trans_brick->replay_limiter = &rot->replay_limiter;
+
+	/* Optional NUMA affinity of the whole IO path
+	 */
+	rot->numa_node = _check_numa_node(global, parent);
+	_set_numa_node((void*)rot->trans_brick, rot->numa_node);
+	_set_numa_node(rot->bio_brick, rot->numa_node);
+	_set_numa_node((void*)rot->aio_brick, rot->numa_node);
+	_set_numa_node(rot->relevant_brick, rot->numa_node);
+	_set_numa_node(rot->next_relevant_brick, rot->numa_node);
+
+	/* Share weight in the shared logger pool (0 = default)
+	 */
+	weight = _check_allow(global, parent, "logger-weight");
+	rot->trans_brick->pool_weight = weight > 0 ? weight : TL_POOL_WEIGHT;
+
 	/* For safety, default is to try an (unnecessary) replay in case
 	 * something goes wrong later.
 	 */
@@ -3226,6 +3408,7 @@ void _rotate_trans(struct mars_rotate *rot)
 			MARS_ERR_TO(rot->log_say, "could not open next transaction log '%s'\n", rot->next_relevant_log->d_path);
 			goto done;
 		}
+		_set_numa_node(rot->next_relevant_brick, rot->numa_node);
 		trans_input = trans_brick->inputs[next_nr];
 		if (unlikely(!trans_input)) {
 			MARS_ERR_TO(rot->log_say, "internal log input does not exist\n");
@@ -3338,6 +3521,7 @@ int _start_trans(struct mars_rotate *rot)
 		MARS_ERR("log aio brick '%s' not open\n", rot->relevant_log->d_path);
 		goto done;
 	}
+	_set_numa_node(rot->relevant_brick, rot->numa_node);
 
 	/* Supply all relevant parameters
 	 */
@@ -3593,7 +3777,7 @@ done:
 		} else {
 			fetch_brick = NULL;
 		}
-		mars_trigger();
+		mars_trigger_path(rot->parent_path);
 	}
 	rot->fetch_next_is_available = 0;
 	rot->fetch_brick = fetch_brick;
@@ -3966,7 +4150,7 @@ static int _make_copy(void *buf, struct mars_dent *dent)
 	// check whether connection is allowed
 	switch_path = path_make("%s/todo-%s/connect", dent->d_parent->d_path, my_id());
 
-	status = __make_copy(global, dent, switch_path, copy_path, dent->d_parent->d_path, (const char**)dent->d_argv, NULL, -1, -1, false, true, NULL);
+	status = __make_copy(global, dent, switch_path, copy_path, dent->d_parent->d_path, (const char**)dent->d_argv, NULL, -1, -1, false, true, MARS_COMPRESS_NONE, NULL);
 
 done:
 	MARS_DBG("status = %d\n", status);
@@ -4179,7 +4363,7 @@ static int make_sync(void *buf, struct mars_dent *dent)
 
 	{
 		const char *argv[2] = { src, dst };
-		status = __make_copy(global, dent, do_start ? switch_path : "", copy_path, dent->d_parent->d_path, argv, find_key(rot->msgs, "inf-sync"), start_pos, end_pos, mars_fast_fullsync > 0, true, &copy);
+		status = __make_copy(global, dent, do_start ? switch_path : "", copy_path, dent->d_parent->d_path, argv, find_key(rot->msgs, "inf-sync"), start_pos, end_pos, mars_fast_fullsync > 0, true, _check_allow(global, dent->d_parent, "compress"), &copy);
 		if (copy) {
 			copy->kill_ptr = (void**)&rot->sync_brick;
 			copy->copy_limiter = &rot->sync_limiter;
@@ -5088,6 +5272,20 @@ int light_checker(struct mars_dent *parent, const char *_name, int namlen, unsig
 	return status;
 }
 
+/* During partial rounds, the items of resources without any
+ * event since the last round need not be treated.
+ * Global items are always treated.
+ */
+static
+bool _resource_triggered(struct mars_global *global, struct mars_dent *dent)
+{
+	while (dent && dent->d_class != CL_RESOURCE)
+		dent = dent->d_parent;
+	if (!dent)
+		return true;
+	return mars_path_triggered(global, dent->d_path);
+}
+
 /* Do some syntactic checks, then delegate work to the real worker functions
  * from the light_classes[] table.
  */
@@ -5100,6 +5298,8 @@ static int light_worker(struct mars_global *global, struct mars_dent *dent, bool
 		MARS_ERR_ONCE(dent, "bad internal class %d of '%s'\n", class, dent->d_path);
 		return -EINVAL;
 	}
+	if (!_resource_triggered(global, dent))
+		return 0;
 	switch (light_classes[class].cl_type) {
 	case 'd':
 		if (!S_ISDIR(dent->new_stat.mode)) {
@@ -5170,6 +5370,7 @@ static struct mars_global _global = {
 static int light_thread(void *data)
 {
 	long long last_rollover = jiffies;
+	long long last_full = jiffies;
 	char *id = my_id();
 	int status = 0;
 	mars_global = &_global;
@@ -5183,9 +5384,28 @@ static int light_thread(void *data)
 	MARS_INF("-------- starting as host '%s' ----------\n", id);
 
         while (_global.global_power.button || !list_empty(&_global.brick_anchor)) {
+		long long round_start = jiffies;
+		long long delay;
+		int round_delay_ms;
+		bool partial;
 		int status;
 
-		MARS_DBG("-------- NEW ROUND %d ---------\n", atomic_read(&server_handler_count));
+		/* Rounds caused only by mars_trigger_path() need to treat
+		 * only the triggered resources. Everything else is treated
+		 * at least once per mars_scan_interval.
+		 */
+		partial = _global.path_trigger && !_global.main_trigger &&
+			_global.global_power.button &&
+			(long long)jiffies < last_full + mars_scan_interval * HZ;
+		if (!partial)
+			last_full = jiffies;
+		mars_start_round(&_global, partial);
+		if (partial)
+			mars_rounds_partial++;
+		else
+			mars_rounds_full++;
+
+		MARS_DBG("-------- NEW ROUND %d partial=%d ---------\n", atomic_read(&server_handler_count), partial);
 
 		if (mars_mem_percent < 0)
 			mars_mem_percent = 0;
@@ -5193,8 +5413,6 @@ static int light_thread(void *data)
 			mars_mem_percent = 70;
 		brick_global_memlimit = (long long)brick_global_memavail * mars_mem_percent / 100;
 
-		brick_msleep(100);
-
 		if (brick_thread_should_stop()) {
 			_global.global_power.button = false;
 			mars_net_is_alive = false;
@@ -5224,6 +5442,8 @@ static int light_thread(void *data)
 		MARS_DBG("kill aio    bricks (when possible) = %d\n", status);
 		status = mars_kill_brick_when_possible(&_global, &_global.brick_anchor, false, (void*)&sio_brick_type, true);
 		MARS_DBG("kill sio    bricks (when possible) = %d\n", status);
+		status = mars_kill_brick_when_possible(&_global, &_global.brick_anchor, false, (void*)&rio_brick_type, true);
+		MARS_DBG("kill rio    bricks (when possible) = %d\n", status);
 		status = mars_kill_brick_when_possible(&_global, &_global.brick_anchor, false, (void*)&bio_brick_type, true);
 		MARS_DBG("kill bio    bricks (when possible) = %d\n", status);
 
@@ -5238,11 +5458,19 @@ static int light_thread(void *data)
 
 		MARS_DBG("ban_count = %d ban_renew_count = %d\n", mars_global_ban.ban_count, mars_global_ban.ban_renew_count);
 
-		brick_msleep(500);
-
-		wait_event_interruptible_timeout(_global.main_event, _global.main_trigger, mars_scan_interval * HZ);
+		wait_event_interruptible_timeout(_global.main_event,
+						 _global.main_trigger || _global.path_trigger,
+						 mars_scan_interval * HZ);
 
-		_global.main_trigger = false;
+		// limit the round rate under a storm of events
+		round_delay_ms = mars_round_delay_ms;
+		if (round_delay_ms < 0)
+			round_delay_ms = 0;
+		else if (round_delay_ms > 1000)
+			round_delay_ms = 1000;
+		delay = round_start + msecs_to_jiffies(round_delay_ms) - (long long)jiffies;
+		if (delay > 0)
+			brick_msleep(jiffies_to_msecs(delay));
 	}
 
 done:
@@ -5409,6 +5637,7 @@ static int __init init_light(void)
 	DO_INIT(mars_client);
 	DO_INIT(mars_aio);
 	DO_INIT(mars_sio);
+	DO_INIT(mars_rio);
 	DO_INIT(mars_bio);
 	DO_INIT(mars_if);
 	DO_INIT(mars_copy);
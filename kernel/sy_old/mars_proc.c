@@ -16,6 +16,7 @@
 #include "../lib_mapfree.h"
 #include "../mars_bio.h"
 #include "../mars_aio.h"
+#include "../mars_rio.h"
 #include "../mars_if.h"
 #include "../mars_copy.h"
 #include "../mars_client.h"
@@ -158,11 +159,66 @@ done:
 	return res;
 }
 
+/* Each read drains another chunk of the trace rings,
+ * until they are empty. Thus the file position is ignored.
+ */
+static
+int trace_sysctl_handler(
+	ctl_table *table,
+	int write, 
+	void __user *buffer,
+	size_t *length,
+	loff_t *ppos)
+{
+	ssize_t res = 0;
+	size_t len = *length;
+
+	MARS_DBG("write = %d len = %ld pos = %lld\n", write, len, *ppos);
+
+	if (!len) {
+		goto done;
+	}
+
+	if (write) {
+		return -EINVAL;
+	} else {
+		int my_len = len < PAGE_SIZE ? len : PAGE_SIZE;
+		char *tmp = brick_string_alloc(my_len);
+
+		if (unlikely(!tmp))
+			return -ENOMEM;
+
+		res = mars_trace_read(tmp, my_len);
+
+		if (copy_to_user(buffer, tmp, res)) {
+			MARS_ERR("write %ld bytes at %p failed\n", res, buffer);
+			res = -EFAULT;
+		}
+		brick_string_free(tmp);
+	}
+
+done:
+	MARS_DBG("res = %ld\n", res);
+	*length = res;
+	if (res >= 0) {
+	        *ppos += res;
+		return 0;
+	}
+	return res;
+}
+
 #ifdef CONFIG_MARS_LOADAVG_LIMIT
 int mars_max_loadavg = 0;
 EXPORT_SYMBOL_GPL(mars_max_loadavg);
 #endif
 
+static int log_crc_min = 0;
+static int log_crc_max = LOG_CRC_MAX - 1;
+static int round_delay_min = 0;
+static int round_delay_max = 1000;
+static int aio_sync_window_min = 0;
+static int aio_sync_window_max = AIO_SYNC_WINDOW_MAX;
+
 #ifdef CTL_UNNUMBERED
 #define _CTL_NAME 		.ctl_name       = CTL_UNNUMBERED,
 #define _CTL_STRATEGY(handler)	.strategy       = &handler,
@@ -185,6 +241,20 @@ EXPORT_SYMBOL_GPL(mars_max_loadavg);
 #define INT_ENTRY(NAME,VAR,MODE)			\
 	VEC_ENTRY(NAME, VAR, MODE, 1)
 
+// out-of-range values are rejected with -EINVAL
+#define RANGE_ENTRY(NAME,VAR,MODE,MIN,MAX)		\
+	{						\
+		_CTL_NAME				\
+		.procname	= NAME,			\
+		.data           = &(VAR),		\
+		.maxlen         = sizeof(int),		\
+		.mode		= MODE,			\
+		.proc_handler	= &proc_dointvec_minmax,\
+		_CTL_STRATEGY(sysctl_intvec)		\
+		.extra1		= &(MIN),		\
+		.extra2		= &(MAX),		\
+	}
+
 #define LIMITER_ENTRIES(VAR, PREFIX, SUFFIX)				\
 	INT_ENTRY(PREFIX "_ratelimit_" SUFFIX, (VAR)->lim_max_rate, 0600), \
 	INT_ENTRY(PREFIX "_maxdelay_ms",   (VAR)->lim_max_delay,0600),	\
@@ -230,6 +300,7 @@ ctl_table tcp_tuning_table[] = {
 	INT_ENTRY("tcp_keepcnt",     default_tcp_params.tcp_keepcnt,     0600),
 	INT_ENTRY("tcp_keepintvl",   default_tcp_params.tcp_keepintvl,   0600),
 	INT_ENTRY("tcp_keepidle",    default_tcp_params.tcp_keepidle,    0600),
+	INT_ENTRY("zerocopy_min_bytes", mars_net_zerocopy_min,           0600),
 	{}
 };
 
@@ -261,14 +332,29 @@ ctl_table mars_table[] = {
 		.mode		= 0400,
 		.proc_handler	= &lamport_sysctl_handler,
 	},
+	{
+		_CTL_NAME
+		.procname	= "trace",
+		.mode		= 0400,
+		.proc_handler	= &trace_sysctl_handler,
+	},
+	INT_ENTRY("trace_rate",           mars_trace_rate,        0600),
+	INT_ENTRY("trace_lost",           mars_trace_lost,        0400),
 	INT_ENTRY("show_log_messages",    brick_say_logging,      0600),
 	INT_ENTRY("show_debug_messages",  brick_say_debug,        0600),
 	INT_ENTRY("show_statistics_global", global_show_statist,  0600),
 	INT_ENTRY("show_statistics_server", server_show_statist,  0600),
+	INT_ENTRY("server_getents_cache_ms", server_getents_cache_ms, 0600),
 	INT_ENTRY("show_connections",     global_show_connections, 0600),
 	INT_ENTRY("aio_sync_mode",        aio_sync_mode,          0600),
+	INT_ENTRY("aio_submit_batch",     aio_submit_batch,       0600),
+	RANGE_ENTRY("aio_sync_window_us", aio_sync_window_us,     0600, aio_sync_window_min, aio_sync_window_max),
+	INT_ENTRY("use_rio_bricks",       mars_use_rio,           0600),
+	INT_ENTRY("rio_workers",          rio_nr_workers,         0600),
 	INT_ENTRY("logger_completion_semantics", trans_logger_completion_semantics, 0600),
 	INT_ENTRY("logger_do_crc",        trans_logger_do_crc,    0600),
+	RANGE_ENTRY("logger_crc_type",    trans_logger_crc_type,  0600, log_crc_min, log_crc_max),
+	INT_ENTRY("logger_group_delay_us", trans_logger_group_delay_us, 0600),
 	INT_ENTRY("syslog_min_class",     brick_say_syslog_min,   0600),
 	INT_ENTRY("syslog_max_class",     brick_say_syslog_max,   0600),
 	INT_ENTRY("syslog_flood_class",   brick_say_syslog_flood_class, 0600),
@@ -280,6 +366,10 @@ ctl_table mars_table[] = {
 	INT_ENTRY("logger_max_interleave", trans_logger_max_interleave, 0600),
 	INT_ENTRY("logger_resume",        trans_logger_resume,    0600),
 	INT_ENTRY("logger_replay_timeout_sec", trans_logger_replay_timeout, 0600),
+	INT_ENTRY("logger_lazy_replay_kb", trans_logger_lazy_replay_kb, 0600),
+	INT_ENTRY("logger_replay_depth", trans_logger_replay_depth, 0600),
+	INT_ENTRY("logger_phase_workers", trans_logger_phase_workers, 0600),
+	INT_ENTRY("logger_pool_size",     trans_logger_pool_size, 0600),
 	INT_ENTRY("mem_limit_percent",    mars_mem_percent,       0600),
 	INT_ENTRY("logger_mem_used_kb",   trans_logger_mem_usage, 0400),
 	INT_ENTRY("mem_used_raw_kb",      brick_global_block_used,0400),
@@ -292,15 +382,30 @@ ctl_table mars_table[] = {
 	INT_ENTRY("io_flying_count",      mars_global_io_flying,  0400),
 	INT_ENTRY("copy_overlap",         mars_copy_overlap,      0600),
 	INT_ENTRY("copy_read_prio",       mars_copy_read_prio,    0600),
+	INT_ENTRY("copy_verify_digest",   mars_copy_verify_digest, 0600),
+	INT_ENTRY("copy_tree_depth",      mars_copy_tree_depth,   0600),
+	INT_ENTRY("copy_tree_leaf_kb",    mars_copy_tree_leaf_kb, 0600),
 	INT_ENTRY("copy_write_prio",      mars_copy_write_prio,   0600),
 	INT_ENTRY("copy_read_max_fly",    mars_copy_read_max_fly, 0600),
 	INT_ENTRY("copy_write_max_fly",   mars_copy_write_max_fly,0600),
 	INT_ENTRY("statusfiles_rollover_sec", mars_rollover_interval, 0600),
 	INT_ENTRY("scan_interval_sec",    mars_scan_interval,     0600),
+	RANGE_ENTRY("round_delay_ms",     mars_round_delay_ms,    0600, round_delay_min, round_delay_max),
+	INT_ENTRY("rounds_full",          mars_rounds_full,       0400),
+	INT_ENTRY("rounds_partial",       mars_rounds_partial,    0400),
+	INT_ENTRY("scan_incremental",     mars_incremental_scan,  0600),
+	INT_ENTRY("scan_dents",           mars_scan_dents,        0400),
+	INT_ENTRY("scan_readdirs",        mars_scan_readdirs,     0400),
+	INT_ENTRY("scan_inodes",          mars_scan_inodes,       0400),
+	INT_ENTRY("scan_round_ms",        mars_scan_ms,           0400),
+	INT_ENTRY("scan_lookups",         mars_scan_lookups,      0400),
+	INT_ENTRY("scan_lookup_probes",   mars_scan_lookup_probes, 0400),
 	INT_ENTRY("propagate_interval_sec", mars_propagate_interval, 0600),
 	INT_ENTRY("sync_flip_interval_sec", mars_sync_flip_interval, 0600),
 	INT_ENTRY("peer_abort",           mars_peer_abort,        0600),
 	INT_ENTRY("client_abort",         mars_client_abort,      0600),
+	INT_ENTRY("client_channels",      mars_client_channels,   0600),
+	INT_ENTRY("client_stripe_kb",     mars_client_stripe_kb,  0600),
 	INT_ENTRY("do_fast_fullsync",     mars_fast_fullsync,     0600),
 	INT_ENTRY("logrot_auto_gb",       global_logrot_auto,     0600),
 	INT_ENTRY("remaining_space_kb",   global_remaining_space, 0400),
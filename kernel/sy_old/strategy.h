@@ -23,6 +23,9 @@ extern int global_sync_nr;
 extern int global_sync_limit;
 extern int mars_rollover_interval;
 extern int mars_scan_interval;
+extern int mars_round_delay_ms;
+extern int mars_rounds_full;
+extern int mars_rounds_partial;
 extern int mars_propagate_interval;
 extern int mars_sync_flip_interval;
 extern int mars_peer_abort;
@@ -36,6 +39,8 @@ extern char *my_id(void);
 
 #define MARS_DENT(TYPE)							\
 	struct list_head dent_link;					\
+	struct hlist_node d_hash_node; /* index by d_path */		\
+	struct hlist_node d_dir_hash_node; /* index by dirname of d_path */ \
 	struct list_head brick_list;					\
 	struct TYPE *d_parent;						\
 	char *d_argv[MARS_ARGV_MAX];  /* for internal use, will be automatically deallocated*/ \
@@ -51,9 +56,14 @@ extern char *my_id(void);
 	int   d_class;    /* for pre-grouping order */			\
 	int   d_serial;   /* for pre-grouping order */			\
 	int   d_version;  /* dynamic programming per call of mars_ent_work() */ \
+	int   d_scan_version; /* round of the last readdir() */	\
+	long  d_scan_sec; /* when the directory was read the last time */ \
+	struct timespec d_scan_mtime; /* its mtime at that time */	\
 	int   d_child_count;						\
+	long long d_generation; /* CMD_GETENTS: generation of the last change */ \
 	char d_once_error;						\
 	bool d_killme;							\
+	bool d_vanished; /* the last get_inode() found no inode */	\
 	bool d_use_channel;						\
 	struct kstat new_stat;						\
 	struct kstat old_stat;						\
@@ -70,18 +80,30 @@ struct mars_dent {
 extern const struct meta mars_kstat_meta[];
 extern const struct meta mars_dent_meta[];
 
+// hashed top-level directories (e.g. resources) needing work
+#define MARS_TRIGGER_BITS 256
+
 struct mars_global {
 	struct rw_semaphore dent_mutex;
 	struct rw_semaphore brick_mutex;
 	struct generic_switch global_power;
 	struct list_head dent_anchor;
 	struct list_head brick_anchor;
+	// hash indexes, allocated on demand
+	struct hlist_head *dent_hash;
+	struct hlist_head *dent_dir_hash;
+	struct hlist_head *brick_hash;
 	wait_queue_head_t main_event;
+	unsigned long trigger_map[BITS_TO_LONGS(MARS_TRIGGER_BITS)]; // for the next round
+	unsigned long round_map[BITS_TO_LONGS(MARS_TRIGGER_BITS)];   // for the current round
 	int global_version;
+	int scan_round;
 	int deleted_my_border;
 	int deleted_border;
 	int deleted_min;
 	bool main_trigger;
+	bool path_trigger;
+	bool partial_round; // only triggered paths need work
 };
 
 extern void bind_to_dent(struct mars_dent *dent, struct say_channel **ch);
@@ -89,9 +111,32 @@ extern void bind_to_dent(struct mars_dent *dent, struct say_channel **ch);
 typedef int (*mars_dent_checker_fn)(struct mars_dent *parent, const char *name, int namlen, unsigned int d_type, int *prefix, int *serial, bool *use_channel);
 typedef int (*mars_dent_worker_fn)(struct mars_global *global, struct mars_dent *dent, bool prepare, bool direction);
 
+/* Incremental scanning: 0 = always full scans,
+ * n > 0 = full scan only every n-th round of mars_dent_work().
+ */
+extern int mars_incremental_scan;
+// statistics of the last round of the main strategy
+extern int mars_scan_dents;
+extern int mars_scan_readdirs;
+extern int mars_scan_inodes;
+extern int mars_scan_ms;
+extern int mars_scan_lookups;
+extern int mars_scan_lookup_probes;
+
+/* Targeted rounds of the strategy.
+ * mars_trigger_path() marks the top-level directory below the root
+ * of the scan (e.g. the resource directory) where the path belongs to.
+ * Changes found by mars_dent_work() are marked as well.
+ * Workers may skip any unmarked items during a partial round.
+ */
+extern void mars_start_round(struct mars_global *global, bool partial);
+extern bool mars_path_triggered(struct mars_global *global, const char *path);
+
 extern int mars_dent_work(struct mars_global *global, char *dirname, int allocsize, mars_dent_checker_fn checker, mars_dent_worker_fn worker, void *buf, int maxdepth);
 extern struct mars_dent *_mars_find_dent(struct mars_global *global, const char *path);
 extern struct mars_dent *mars_find_dent(struct mars_global *global, const char *path);
+/* Notice: the table is not in the order of the dent list.
+ */
 extern int mars_find_dent_all(struct mars_global *global, char *prefix, struct mars_dent ***table);
 extern void mars_kill_dent(struct mars_dent *dent);
 extern void mars_free_dent(struct mars_dent *dent);
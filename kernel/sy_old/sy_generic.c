@@ -13,6 +13,7 @@
 #include <linux/blkdev.h>
 #include <linux/fs.h>
 #include <linux/utsname.h>
+#include <linux/hash.h>
 
 #include "strategy.h"
 
@@ -51,6 +52,7 @@ const struct meta mars_dent_meta[] = {
 	META_INI(d_serial,  struct mars_dent, FIELD_INT),
 	META_INI(d_corr_A,  struct mars_dent, FIELD_INT),
 	META_INI(d_corr_B,  struct mars_dent, FIELD_INT),
+	META_INI(d_generation, struct mars_dent, FIELD_INT),
 	META_INI_SUB(new_stat,struct mars_dent, mars_kstat_meta),
 	META_INI_SUB(old_stat,struct mars_dent, mars_kstat_meta),
 	META_INI(new_link,    struct mars_dent, FIELD_STRING),
@@ -536,6 +538,171 @@ struct mars_cookie {
 	int depth;
 };
 
+/* Hash indexes for dents and bricks.
+ * They are maintained alongside the lists, under the same locks.
+ * When a table cannot be allocated, lookups fall back to the lists.
+ */
+#define MARS_PATH_HASH_BITS 11
+#define MARS_PATH_HASH_SIZE (1 << MARS_PATH_HASH_BITS)
+
+static atomic_t lookup_count = ATOMIC_INIT(0);
+static atomic_t lookup_probe_count = ATOMIC_INIT(0);
+
+static inline
+unsigned int _path_hash(const char *path, int len)
+{
+	unsigned int hash = 0;
+	while (len-- > 0 && *path)
+		hash = hash * 31 + (unsigned char)*path++;
+	return hash_32(hash, MARS_PATH_HASH_BITS);
+}
+
+static inline
+int _dirname_len(const char *path)
+{
+	const char *tmp = strrchr(path, '/');
+	return tmp ? tmp - path : 0;
+}
+
+/* Path triggers address the top-level directory below the root,
+ * e.g. /mars/resource-mydata for /mars/resource-mydata/data-myhost.
+ * Hash collisions only cause some unnecessary work.
+ * Paths outside of /mars/ (e.g. bricks named after a device) are
+ * not mapped to any resource, so they trigger a full round.
+ */
+static
+int _trigger_bit(const char *path)
+{
+	const char *tmp;
+	int len;
+
+	if (!path || strncmp(path, "/mars/", 6) || !path[6])
+		return -1;
+	tmp = strchr(path + 6, '/');
+	len = tmp ? tmp - path : strlen(path);
+	return _path_hash(path, len) % MARS_TRIGGER_BITS;
+}
+
+static
+void _mark_path(struct mars_global *global, const char *path)
+{
+	int bit = _trigger_bit(path);
+	if (bit >= 0)
+		set_bit(bit, global->round_map);
+}
+
+static
+void __mars_trigger_path(const char *path)
+{
+	struct mars_global *global = mars_global;
+	int bit;
+
+	if (!global)
+		return;
+	bit = _trigger_bit(path);
+	if (bit < 0) {
+		__mars_trigger();
+		return;
+	}
+	set_bit(bit, global->trigger_map);
+	global->path_trigger = true;
+	wake_up_interruptible_all(&global->main_event);
+}
+
+void mars_start_round(struct mars_global *global, bool partial)
+{
+	int i;
+
+	global->main_trigger = false;
+	global->path_trigger = false;
+	// triggers arriving from now on belong to the next round
+	for (i = 0; i < BITS_TO_LONGS(MARS_TRIGGER_BITS); i++)
+		global->round_map[i] = xchg(&global->trigger_map[i], 0);
+	global->partial_round = partial;
+}
+EXPORT_SYMBOL_GPL(mars_start_round);
+
+bool mars_path_triggered(struct mars_global *global, const char *path)
+{
+	int bit;
+
+	if (!global->partial_round)
+		return true;
+	bit = _trigger_bit(path);
+	return bit < 0 || test_bit(bit, global->round_map);
+}
+EXPORT_SYMBOL_GPL(mars_path_triggered);
+
+static
+void __dent_hash_insert(struct mars_global *global, struct mars_dent *dent)
+{
+	hlist_add_head(&dent->d_hash_node, &global->dent_hash[_path_hash(dent->d_path, INT_MAX)]);
+	hlist_add_head(&dent->d_dir_hash_node, &global->dent_dir_hash[_path_hash(dent->d_path, _dirname_len(dent->d_path))]);
+}
+
+/* Called after the dent has been added to the list.
+ */
+static
+void _dent_hash_insert(struct mars_global *global, struct mars_dent *dent)
+{
+	struct list_head *tmp;
+
+	if (likely(global->dent_hash && global->dent_dir_hash)) {
+		__dent_hash_insert(global, dent);
+		return;
+	}
+	// (re-)create the indexes from the list
+	if (!global->dent_hash)
+		global->dent_hash = brick_zmem_alloc(MARS_PATH_HASH_SIZE * sizeof(struct hlist_head));
+	if (!global->dent_dir_hash)
+		global->dent_dir_hash = brick_zmem_alloc(MARS_PATH_HASH_SIZE * sizeof(struct hlist_head));
+	if (unlikely(!global->dent_hash || !global->dent_dir_hash)) {
+		brick_mem_free(global->dent_hash);
+		global->dent_hash = NULL;
+		brick_mem_free(global->dent_dir_hash);
+		global->dent_dir_hash = NULL;
+		return;
+	}
+	for (tmp = global->dent_anchor.next; tmp != &global->dent_anchor; tmp = tmp->next) {
+		struct mars_dent *tmp_dent = container_of(tmp, struct mars_dent, dent_link);
+		INIT_HLIST_NODE(&tmp_dent->d_hash_node);
+		INIT_HLIST_NODE(&tmp_dent->d_dir_hash_node);
+		__dent_hash_insert(global, tmp_dent);
+	}
+}
+
+/* Called after the brick has been added to the list.
+ */
+static
+void _brick_hash_insert(struct mars_global *global, struct mars_brick *brick)
+{
+	struct list_head *tmp;
+
+	if (likely(global->brick_hash)) {
+		hlist_add_head(&brick->brick_hash_node, &global->brick_hash[_path_hash(brick->brick_path, INT_MAX)]);
+		return;
+	}
+	// (re-)create the index from the list
+	global->brick_hash = brick_zmem_alloc(MARS_PATH_HASH_SIZE * sizeof(struct hlist_head));
+	if (unlikely(!global->brick_hash))
+		return;
+	/* Walk backwards, such that the most recent bricks come first,
+	 * like in the list.
+	 */
+	for (tmp = global->brick_anchor.prev; tmp != &global->brick_anchor; tmp = tmp->prev) {
+		struct mars_brick *test = container_of(tmp, struct mars_brick, global_brick_link);
+		INIT_HLIST_NODE(&test->brick_hash_node);
+		hlist_add_head(&test->brick_hash_node, &global->brick_hash[_path_hash(test->brick_path, INT_MAX)]);
+	}
+}
+
+static
+void _dent_hash_remove(struct mars_dent *dent)
+{
+	hlist_del_init(&dent->d_hash_node);
+	hlist_del_init(&dent->d_dir_hash_node);
+}
+
 static
 int get_inode(char *newpath, struct mars_dent *dent)
 {
@@ -547,6 +714,7 @@ int get_inode(char *newpath, struct mars_dent *dent)
 	set_fs(get_ds());
 
 	status = vfs_lstat(newpath, &tmp);
+	dent->d_vanished = (status == -ENOENT);
 	if (status < 0) {
 		MARS_WRN("cannot stat '%s', status = %d\n", newpath, status);
 		goto done;
@@ -703,6 +871,8 @@ int mars_filler(void *__buf, const char *name, int namlen, loff_t offset,
 	} else {
 		list_add_tail(&dent->dent_link, anchor);
 	}
+	_dent_hash_insert(global, dent);
+	_mark_path(global, dent->d_path);
 
 found:
 	dent->d_type = d_type;
@@ -759,6 +929,53 @@ static int _mars_readdir(struct mars_cookie *cookie)
 	return status;
 }
 
+int mars_incremental_scan = 0;
+EXPORT_SYMBOL_GPL(mars_incremental_scan);
+
+int mars_scan_dents = 0;
+EXPORT_SYMBOL_GPL(mars_scan_dents);
+int mars_scan_readdirs = 0;
+EXPORT_SYMBOL_GPL(mars_scan_readdirs);
+int mars_scan_inodes = 0;
+EXPORT_SYMBOL_GPL(mars_scan_inodes);
+int mars_scan_ms = 0;
+EXPORT_SYMBOL_GPL(mars_scan_ms);
+int mars_scan_lookups = 0;
+EXPORT_SYMBOL_GPL(mars_scan_lookups);
+int mars_scan_lookup_probes = 0;
+EXPORT_SYMBOL_GPL(mars_scan_lookup_probes);
+
+/* Incremental scanning relies on the fact that symlinks under /mars
+ * are never modified in place. mars_symlink() (also when called on
+ * behalf of remote updates) always renames a new symlink over the old
+ * one, which updates the mtime of the parent directory.
+ * Thus a directory needs to be re-read only when its mtime has changed,
+ * and the symlinks in it need to be re-read only after that.
+ * Regular files and directories are always stat()ed.
+ */
+static
+bool _dir_changed(struct mars_dent *dent)
+{
+	if (!dent->d_scan_sec)
+		return true;
+	// coarse mtime granularity may hide changes within the same second
+	if (dent->new_stat.mtime.tv_sec >= dent->d_scan_sec)
+		return true;
+	return timespec_compare(&dent->new_stat.mtime, &dent->d_scan_mtime) != 0;
+}
+
+/* Symlinks are never modified in place (see above), thus a changed
+ * symlink always has a new inode.
+ */
+static
+bool _inode_changed(struct mars_dent *dent)
+{
+	return dent->new_stat.ino != dent->old_stat.ino ||
+		dent->new_stat.mode != dent->old_stat.mode ||
+		dent->new_stat.size != dent->old_stat.size ||
+		timespec_compare(&dent->new_stat.mtime, &dent->old_stat.mtime) != 0;
+}
+
 int mars_dent_work(struct mars_global *global, char *dirname, int allocsize, mars_dent_checker_fn checker, mars_dent_worker_fn worker, void *buf, int maxdepth)
 {
 	static int version = 0;
@@ -773,11 +990,19 @@ int mars_dent_work(struct mars_global *global, char *dirname, int allocsize, mar
 	struct say_channel *say_channel = NULL;
 	struct list_head *tmp;
 	struct list_head *next;
+	long long start_jiffies = jiffies;
 	int rounds = 0;
 	int status;
 	int total_status = 0;
+	int nr_dents = 0;
+	int nr_readdirs = 1;
+	int nr_inodes = 0;
+	bool incremental;
 	bool found_dir;
 
+	incremental = mars_incremental_scan > 0 &&
+		global->scan_round++ % mars_incremental_scan != 0;
+
 	/* Initialize the flat dent list
 	 */
 	version++;
@@ -805,16 +1030,35 @@ restart:
 		// treat any member only once during this invocation
 		if (dent->d_version == version)
 			continue;
+
+		if (incremental && S_ISLNK(dent->new_stat.mode) && dent->d_parent) {
+			// decide after the parent directory
+			if (dent->d_parent->d_version != version) {
+				found_dir = true;
+				continue;
+			}
+			if (dent->d_parent->d_scan_version != version) {
+				dent->d_version = version;
+				nr_dents++;
+				memcpy(&dent->old_stat, &dent->new_stat, sizeof(dent->old_stat));
+				continue;
+			}
+		}
 		dent->d_version = version;
+		nr_dents++;
 
 		bind_to_dent(dent, &say_channel);
 
 		//MARS_IO("reading inode '%s'\n", dent->d_path);
 		status = get_inode(dent->d_path, dent);
 		total_status |= status;
+		nr_inodes++;
+		if (_inode_changed(dent))
+			_mark_path(global, dent->d_path);
 
 		// recurse into subdirectories by inserting into the flat list
-		if (S_ISDIR(dent->new_stat.mode) && dent->d_depth <= maxdepth) {
+		if (S_ISDIR(dent->new_stat.mode) && dent->d_depth <= maxdepth &&
+		    (!incremental || _dir_changed(dent))) {
 			struct mars_cookie sub_cookie = {
 				.global = global,
 				.checker = checker,
@@ -824,10 +1068,15 @@ restart:
 				.depth = dent->d_depth + 1,
 			};
 			found_dir = true;
+			dent->d_scan_version = version;
+			dent->d_scan_sec = get_seconds();
+			memcpy(&dent->d_scan_mtime, &dent->new_stat.mtime, sizeof(dent->d_scan_mtime));
 			status = _mars_readdir(&sub_cookie);
 			total_status |= status;
+			nr_readdirs++;
 			if (status < 0) {
 				MARS_INF("forward: status %d on '%s'\n", status, dent->d_path);
+				dent->d_scan_sec = 0;
 			}
 		}
 	}
@@ -880,6 +1129,7 @@ restart:
 
 		MARS_DBG("killing dent '%s'\n", dent->d_path);
 		list_del_init(tmp);
+		_dent_hash_remove(dent);
 		mars_free_dent(dent);
 	}
 	up_write(&global->dent_mutex);
@@ -935,6 +1185,15 @@ restart:
 	bind_to_dent(NULL, &say_channel);
 
 done:
+	if (global == mars_global) {
+		mars_scan_dents = nr_dents;
+		mars_scan_readdirs = nr_readdirs;
+		mars_scan_inodes = nr_inodes;
+		mars_scan_ms = jiffies_to_msecs((long long)jiffies - start_jiffies);
+		// lookups since the last round
+		mars_scan_lookups = atomic_xchg(&lookup_count, 0);
+		mars_scan_lookup_probes = atomic_xchg(&lookup_probe_count, 0);
+	}
 	MARS_IO("total_status = %d\n", total_status);
 	return total_status;
 }
@@ -944,19 +1203,38 @@ struct mars_dent *_mars_find_dent(struct mars_global *global, const char *path)
 {
 	struct mars_dent *res = NULL;
 	struct list_head *tmp;
+	int probes = 0;
 
 	if (!rwsem_is_locked(&global->dent_mutex)) {
 		MARS_ERR("dent_mutex not held!\n");
 	}
 
+	if (likely(global->dent_hash)) {
+		struct hlist_node *pos;
+
+		for (pos = global->dent_hash[_path_hash(path, INT_MAX)].first; pos; pos = pos->next) {
+			struct mars_dent *tmp_dent = hlist_entry(pos, struct mars_dent, d_hash_node);
+			probes++;
+			if (!strcmp(tmp_dent->d_path, path)) {
+				res = tmp_dent;
+				break;
+			}
+		}
+		goto done;
+	}
+
 	for (tmp = global->dent_anchor.next; tmp != &global->dent_anchor; tmp = tmp->next) {
 		struct mars_dent *tmp_dent = container_of(tmp, struct mars_dent, dent_link);
+		probes++;
 		if (!strcmp(tmp_dent->d_path, path)) {
 			res = tmp_dent;
 			break;
 		}
 	}
 
+done:
+	atomic_inc(&lookup_count);
+	atomic_add(probes, &lookup_probe_count);
 	return res;
 }
 EXPORT_SYMBOL_GPL(_mars_find_dent);
@@ -973,6 +1251,37 @@ struct mars_dent *mars_find_dent(struct mars_global *global, const char *path)
 }
 EXPORT_SYMBOL_GPL(mars_find_dent);
 
+/* Prefix index: walk down the directory hierarchy, starting with
+ * the children of @dir.
+ */
+static
+int _find_dent_prefix(struct mars_global *global, const char *dir, int dir_len, const char *prefix, int prefix_len, struct mars_dent **res, int count, int max)
+{
+	struct hlist_node *pos;
+
+	for (pos = global->dent_dir_hash[_path_hash(dir, dir_len)].first; pos && count < max; pos = pos->next) {
+		struct mars_dent *tmp_dent = hlist_entry(pos, struct mars_dent, d_dir_hash_node);
+		const char *path = tmp_dent->d_path;
+		int len;
+
+		atomic_inc(&lookup_probe_count);
+		// only direct children of dir
+		if (strncmp(path, dir, dir_len) || path[dir_len] != '/' || strchr(path + dir_len + 1, '/'))
+			continue;
+		len = strlen(path);
+		if (len >= prefix_len) {
+			if (strncmp(path, prefix, prefix_len))
+				continue;
+			res[count++] = tmp_dent;
+			// all descendants are matching
+			count = _find_dent_prefix(global, path, len, path, len, res, count, max);
+		} else if (!strncmp(prefix, path, len) && prefix[len] == '/') {
+			count = _find_dent_prefix(global, path, len, prefix, prefix_len, res, count, max);
+		}
+	}
+	return count;
+}
+
 int mars_find_dent_all(struct mars_global *global, char *prefix, struct mars_dent ***table)
 {
 	int max = 1024; // provisionary
@@ -980,15 +1289,23 @@ int mars_find_dent_all(struct mars_global *global, char *prefix, struct mars_den
 	struct list_head *tmp;
 	struct mars_dent **res = brick_zmem_alloc(max * sizeof(void*));
 	int prefix_len = strlen(prefix);
+	int dir_len = _dirname_len(prefix);
 
 	*table = res;
 	if (unlikely(!res || !global))
 		goto done;
 
+	atomic_inc(&lookup_count);
 	down_read(&global->dent_mutex);
+	if (likely(global->dent_dir_hash && dir_len > 0)) {
+		count = _find_dent_prefix(global, prefix, dir_len, prefix, prefix_len, res, 0, max);
+		up_read(&global->dent_mutex);
+		goto done;
+	}
 	for (tmp = global->dent_anchor.next; tmp != &global->dent_anchor; tmp = tmp->next) {
 		struct mars_dent *tmp_dent = container_of(tmp, struct mars_dent, dent_link);
 		int this_len;
+		atomic_inc(&lookup_probe_count);
 		if (!tmp_dent->d_path) {
 			continue;
 		}
@@ -1051,6 +1368,13 @@ void mars_free_dent_all(struct mars_global *global, struct list_head *anchor)
 	if (global)
 		down_write(&global->dent_mutex);
 	list_replace_init(anchor, &tmp_list);
+	if (global && anchor == &global->dent_anchor) {
+		// the hash nodes of the dents are not touched anymore
+		brick_mem_free(global->dent_hash);
+		global->dent_hash = NULL;
+		brick_mem_free(global->dent_dir_hash);
+		global->dent_dir_hash = NULL;
+	}
 	if (global)
 		up_write(&global->dent_mutex);
 	MARS_DBG("is_empty=%d\n", list_empty(&tmp_list));
@@ -1071,28 +1395,47 @@ EXPORT_SYMBOL_GPL(mars_free_dent_all);
 
 struct mars_brick *mars_find_brick(struct mars_global *global, const void *brick_type, const char *path)
 {
+	struct mars_brick *res = NULL;
 	struct list_head *tmp;
+	int probes = 0;
 
 	if (!global || !path)
 		return NULL;
 
 	down_read(&global->brick_mutex);
 
-	for (tmp = global->brick_anchor.next; tmp != &global->brick_anchor; tmp = tmp->next) {
-		struct mars_brick *test = container_of(tmp, struct mars_brick, global_brick_link);
-		if (!strcmp(test->brick_path, path)) {
-			up_read(&global->brick_mutex);
-			if (brick_type && test->type != brick_type) {
-				MARS_ERR("bad brick type\n");
-				return NULL;
+	if (likely(global->brick_hash)) {
+		struct hlist_node *pos;
+
+		for (pos = global->brick_hash[_path_hash(path, INT_MAX)].first; pos; pos = pos->next) {
+			struct mars_brick *test = hlist_entry(pos, struct mars_brick, brick_hash_node);
+			probes++;
+			if (!strcmp(test->brick_path, path)) {
+				res = test;
+				break;
+			}
+		}
+	} else {
+		for (tmp = global->brick_anchor.next; tmp != &global->brick_anchor; tmp = tmp->next) {
+			struct mars_brick *test = container_of(tmp, struct mars_brick, global_brick_link);
+			probes++;
+			if (!strcmp(test->brick_path, path)) {
+				res = test;
+				break;
 			}
-			return test;
 		}
 	}
 
 	up_read(&global->brick_mutex);
 
-	return NULL;
+	atomic_inc(&lookup_count);
+	atomic_add(probes, &lookup_probe_count);
+
+	if (res && brick_type && res->type != brick_type) {
+		MARS_ERR("bad brick type\n");
+		return NULL;
+	}
+	return res;
 }
 EXPORT_SYMBOL_GPL(mars_find_brick);
 
@@ -1152,6 +1495,7 @@ int mars_free_brick(struct mars_brick *brick)
 		down_write(&global->brick_mutex);
 		list_del_init(&brick->global_brick_link);
 		list_del_init(&brick->dent_brick_link);
+		hlist_del_init(&brick->brick_hash_node);
 		up_write(&global->brick_mutex);
 	}
 
@@ -1170,6 +1514,7 @@ int mars_free_brick(struct mars_brick *brick)
 	status = generic_brick_exit_full((void*)brick);
 
 	if (status >= 0) {
+		generic_exit_object_layout(&brick->mref_object_layout);
 		brick_mem_free(brick);
 		mars_trigger();
 	} else {
@@ -1253,6 +1598,7 @@ struct mars_brick *mars_make_brick(struct mars_global *global, struct mars_dent
 	 */
 	down_write(&global->brick_mutex);
 	list_add(&res->global_brick_link, &global->brick_anchor);
+	_brick_hash_insert(global, res);
 	if (belongs) {
 		list_add_tail(&res->dent_brick_link, &belongs->brick_list);
 	}
@@ -1289,6 +1635,7 @@ int mars_kill_brick(struct mars_brick *brick)
 		down_write(&global->brick_mutex);
 		list_del_init(&brick->global_brick_link);
 		list_del_init(&brick->dent_brick_link);
+		hlist_del_init(&brick->brick_hash_node);
 		up_write(&global->brick_mutex);
 	}
 
@@ -1359,6 +1706,8 @@ int mars_kill_brick_all(struct mars_global *global, struct list_head *anchor, bo
 			brick = container_of(tmp, struct mars_brick, dent_brick_link);
 		} else {
 			brick = container_of(tmp, struct mars_brick, global_brick_link);
+			if (global)
+				hlist_del_init(&brick->brick_hash_node);
 		}
 		list_del_init(tmp);
 		if (global) {
@@ -1370,6 +1719,10 @@ int mars_kill_brick_all(struct mars_global *global, struct list_head *anchor, bo
 		}
 	}
 	if (global) {
+		if (anchor == &global->brick_anchor) {
+			brick_mem_free(global->brick_hash);
+			global->brick_hash = NULL;
+		}
 		up_write(&global->brick_mutex);
 	}
 done:
@@ -1421,6 +1774,8 @@ restart:
 		}
 
 		list_del_init(tmp);
+		if (!use_dent_link && global)
+			hlist_del_init(&brick->brick_hash_node);
 		if (global) {
 			up_write(&global->brick_mutex);
 		}
@@ -1549,6 +1904,11 @@ const struct generic_brick_type *_aio_brick_type = NULL;
 EXPORT_SYMBOL_GPL(_aio_brick_type);
 const struct generic_brick_type *_sio_brick_type = NULL;
 EXPORT_SYMBOL_GPL(_sio_brick_type);
+const struct generic_brick_type *_rio_brick_type = NULL;
+EXPORT_SYMBOL_GPL(_rio_brick_type);
+
+int mars_use_rio = 0;
+EXPORT_SYMBOL_GPL(mars_use_rio);
 
 struct mars_brick *make_brick_all(
 	struct mars_global *global,
@@ -1684,6 +2044,10 @@ struct mars_brick *make_brick_all(
 		MARS_DBG("substitute aio by sio\n");
 	}
 #endif
+	if (!brick && new_brick_type == _aio_brick_type && _rio_brick_type && mars_use_rio) {
+		new_brick_type = _rio_brick_type;
+		MARS_DBG("substitute aio by rio\n");
+	}
 
 	// create it...
 	if (!brick)
@@ -1781,7 +2145,11 @@ EXPORT_SYMBOL_GPL(global_show_connections);
 static
 void _show_one(struct mars_brick *test, int *brick_count)
 {
+	int rate;
+	int hit_percent;
 	int i;
+
+	generic_object_layout_statistics(&test->mref_object_layout, &rate, &hit_percent);
 	if (*brick_count) {
 		MARS_STAT("---------\n");
 	}
@@ -1791,6 +2159,8 @@ void _show_one(struct mars_brick *test, int *brick_count)
 		  "mrefs_apsect_alloc = %d "
 		  "total_mrefs_alloc = %d "
 		  "total_mrefs_aspects = %d "
+		  "mrefs_per_sec = %d "
+		  "mref_cache_hit = %d%% "
 		  "button = %d off = %d on = %d\n",
 		  SAFE_STR(test->type->type_name),
 		  SAFE_STR(test->brick_path),
@@ -1800,6 +2170,8 @@ void _show_one(struct mars_brick *test, int *brick_count)
 		  atomic_read(&test->mref_object_layout.aspect_count),
 		  atomic_read(&test->mref_object_layout.total_alloc_count),
 		  atomic_read(&test->mref_object_layout.total_aspect_count),
+		  rate,
+		  hit_percent,
 		  test->power.button,
 		  test->power.led_off,
 		  test->power.led_on);
@@ -1890,6 +2262,7 @@ int __init init_sy(void)
 	MARS_INF("init_sy()\n");
 
 	_mars_trigger = __mars_trigger;
+	_mars_trigger_path = __mars_trigger_path;
 
 	return 0;
 }
@@ -49,13 +49,18 @@ done:
 	return res;
 }
 
-int mars_send_dent_list(struct mars_socket *sock, struct list_head *anchor)
+/* Send only the dents which have been changed after generation @since.
+ * 0 means all.
+ */
+int mars_send_dent_delta(struct mars_socket *sock, struct list_head *anchor, long long since)
 {
 	struct list_head *tmp;
 	struct mars_dent *dent;
 	int status = 0;
 	for (tmp = anchor->next; tmp != anchor; tmp = tmp->next) {
 		dent = container_of(tmp, struct mars_dent, dent_link);
+		if (since && dent->d_generation <= since)
+			continue;
 		status = mars_send_struct(sock, dent, mars_dent_meta);
 		if (status < 0)
 			break;
@@ -65,6 +70,62 @@ int mars_send_dent_list(struct mars_socket *sock, struct list_head *anchor)
 	}
 	return status;
 }
+EXPORT_SYMBOL_GPL(mars_send_dent_delta);
+
+/* Copy the dents which have been changed after generation @since,
+ * such that they can be sent without holding any lock.
+ * Only the fields transferred by mars_dent_meta are copied.
+ */
+int mars_copy_dent_delta(struct list_head *anchor, long long since, struct list_head *copy)
+{
+	struct list_head *tmp;
+	int count = 0;
+
+	for (tmp = anchor->next; tmp != anchor; tmp = tmp->next) {
+		struct mars_dent *dent = container_of(tmp, struct mars_dent, dent_link);
+		struct mars_dent *new;
+
+		if (since && dent->d_generation <= since)
+			continue;
+		new = brick_zmem_alloc(sizeof(struct mars_dent));
+		if (unlikely(!new))
+			goto err;
+		INIT_LIST_HEAD(&new->brick_list);
+		list_add_tail(&new->dent_link, copy);
+		if (dent->d_name)
+			new->d_name = brick_strdup(dent->d_name);
+		if (dent->d_rest)
+			new->d_rest = brick_strdup(dent->d_rest);
+		if (dent->d_path)
+			new->d_path = brick_strdup(dent->d_path);
+		if (dent->new_link)
+			new->new_link = brick_strdup(dent->new_link);
+		if (dent->old_link)
+			new->old_link = brick_strdup(dent->old_link);
+		if (dent->d_args)
+			new->d_args = brick_strdup(dent->d_args);
+		new->d_type = dent->d_type;
+		new->d_class = dent->d_class;
+		new->d_serial = dent->d_serial;
+		new->d_corr_A = dent->d_corr_A;
+		new->d_corr_B = dent->d_corr_B;
+		new->d_generation = dent->d_generation;
+		memcpy(&new->new_stat, &dent->new_stat, sizeof(new->new_stat));
+		memcpy(&new->old_stat, &dent->old_stat, sizeof(new->old_stat));
+		count++;
+	}
+	return count;
+
+err:
+	mars_free_dent_all(NULL, copy);
+	return -ENOMEM;
+}
+EXPORT_SYMBOL_GPL(mars_copy_dent_delta);
+
+int mars_send_dent_list(struct mars_socket *sock, struct list_head *anchor)
+{
+	return mars_send_dent_delta(sock, anchor, 0);
+}
 EXPORT_SYMBOL_GPL(mars_send_dent_list);
 
 int mars_recv_dent_list(struct mars_socket *sock, struct list_head *anchor)
@@ -27,9 +27,30 @@
 #define MARS_ERR printf
 #define mars_digest_size 16
 #define mars_digest(a,b,c) /*empty*/
+#define log_crc_available(t) ((t) == LOG_CRC_CRC32C) /* MD5 is not verified */
 #define loff_t long long
+static int log_crc(int crc_type, void *data, int len);
 #include "../kernel/lib_log.h"
 
+/* Same result as crc32c(~0U, data, len) in the kernel.
+ */
+static
+int log_crc(int crc_type, void *data, int len)
+{
+	const unsigned char *ptr = data;
+	unsigned int crc = ~0U;
+	int i;
+
+	if (crc_type != LOG_CRC_CRC32C)
+		return 0;
+	while (len-- > 0) {
+		crc ^= *ptr++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1));
+	}
+	return (int)crc;
+}
+
 static
 int read_record(
 	struct log_header *lh,